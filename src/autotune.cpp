@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef OPENMP_ENABLED
+    #include <omp.h>
+#endif
+
+#include "console.h"
+#include "autotune.h"
+#include "tree.h"
+#include "interp_pts.h"
+#include "interaction_list.h"
+#include "output.h"
+#include "boundary_element.h"
+#include "near_field_kernel.h"
+
+Autotune::Autotune(class Molecule& molecule, const class Elements& elements,
+                   struct Params& params, struct Timers_Autotune& timers)
+    : params_(params), timers_(timers)
+{
+    if (params_.autotune_error_ <= 0.) return;
+
+#ifdef OPENACC_ENABLED
+    console::out() << "Autotune runs on the host only, keeping the tree parameters" << std::endl;
+    return;
+#endif
+
+    timers_.ctor.start();
+
+    // the table of candidates changes the format of the console
+    std::ios::fmtflags out_flags = console::out().flags();
+    std::streamsize out_precision = console::out().precision();
+
+    std::string key = Autotune::cache_key(elements.num());
+    Setting best;
+
+    if (Autotune::read_cache(key, best)) {
+        console::out() << "Read the tree parameters from " << params_.autotune_cache_file_ << std::endl;
+    } else if (Autotune::tune(molecule, elements, best)) {
+        if (!params_.autotune_cache_file_.empty()) Autotune::write_cache(key, best);
+    } else {
+        console::out() << "No setting met the autotune error, keeping the tree parameters" << std::endl;
+        console::out().flags(out_flags);
+        console::out().precision(out_precision);
+        timers_.ctor.stop();
+        return;
+    }
+
+    params_.tree_degree_       = best.degree;
+    params_.tree_theta_        = best.theta;
+    params_.tree_max_per_leaf_ = best.max_per_leaf;
+
+    console::out().flags(out_flags);
+    console::out().precision(out_precision);
+    console::out() << "Autotuned tree_degree " << best.degree << ", tree_theta " << best.theta
+              << ", tree_max_per_leaf " << best.max_per_leaf << std::endl;
+
+    timers_.ctor.stop();
+}
+
+
+bool Autotune::tune(class Molecule& molecule, const class Elements& elements, Setting& best) const
+{
+    const std::vector<int> max_per_leaf_values = {50, 100, 200, 400, 800};
+    const std::vector<double> theta_values = {0.5, 0.6, 0.7, 0.8, 0.9};
+    const int max_degree = 12;
+    const std::size_t max_samples = 256;
+
+    // the preconditioner and the FGMRES inner operator are not part of the matvec
+    struct Params params = params_;
+    params.precondition_ = false;
+    params.solver_ = Params::Solver::GMRES;
+
+    std::size_t num = elements.num();
+    std::size_t num_samples = std::min(num, max_samples);
+
+    best = {params_.tree_degree_, params_.tree_theta_, params_.tree_max_per_leaf_,
+            std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity()};
+
+    console::out() << "Autotuning for a relative matvec error of " << params_.autotune_error_
+              << " at " << num_samples << " targets" << std::endl;
+    console::out() << "   leaf  theta  degree      error  matvec (s)" << std::endl;
+
+    for (int max_per_leaf : max_per_leaf_values) {
+        if (max_per_leaf > static_cast<int>(num) && max_per_leaf != max_per_leaf_values.front()) break;
+
+        // each tree reorders its own copy of the elements
+        class Elements tree_elements(elements);
+        struct Timers_Tree tree_timers;
+        class Tree tree(tree_elements, max_per_leaf, tree_timers);
+
+        struct Timers_Output output_timers;
+        class Output output(molecule, tree_elements, params, output_timers);
+
+        // a smooth potential, which depends on the element and not its order
+        const double* x  = tree_elements.x_ptr();
+        const double* y  = tree_elements.y_ptr();
+        const double* z  = tree_elements.z_ptr();
+        const double* nx = tree_elements.nx_ptr();
+        std::vector<double> potential_old(2 * num), potential_new(2 * num);
+        for (std::size_t i = 0; i < num; ++i) {
+            potential_old[i]       = std::cos(0.3 * x[i]) + std::sin(0.2 * y[i] + 0.1 * z[i]);
+            potential_old[i + num] = 0.5 * nx[i] + 0.2 * std::cos(0.1 * z[i]);
+        }
+
+        std::vector<std::size_t> samples(num_samples);
+        for (std::size_t i = 0; i < num_samples; ++i) samples[i] = (2 * i + 1) * num / (2 * num_samples);
+        std::vector<double> reference;
+
+        for (double theta : theta_values) {
+            for (int degree = 1; degree <= max_degree; ++degree) {
+                class InterpolationPoints interp_pts(tree, degree);
+                interp_pts.compute_all_interp_pts();
+
+                struct Timers_InteractionList interaction_list_timers;
+                class InteractionList interaction_list(tree, degree, theta, interaction_list_timers);
+
+                struct Timers_BoundaryElement boundary_element_timers;
+                class BoundaryElement boundary_element(tree_elements, interp_pts, tree, interaction_list,
+                                                       molecule, params, output, boundary_element_timers);
+
+                if (reference.empty())
+                    boundary_element.apply_direct(potential_old.data(), samples, reference);
+
+                Timer matvec;
+                matvec.start();
+                boundary_element.apply(potential_old.data(), potential_new.data());
+                matvec.stop();
+
+                double error_norm = 0., reference_norm = 0.;
+                for (std::size_t i = 0; i < num_samples; ++i) {
+                    double error_0 = potential_new[samples[i]]       - reference[i];
+                    double error_1 = potential_new[samples[i] + num] - reference[i + num_samples];
+                    error_norm     += error_0 * error_0 + error_1 * error_1;
+                    reference_norm += reference[i] * reference[i]
+                                    + reference[i + num_samples] * reference[i + num_samples];
+                }
+                double error = std::sqrt(error_norm / reference_norm);
+
+                console::out() << std::setw(7) << max_per_leaf << std::setw(7) << std::fixed
+                          << std::setprecision(2) << theta
+                          << std::setw(8) << degree << std::setw(11) << std::scientific
+                          << std::setprecision(2) << error << std::setw(12) << std::fixed
+                          << std::setprecision(5) << matvec.elapsed_time() << std::endl;
+
+                if (error <= params_.autotune_error_) {
+                    if (matvec.elapsed_time() < best.seconds)
+                        best = {degree, theta, max_per_leaf, error, matvec.elapsed_time()};
+                    break;
+                }
+            }
+        }
+    }
+
+    return best.seconds < std::numeric_limits<double>::infinity();
+}
+
+
+/* settings are shared between meshes within a factor of two in size, on the
+ * same thread count and near field instruction set */
+std::string Autotune::cache_key(std::size_t num_elements) const
+{
+    int num_threads = 1;
+#ifdef OPENMP_ENABLED
+    num_threads = omp_get_max_threads();
+#endif
+
+    std::ostringstream key;
+    key << static_cast<int>(std::log2(std::max<std::size_t>(num_elements, 1))) << " "
+        << num_threads << " " << near_field::isa_name(near_field::detect_isa()) << " "
+        << params_.autotune_error_;
+
+    return key.str();
+}
+
+
+bool Autotune::read_cache(const std::string& key, Setting& setting) const
+{
+    if (params_.autotune_cache_file_.empty()) return false;
+
+    std::ifstream cache_file(params_.autotune_cache_file_);
+    std::istringstream key_stream(key);
+    std::vector<std::string> key_tokens{std::istream_iterator<std::string>{key_stream},
+                                        std::istream_iterator<std::string>{}};
+    bool found = false;
+    std::string line;
+
+    // one setting per line after its key, the last one for a key wins
+    while (std::getline(cache_file, line)) {
+        std::istringstream iss(line);
+        std::vector<std::string> tokens{std::istream_iterator<std::string>{iss},
+                                        std::istream_iterator<std::string>{}};
+        if (tokens.size() != key_tokens.size() + 3) continue;
+        if (!std::equal(key_tokens.begin(), key_tokens.end(), tokens.begin())) continue;
+
+        Setting read;
+        try {
+            read.degree       = std::stoi(tokens[key_tokens.size()]);
+            read.theta        = std::stod(tokens[key_tokens.size() + 1]);
+            read.max_per_leaf = std::stoi(tokens[key_tokens.size() + 2]);
+        } catch (const std::exception&) {
+            continue;
+        }
+        if (read.degree <= 0 || read.theta < 0. || read.theta > 1. || read.max_per_leaf <= 0) continue;
+
+        setting = read;
+        found = true;
+    }
+
+    return found;
+}
+
+
+void Autotune::write_cache(const std::string& key, const Setting& setting) const
+{
+    std::ofstream cache_file(params_.autotune_cache_file_, std::ofstream::app);
+    cache_file << key << " " << setting.degree << " " << setting.theta << " "
+               << setting.max_per_leaf << std::endl;
+
+    if (!cache_file.good())
+        console::out() << "Cannot write " << params_.autotune_cache_file_ << std::endl;
+}
+
+
+void Timers_Autotune::print() const
+{
+    console::out().setf(std::ios::fixed, std::ios::floatfield);
+    console::out().precision(5);
+    console::out() << "|...Autotune function times (s)...." << std::endl;
+    console::out() << "|   |...ctor.......................: ";
+    console::out() << std::setw(12) << std::right << ctor.elapsed_time() << std::endl;
+    console::out() << "|" << std::endl;
+}
+
+
+std::string Timers_Autotune::get_durations() const
+{
+    std::string durations;
+    durations.append(std::to_string(ctor.elapsed_time())).append(", ");
+
+    return durations;
+}
+
+
+std::string Timers_Autotune::get_headers() const
+{
+    std::string headers;
+    headers.append("Autotune ctor, ");
+
+    return headers;
+}
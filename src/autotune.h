@@ -0,0 +1,60 @@
+#ifndef H_TABIPB_AUTOTUNE_H
+#define H_TABIPB_AUTOTUNE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "timer.h"
+#include "params.h"
+#include "molecule.h"
+#include "elements.h"
+
+struct Timers_Autotune;
+
+/* Chooses tree_degree, tree_theta and tree_max_per_leaf for the elements when
+ * params.autotune_error_ is set, and writes them to the params before the trees
+ * are built. Each candidate times one matvec on a copy of the elements, and its
+ * error is measured at a sample of targets against the direct sum. For a leaf
+ * size and theta, degrees are raised until the error is met, as higher degrees
+ * are only slower. */
+class Autotune
+{
+private:
+    struct Params& params_;
+    struct Timers_Autotune& timers_;
+
+    struct Setting {
+        int degree;
+        double theta;
+        int max_per_leaf;
+        double error;
+        double seconds;
+    };
+
+    std::string cache_key(std::size_t num_elements) const;
+    bool read_cache(const std::string& key, Setting& setting) const;
+    void write_cache(const std::string& key, const Setting& setting) const;
+
+    /* false if no candidate met the error */
+    bool tune(class Molecule&, const class Elements&, Setting& best) const;
+
+public:
+    Autotune(class Molecule&, const class Elements&, struct Params&, struct Timers_Autotune&);
+    ~Autotune() = default;
+};
+
+
+struct Timers_Autotune
+{
+    Timer ctor;
+
+    void print() const;
+    std::string get_durations() const;
+    std::string get_headers() const;
+
+    Timers_Autotune() = default;
+    ~Timers_Autotune() = default;
+};
+
+#endif /* H_TABIPB_AUTOTUNE_H */
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef OPENMP_ENABLED
+    #include <omp.h>
+#endif
+
+#include "batch.h"
+#include "console.h"
+#include "params.h"
+#include "tabipb.h"
+#include "tabipb_timers.h"
+#include "timer.h"
+
+Batch::Batch(const char* manifest)
+{
+    std::ifstream manifest_file(manifest, std::ifstream::in);
+    if (!manifest_file.good()) {
+        throw std::runtime_error("manifest file is not readable");
+    }
+    
+    std::string line;
+    while (std::getline(manifest_file, line)) {
+    
+        std::istringstream iss(line);
+        std::vector<std::string> tokenized_line{
+            std::istream_iterator<std::string>{iss},
+            std::istream_iterator<std::string>{}};
+            
+        if (tokenized_line.size() < 2 || tokenized_line[0][0] == '#') continue;
+        
+        std::string token = tokenized_line[0];
+        std::transform(token.begin(), token.end(), token.begin(),
+                       [=](unsigned char c) { return std::tolower(c); });
+        
+        if (token == "job") {
+            Job job;
+            job.deck = tokenized_line[1];
+            Batch::read_deck(job);
+            
+            for (const auto& other : jobs_) {
+                if (other.output_prefix == job.output_prefix) {
+                    throw std::runtime_error("jobs " + other.deck + " and " + job.deck
+                                             + " write to the same output_prefix " + job.output_prefix);
+                }
+            }
+            jobs_.push_back(job);
+        
+        } else if (token == "threads_per_job") {
+            threads_per_job_ = std::stoi(tokenized_line[1]);
+            if (threads_per_job_ <= 0) {
+                throw std::runtime_error("invalid threads_per_job value");
+            }
+            
+        } else if (token == "large_job_atoms") {
+            large_job_atoms_ = std::stoul(tokenized_line[1]);
+            
+        } else {
+            std::cout << "Skipping undefined token: " << token << std::endl;
+        }
+    }
+}
+
+
+void Batch::read_deck(Job& job)
+{
+    // The atom count of the pqr file stands in for the cost of a job; decks
+    // that cannot be read count as empty and fail when they run.
+    std::ifstream deck_file(job.deck, std::ifstream::in);
+    std::string line, pqr, output_prefix;
+    
+    while (std::getline(deck_file, line)) {
+        std::istringstream iss(line);
+        std::string token;
+        iss >> token;
+        std::transform(token.begin(), token.end(), token.begin(),
+                       [=](unsigned char c) { return std::tolower(c); });
+        if (token == "mol" || token == "pqr") iss >> pqr;
+        if (token == "output_prefix") iss >> output_prefix;
+    }
+    
+    // jobs run side by side, so a deck without an output_prefix writes next to
+    // itself rather than to the shared default
+    if (output_prefix.empty()) {
+        std::size_t dir_end = job.deck.find_last_of("/\\");
+        std::size_t ext = job.deck.find_last_of('.');
+        std::size_t name_begin = dir_end == std::string::npos ? 0 : dir_end + 1;
+        bool has_ext = ext != std::string::npos && ext > name_begin;
+        output_prefix = has_ext ? job.deck.substr(0, ext) : job.deck;
+    }
+    job.output_prefix = output_prefix;
+    
+    std::ifstream pqr_file(pqr, std::ifstream::in);
+    job.num_atoms = 0;
+    
+    while (std::getline(pqr_file, line))
+        if (line.compare(0, 4, "ATOM") == 0 || line.compare(0, 6, "HETATM") == 0) ++job.num_atoms;
+}
+
+
+void Batch::run_job(Job& job, int num_threads)
+{
+    // the job reports on a stream of its own, which nothing else formats
+    std::ofstream log(job.deck + ".log");
+    console::Redirect redirect(log);
+    job.num_threads = num_threads;
+    
+#ifdef OPENMP_ENABLED
+    omp_set_num_threads(num_threads);
+#endif
+
+    Timer timer;
+    timer.start();
+    
+    try {
+        struct Params params(job.deck.c_str());
+        params.output_prefix_ = job.output_prefix;
+        struct Timers timers;
+        
+        struct Energies energies = run_tabipb(params, timers);
+        
+        job.solvation_energy = energies.solvation;
+        job.free_energy      = energies.free;
+        job.succeeded        = true;
+        
+    } catch (const std::exception& e) {
+        job.error = e.what();
+        console::out() << "\nJob failed: " << job.error << std::endl;
+    }
+    
+    timer.stop();
+    job.time = timer.elapsed_time();
+    
+    log.flush();
+    
+    std::ostringstream progress;
+    progress << std::fixed << std::setprecision(3) << job.deck << ": "
+             << (job.succeeded ? "done" : "FAILED") << " in " << job.time << " s on "
+             << num_threads << " thread(s)\n";
+#ifdef OPENMP_ENABLED
+    #pragma omp critical(batch_progress)
+#endif
+    std::cout << progress.str() << std::flush;
+}
+
+
+void Batch::run()
+{
+    int num_threads = 1;
+#ifdef OPENMP_ENABLED
+    num_threads = omp_get_max_threads();
+    omp_set_max_active_levels(2);
+#endif
+
+    std::vector<std::size_t> order(jobs_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return jobs_[a].num_atoms > jobs_[b].num_atoms; });
+    
+    auto first_small = std::find_if(order.begin(), order.end(), [&](std::size_t i) {
+        return jobs_[i].num_atoms < large_job_atoms_; });
+    
+    // large jobs one after another on every thread
+    for (auto it = order.begin(); it != first_small; ++it)
+        Batch::run_job(jobs_[*it], num_threads);
+    
+    // small jobs side by side, largest first so that the tail is short
+    std::vector<std::size_t> small_jobs(first_small, order.end());
+    int threads_per_job = std::min(threads_per_job_, num_threads);
+    
+#ifdef OPENMP_ENABLED
+    int num_slots = std::max(1, num_threads / threads_per_job);
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(num_slots)
+#endif
+    for (std::size_t i = 0; i < small_jobs.size(); ++i)
+        Batch::run_job(jobs_[small_jobs[i]], threads_per_job);
+
+#ifdef OPENMP_ENABLED
+    omp_set_num_threads(num_threads);
+#endif
+}
+
+
+void Batch::report() const
+{
+    std::cout << std::fixed << std::setprecision(6);
+    std::cout << "\n\n*** OUTPUT FOR TABI-PB BATCH ***\n\n";
+    std::cout << std::setw(8) << "atoms" << std::setw(9) << "threads" << std::setw(12) << "time (s)"
+              << std::setw(20) << "solvation (kJ/mol)" << std::setw(20) << "free (kJ/mol)"
+              << "  input deck\n";
+    
+    for (const auto& job : jobs_) {
+        std::cout << std::setw(8) << job.num_atoms << std::setw(9) << job.num_threads
+                  << std::setw(12) << std::setprecision(3) << job.time << std::setprecision(6);
+        
+        if (job.succeeded)
+            std::cout << std::setw(20) << job.solvation_energy << std::setw(20) << job.free_energy;
+        else
+            std::cout << std::setw(40) << "FAILED";
+            
+        std::cout << "  " << job.deck;
+        if (!job.succeeded) std::cout << " (" << job.error << ")";
+        std::cout << "\n";
+    }
+    
+    std::cout << "\n" << jobs_.size() - Batch::num_failed() << " of " << jobs_.size()
+              << " jobs succeeded." << std::endl;
+}
+
+
+std::size_t Batch::num_failed() const
+{
+    return std::count_if(jobs_.begin(), jobs_.end(), [](const Job& job) { return !job.succeeded; });
+}
@@ -0,0 +1,50 @@
+#ifndef H_TABIPB_BATCH_H
+#define H_TABIPB_BATCH_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/* Runs the input decks of a manifest in one process. The manifest lists
+ * "job <input deck>" lines, and optionally "threads_per_job <n>" and
+ * "large_job_atoms <n>". Jobs with at least large_job_atoms atoms run one at
+ * a time on every thread; the others run concurrently, largest first, on
+ * threads_per_job threads each. What a job prints goes to <input deck>.log,
+ * and a job that fails is reported without stopping the others. A deck
+ * without output_prefix writes its output files to the deck's path without
+ * its extension; two jobs with the same prefix are rejected. */
+class Batch
+{
+private:
+    struct Job
+    {
+        std::string deck;
+        std::string output_prefix;
+        std::size_t num_atoms = 0;
+        int num_threads = 1;
+        
+        bool succeeded = false;
+        std::string error;
+        double time = 0.;
+        double solvation_energy = 0.;
+        double free_energy = 0.;
+    };
+    
+    std::vector<Job> jobs_;
+    int threads_per_job_ = 1;
+    std::size_t large_job_atoms_ = 5000;
+    
+    /* the atom count and output prefix of the job's deck */
+    static void read_deck(Job& job);
+    void run_job(Job& job, int num_threads);
+    
+public:
+    Batch(const char* manifest);
+    ~Batch() = default;
+    
+    void run();
+    void report() const;
+    std::size_t num_failed() const;
+};
+
+#endif /* H_TABIPB_BATCH_H */
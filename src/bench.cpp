@@ -0,0 +1,449 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef OPENMP_ENABLED
+#include <omp.h>
+#endif
+
+#ifndef _WIN32
+    #include <unistd.h>
+#else
+    #include <direct.h>
+#endif
+
+#include "console.h"
+#include "constants.h"
+#include "params.h"
+#include "session.h"
+#include "surface_mesh.h"
+#include "tabipb_timers.h"
+
+/* tabipb_bench: solves for off-center charges in spheres of increasing vertex
+ * count with increasing thread counts, and reports the time of every phase,
+ * the throughput, the strong and weak scaling, and the error against the
+ * Kirkwood series solution for the sphere. */
+
+namespace {
+
+const std::string PREFIX = "tabipb_bench";
+
+struct Options {
+  std::vector<std::size_t> sizes = {10000, 100000, 1000000, 10000000};
+  std::vector<int> threads;
+  std::size_t weak_base = 0;
+  double radius = 10.;
+  int tree_degree = 3;
+  double tree_theta = 0.8;
+  int tree_max_per_leaf = 50;  // the leaf size of the examples
+  std::string csv_file_name;
+};
+
+struct Charge {
+  double x, y, z, q;
+};
+
+struct Run {
+  std::size_t num_vertices;
+  int num_threads;
+  double mesh, tree, interaction_list, source_term, matvec, gmres, energies;
+  double setup, solve;
+  std::size_t num_matvecs;
+  double energy, exact;
+};
+
+/* off-center charges as fractions of the radius */
+std::vector<Charge> charges(double radius) {
+  return {{ 0.50 * radius,  0.00 * radius,  0.00 * radius,  1.0},
+          {-0.25 * radius,  0.40 * radius,  0.10 * radius, -1.0},
+          { 0.10 * radius, -0.30 * radius,  0.45 * radius,  0.5},
+          {-0.20 * radius, -0.20 * radius, -0.50 * radius, -0.5}};
+}
+
+/* Kirkwood's solvation energy of point charges in a sphere of radius a with
+ * dielectric eps_in, in a solvent of dielectric eps_out with inverse Debye
+ * length kappa: the reaction field series sum_n A_n r^n P_n(cos gamma). */
+double kirkwood_energy(const std::vector<Charge>& charges, double a,
+                       double eps_in, double eps_out, double kappa) {
+  const int MAX_ORDER = 1000;
+  const double x = kappa * a;
+
+  // G_n = x k_n'(x) / k_n(x) for the modified spherical Bessel functions k_n,
+  // from the ratios k_{n+1} / k_n, or -(n+1) without salt
+  std::vector<double> g(MAX_ORDER);
+  double ratio = 1. + 1. / x;
+  for (int n = 0; n < MAX_ORDER; ++n) {
+    if (x > 0.) {
+      if (n > 0) ratio = 1. / ratio + (2. * n + 1.) / x;
+      g[n] = n - x * ratio;
+    } else {
+      g[n] = -(n + 1.);
+    }
+  }
+
+  double energy = 0.;
+  for (const auto& j : charges) {
+    for (const auto& k : charges) {
+      double rj = std::sqrt(j.x * j.x + j.y * j.y + j.z * j.z);
+      double rk = std::sqrt(k.x * k.x + k.y * k.y + k.z * k.z);
+      double cos_gamma = (rj > 0. && rk > 0.)
+                       ? (j.x * k.x + j.y * k.y + j.z * k.z) / (rj * rk) : 1.;
+
+      double p_prev = 1., p = cos_gamma;
+      double scale = 1. / a;  // rj^n rk^n / a^(2n+1)
+      double sum = 0.;
+      for (int n = 0; n < MAX_ORDER; ++n) {
+        double legendre = n == 0 ? 1. : p;
+        double term = scale * legendre * (eps_out * g[n] + (n + 1.) * eps_in)
+                                       / (n * eps_in - eps_out * g[n]);
+        sum += term;
+        if (scale * a < 1e-17) break;
+
+        if (n > 0) {
+          double p_next = ((2. * n + 1.) * cos_gamma * p - n * p_prev) / (n + 1.);
+          p_prev = p;
+          p = p_next;
+        }
+        scale *= rj * rk / (a * a);
+      }
+      energy += j.q * k.q / eps_in * sum;
+    }
+  }
+
+  return 0.5 * constants::UNITS_COEFF * energy;
+}
+
+/* a new directory for the inputs of one mesh, so that concurrent runs do not
+ * overwrite each other's files */
+std::string make_input_dir() {
+#ifndef _WIN32
+  const char* tmp = std::getenv("TMPDIR");
+  std::string path = std::string(tmp && *tmp ? tmp : "/tmp") + "/" + PREFIX + ".XXXXXX";
+  std::vector<char> name(path.begin(), path.end());
+  name.push_back('\0');
+  if (!mkdtemp(name.data()))
+    throw std::runtime_error("cannot create a directory " + path);
+  return std::string(name.data());
+#else
+  char name[L_tmpnam];
+  if (!std::tmpnam(name) || _mkdir(name) != 0)
+    throw std::runtime_error("cannot create a temporary directory");
+  return std::string(name);
+#endif
+}
+
+void write_inputs(const std::string& prefix, const surface_mesh::Mesh& mesh,
+                  const std::vector<Charge>& charges) {
+  char line[160];
+
+  std::string vert = "#\n#\n" + std::to_string(mesh.x.size()) + " 0 0 0\n";
+  vert.reserve(mesh.x.size() * 80);
+  for (std::size_t i = 0; i < mesh.x.size(); ++i) {
+    std::snprintf(line, sizeof(line), "%.9f %.9f %.9f %.9f %.9f %.9f\n",
+                  mesh.x[i], mesh.y[i], mesh.z[i], mesh.nx[i], mesh.ny[i], mesh.nz[i]);
+    vert.append(line);
+  }
+
+  std::string face = "#\n#\n" + std::to_string(mesh.face_x.size()) + " 0 0 0\n";
+  face.reserve(mesh.face_x.size() * 30);
+  for (std::size_t i = 0; i < mesh.face_x.size(); ++i) {
+    std::snprintf(line, sizeof(line), "%u %u %u\n",
+                  mesh.face_x[i], mesh.face_y[i], mesh.face_z[i]);
+    face.append(line);
+  }
+
+  std::string pqr;
+  for (std::size_t i = 0; i < charges.size(); ++i) {
+    std::snprintf(line, sizeof(line), "ATOM %6zu  X   SPH     1 %8.3f %8.3f %8.3f %7.4f %6.4f\n",
+                  i + 1, charges[i].x, charges[i].y, charges[i].z, charges[i].q, 1.);
+    pqr.append(line);
+  }
+
+  std::ofstream(prefix + ".vert", std::ofstream::binary) << vert;
+  std::ofstream(prefix + ".face", std::ofstream::binary) << face;
+  std::ofstream(prefix + ".pqr",  std::ofstream::binary) << pqr;
+
+  for (const std::string ext : {".vert", ".face", ".pqr"})
+    if (!std::ifstream(prefix + ext).good())
+      throw std::runtime_error("cannot write " + prefix + ext);
+}
+
+void remove_inputs(const std::string& dir) {
+  std::string prefix = dir + "/" + PREFIX;
+  std::remove((prefix + ".vert").c_str());
+  std::remove((prefix + ".face").c_str());
+  std::remove((prefix + ".pqr").c_str());
+#ifndef _WIN32
+  rmdir(dir.c_str());
+#else
+  _rmdir(dir.c_str());
+#endif
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+Run run(const Options& options, const std::string& prefix, std::size_t num_vertices,
+        int num_threads) {
+  struct Params params;
+  params.pqr_file_name_ = prefix + ".pqr";
+  params.input_mesh_prefix_ = prefix;
+  params.phys_eps_solute_ = 1.;
+  params.phys_eps_solvent_ = 80.;
+  params.phys_bulk_strength_ = 0.15;
+  params.phys_temp_ = 300.;
+  params.tree_degree_ = options.tree_degree;
+  params.tree_theta_ = options.tree_theta;
+  params.tree_max_per_leaf_ = options.tree_max_per_leaf;
+  params.set_physical_constants();
+
+#ifdef OPENMP_ENABLED
+  omp_set_num_threads(num_threads);
+#endif
+
+  struct Timers timers;
+  struct Run result;
+  result.num_vertices = num_vertices;
+  result.num_threads = num_threads;
+
+  {
+    // the solver's progress reports are discarded
+    std::ostream discard(nullptr);
+    console::Redirect redirect(discard);
+
+    auto start = std::chrono::steady_clock::now();
+    Session session(params, timers);
+    result.setup = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    session.solve();
+    result.solve = seconds_since(start);
+
+    result.energy = session.energies().solvation;
+  }
+
+  result.mesh             = timers.elements.ctor.elapsed_time();
+  result.tree             = timers.tree.ctor.elapsed_time();
+  result.interaction_list = timers.interaction_list.ctor.elapsed_time();
+  result.source_term      = timers.elements.compute_source_term.elapsed_time();
+  result.matvec           = timers.boundary_element.matrix_vector.elapsed_time();
+  result.gmres            = timers.boundary_element.run_GMRES.elapsed_time();
+  result.energies         = timers.output.compute_solvation_energy.elapsed_time()
+                          + timers.output.compute_coulombic_energy.elapsed_time();
+  result.num_matvecs      = timers.boundary_element.matvecs.size();
+
+  result.exact = kirkwood_energy(charges(options.radius), options.radius,
+                                 params.phys_eps_solute_, params.phys_eps_solvent_,
+                                 params.phys_kappa_);
+  return result;
+}
+
+void print_run(const Run& r) {
+  std::cout.setf(std::ios::fixed, std::ios::floatfield);
+  std::cout << std::setprecision(4)
+            << std::setw(10) << r.num_vertices << std::setw(5) << r.num_threads
+            << std::setw(10) << r.mesh << std::setw(10) << r.tree
+            << std::setw(10) << r.interaction_list << std::setw(10) << r.source_term
+            << std::setw(10) << r.matvec / std::max<std::size_t>(1, r.num_matvecs)
+            << std::setw(10) << r.gmres << std::setw(10) << r.energies
+            << std::setw(6) << r.num_matvecs
+            << std::setw(14) << r.energy << std::setw(14) << r.exact;
+  std::cout.setf(std::ios::scientific, std::ios::floatfield);
+  std::cout << std::setprecision(2)
+            << std::setw(11) << std::abs((r.energy - r.exact) / r.exact)
+            << std::setw(11) << r.num_vertices * r.num_matvecs / r.matvec << std::endl;
+}
+
+/* runs every thread count on a sphere of about num_vertices vertices */
+std::vector<Run> run_size(const Options& options, std::size_t num_vertices,
+                          const std::vector<int>& threads) {
+  surface_mesh::Mesh mesh;
+  surface_mesh::sphere(options.radius, num_vertices, mesh);
+
+  std::string dir = make_input_dir();
+  std::string prefix = dir + "/" + PREFIX;
+
+  std::vector<Run> runs;
+  try {
+    write_inputs(prefix, mesh, charges(options.radius));
+    for (int num_threads : threads) {
+      runs.push_back(run(options, prefix, mesh.x.size(), num_threads));
+      print_run(runs.back());
+    }
+  } catch (...) {
+    remove_inputs(dir);
+    throw;
+  }
+  remove_inputs(dir);
+
+  return runs;
+}
+
+template <typename T>
+std::vector<T> parse_list(const std::string& value) {
+  std::vector<T> list;
+  std::istringstream iss(value);
+  std::string item;
+  while (std::getline(iss, item, ','))
+    list.push_back(static_cast<T>(std::stod(item)));
+  if (list.empty() || *std::min_element(list.begin(), list.end()) <= 0)
+    throw std::runtime_error("invalid list " + value);
+  return list;
+}
+
+Options parse_options(int argc, char* argv[]) {
+  Options options;
+
+  int max_threads = 1;
+#ifdef OPENMP_ENABLED
+  max_threads = omp_get_max_threads();
+#endif
+  for (int t = 1; t < max_threads; t *= 2) options.threads.push_back(t);
+  options.threads.push_back(max_threads);
+
+  for (int i = 1; i < argc; ++i) {
+    std::string option = argv[i];
+    if (i + 1 >= argc)
+      throw std::runtime_error("option " + option + " has no value");
+    std::string value = argv[++i];
+
+    if (option == "--sizes") {
+      options.sizes = parse_list<std::size_t>(value);
+    } else if (option == "--threads") {
+      options.threads = parse_list<int>(value);
+    } else if (option == "--weak") {
+      options.weak_base = static_cast<std::size_t>(std::stod(value));
+    } else if (option == "--radius") {
+      options.radius = std::stod(value);
+      if (options.radius <= 0.) throw std::runtime_error("invalid radius value");
+    } else if (option == "--tree_degree") {
+      options.tree_degree = std::stoi(value);
+      if (options.tree_degree <= 0) throw std::runtime_error("invalid tree_degree value");
+    } else if (option == "--tree_theta") {
+      options.tree_theta = std::stod(value);
+      if (options.tree_theta < 0. || options.tree_theta > 1.)
+        throw std::runtime_error("invalid tree_theta value");
+    } else if (option == "--tree_max_per_leaf") {
+      options.tree_max_per_leaf = std::stoi(value);
+      if (options.tree_max_per_leaf <= 0)
+        throw std::runtime_error("invalid tree_max_per_leaf value");
+    } else if (option == "--csv") {
+      options.csv_file_name = value;
+    } else {
+      throw std::runtime_error("unknown option " + option);
+    }
+  }
+
+#ifndef OPENMP_ENABLED
+  options.threads = {1};
+#endif
+  return options;
+}
+
+void print_header() {
+  std::cout << std::setw(10) << "vertices" << std::setw(5) << "thr"
+            << std::setw(10) << "mesh" << std::setw(10) << "trees"
+            << std::setw(10) << "lists" << std::setw(10) << "source"
+            << std::setw(10) << "matvec" << std::setw(10) << "gmres"
+            << std::setw(10) << "energy" << std::setw(6) << "mvs"
+            << std::setw(14) << "dG (kJ/mol)" << std::setw(14) << "Kirkwood"
+            << std::setw(11) << "rel error" << std::setw(11) << "vert*mv/s"
+            << std::endl;
+}
+
+/* speedup and efficiency of each run over the first run of its group */
+void print_scaling(const std::vector<std::vector<Run>>& groups, bool weak) {
+  std::cout.setf(std::ios::fixed, std::ios::floatfield);
+  std::cout.precision(4);
+  for (const auto& group : groups) {
+    if (group.size() < 2) continue;
+    const Run& base = group.front();
+    double base_time = base.setup + base.solve;
+    for (const Run& r : group) {
+      double time = r.setup + r.solve;
+      double speedup = weak ? base_time / time * r.num_threads / base.num_threads
+                            : base_time / time;
+      double efficiency = weak ? base_time / time
+                               : speedup * base.num_threads / r.num_threads;
+      std::cout << std::setw(10) << r.num_vertices << std::setw(5) << r.num_threads
+                << std::setw(11) << time << std::setw(9) << speedup
+                << std::setw(11) << efficiency << std::endl;
+    }
+  }
+}
+
+void write_csv(const std::string& file_name, const std::vector<Run>& runs) {
+  std::ofstream csv(file_name);
+  csv << "vertices, threads, mesh, trees, lists, source, matvec, gmres, energies, "
+         "setup, solve, matvecs, energy, exact\n";
+  csv.precision(10);
+  for (const Run& r : runs)
+    csv << r.num_vertices << ", " << r.num_threads << ", " << r.mesh << ", " << r.tree << ", "
+        << r.interaction_list << ", " << r.source_term << ", " << r.matvec << ", "
+        << r.gmres << ", " << r.energies << ", " << r.setup << ", " << r.solve << ", "
+        << r.num_matvecs << ", " << r.energy << ", " << r.exact << "\n";
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    Options options = parse_options(argc, argv);
+
+    std::cout.setf(std::ios::fixed, std::ios::floatfield);
+    std::cout.precision(4);
+
+    std::cout << "Sphere of radius " << options.radius << " A, tree_degree "
+              << options.tree_degree << ", tree_theta " << options.tree_theta
+              << ", tree_max_per_leaf " << options.tree_max_per_leaf
+              << "; times in seconds, matvec per matvec" << std::endl << std::endl;
+    print_header();
+
+    std::vector<Run> runs;
+    std::vector<std::vector<Run>> strong;
+    for (std::size_t size : options.sizes) {
+      strong.push_back(run_size(options, size, options.threads));
+      runs.insert(runs.end(), strong.back().begin(), strong.back().end());
+    }
+
+    std::vector<std::vector<Run>> weak(1);
+    if (options.weak_base > 0) {
+      for (int num_threads : options.threads) {
+        std::vector<Run> sized = run_size(options, options.weak_base * num_threads, {num_threads});
+        weak.front().push_back(sized.front());
+      }
+      runs.insert(runs.end(), weak.front().begin(), weak.front().end());
+    }
+
+    std::cout << std::endl << "Strong scaling" << std::endl;
+    std::cout << std::setw(10) << "vertices" << std::setw(5) << "thr" << std::setw(11) << "time"
+              << std::setw(9) << "speedup" << std::setw(11) << "efficiency" << std::endl;
+    print_scaling(strong, false);
+
+    if (options.weak_base > 0) {
+      std::cout << std::endl << "Weak scaling" << std::endl;
+      std::cout << std::setw(10) << "vertices" << std::setw(5) << "thr" << std::setw(11) << "time"
+                << std::setw(9) << "speedup" << std::setw(11) << "efficiency" << std::endl;
+      print_scaling(weak, true);
+    }
+
+    if (!options.csv_file_name.empty()) write_csv(options.csv_file_name, runs);
+
+  } catch (const std::exception &e) {
+    std::cout << e.what() << ". exiting. " << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
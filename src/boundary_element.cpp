@@ -5,10 +5,42 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <stdexcept>
+#include <string>
 
+#include "console.h"
 #include "constants.h"
+#include "near_field_kernel.h"
+#include "far_field_kernel.h"
 #include "boundary_element.h"
 
+/* interp_basis_begin_ entry of a leaf that did not fit in the cache budget */
+static constexpr std::size_t NOT_CACHED = static_cast<std::size_t>(-1);
+
+
+BoundaryElement::InnerOperator::InnerOperator(const BoundaryElement& outer, int degree, double theta,
+                                              long int num_iter)
+    : interp_pts(outer.tree_, degree),
+      interaction_list(outer.tree_, degree, theta, interaction_list_timers),
+      num_iter(num_iter)
+{
+    interp_pts.copyin_to_device();
+    interp_pts.compute_all_interp_pts();
+    boundary_element.reset(new BoundaryElement(outer, interp_pts, interaction_list, timers));
+    
+    std::size_t n = 2 * outer.elements_.num();
+    work.assign(n * (num_iter + 2), 0.);
+    h   .assign((num_iter + 1) * (num_iter + 2), 0.);
+    s   .assign(num_iter + 1, 0.);
+    y   .assign(num_iter, 0.);
+}
+
+
+BoundaryElement::InnerOperator::~InnerOperator()
+{
+    interp_pts.delete_from_device();
+}
+
 
 BoundaryElement::BoundaryElement(class Elements& elements, const class InterpolationPoints& interp_pts,
          const class Tree& tree, const class InteractionList& interaction_list,
@@ -20,7 +52,48 @@ BoundaryElement::BoundaryElement(class Elements& elements, const class Interpola
 {
     timers_.ctor.start();
 
+    mixed_precision_ = (params_.precision_ == Params::Precision::MIXED);
+    BoundaryElement::init_operator();
+    if (params_.precondition_) BoundaryElement::factor_precondition_blocks();
+    
+    if (params_.solver_ == Params::Solver::FGMRES) {
+        int inner_degree   = params_.fgmres_inner_degree_ > 0 ? params_.fgmres_inner_degree_
+                           : std::max(1, params_.tree_degree_ - 1);
+        double inner_theta = params_.fgmres_inner_theta_ >= 0. ? params_.fgmres_inner_theta_
+                           : params_.tree_theta_;
+        inner_.reset(new InnerOperator(*this, inner_degree, inner_theta, params_.fgmres_inner_num_iter_));
+    }
+
+    timers_.ctor.stop();
+}
+
+
+BoundaryElement::BoundaryElement(const BoundaryElement& outer, const class InterpolationPoints& interp_pts,
+         const class InteractionList& interaction_list, struct Timers_BoundaryElement& timers)
+    : elements_(outer.elements_), interp_pts_(interp_pts), tree_(outer.tree_),
+      interaction_list_(interaction_list), molecule_(outer.molecule_),
+      params_(outer.params_), output_(outer.output_), timers_(timers)
+{
+    timers_.ctor.start();
+
+    mixed_precision_ = true;
+    BoundaryElement::init_operator();
+
+    timers_.ctor.stop();
+}
+
+
+BoundaryElement::~BoundaryElement() = default;
+
+
+void BoundaryElement::init_operator()
+{
     potential_.assign(2 * elements_.num(), 0.);
+    potential_temp_.assign(2 * elements_.num(), 0.);
+    owner_computes_ = (params_.matvec_schedule_ == Params::MatvecSchedule::OWNER);
+    near_field_kernel_ = near_field::select_kernel(near_field::detect_isa());
+    near_field_block_kernel_ = near_field::select_block_kernel(near_field::detect_isa());
+    far_field_kernel_  = far_field::select_kernel(near_field::detect_isa());
     
     num_charges_per_node_ = std::pow(interp_pts_.num_interp_pts_per_node(), 3);
     num_charges_          = tree_.num_nodes() * num_charges_per_node_;
@@ -35,8 +108,11 @@ BoundaryElement::BoundaryElement(class Elements& elements, const class Interpola
     interp_potential_dy_.resize(num_charges_);
     interp_potential_dz_.resize(num_charges_);
 
-    timers_.ctor.stop();
+    BoundaryElement::reserve_workspace();
+    BoundaryElement::build_interp_cache();
+    BoundaryElement::init_mixed_precision();
 }
+
           
 void BoundaryElement::run_GMRES()
 {
@@ -51,28 +127,126 @@ void BoundaryElement::run_GMRES()
     double residual   = params_.gmres_residual_;
     long int num_iter = params_.gmres_num_iter_;
 
-    std::vector<double> work_vec(ldw * (restrt + 4));
+    // FGMRES also keeps the preconditioned direction of every Krylov vector
+    std::vector<double> work_vec(ldw * (inner_ ? 2 * restrt + 5 : restrt + 4));
     std::vector<double> h_vec   (ldh * (restrt + 2));
     
     double* work = work_vec.data();
     double* h    = h_vec.data();
 
     BoundaryElement::copyin_clusters_to_device();
-    
-    int err_code = BoundaryElement::gmres_(length, elements_.source_term_ptr(), output_.potential().data(),
-                                    restrt, work, ldw, h, ldh, num_iter, residual);
+    if (inner_) inner_->boundary_element->copyin_clusters_to_device();
+    
+    int err_code = inner_
+        ? BoundaryElement::fgmres_(length, elements_.source_term_ptr(), output_.potential().data(),
+                                   restrt, work, ldw, h, ldh, num_iter, residual)
+        : BoundaryElement::gmres_ (length, elements_.source_term_ptr(), output_.potential().data(),
+                                   restrt, work, ldw, h, ldh, num_iter, residual);
+    
+    // The single precision far field perturbs the solution by roughly
+    // A^-1 (A_f - A_d) x. The preconditioner stands in for A^-1, which is
+    // enough for Output to estimate the resulting energy deviation.
+    // Its matvecs are timed and counted apart from those of the solve.
+    if (!err_code && mixed_precision_) {
+        timers_.mixed_precision_estimate.start();
+        std::vector<double> perturbation(length, 0.);
+        std::vector<double> correction(length, 0.);
+        
+        Timer matrix_vector = timers_.matrix_vector;
+        Timer upward_pass   = timers_.upward_pass;
+        Timer downward_pass = timers_.downward_pass;
+        estimating_deviation_ = true;
+        
+        BoundaryElement::matrix_vector(1., output_.potential().data(), 0., perturbation.data());
+        mixed_precision_ = false;
+        BoundaryElement::matrix_vector(-1., output_.potential().data(), 1., perturbation.data());
+        mixed_precision_ = true;
+        
+        estimating_deviation_ = false;
+        timers_.matrix_vector = matrix_vector;
+        timers_.upward_pass   = upward_pass;
+        timers_.downward_pass = downward_pass;
+        
+        if (params_.precondition_) BoundaryElement::precondition_block   (correction.data(), perturbation.data());
+        else                       BoundaryElement::precondition_diagonal(correction.data(), perturbation.data());
+        
+        output_.set_mixed_precision_correction(correction);
+        timers_.mixed_precision_estimate.stop();
+    }
 
+    if (inner_) inner_->boundary_element->delete_clusters_from_device();
     BoundaryElement::delete_clusters_from_device();
     
     output_.set_residual(residual);
     output_.set_num_iter(num_iter);
 
     if (err_code) {
-        std::cout << "GMRES error code " << err_code << ". Exiting.";
-        std::exit(1);
+        timers_.run_GMRES.stop();
+        throw std::runtime_error("GMRES error code " + std::to_string(err_code));
+    }
+    
+    console::out() << "GMRES completed. " << num_iter << " iterations, " << residual << " residual.";
+    if (inner_) console::out() << " " << inner_->total_iter << " inner iterations.";
+
+    timers_.run_GMRES.stop();
+}
+
+
+void BoundaryElement::run_block_GMRES(const std::vector<double>& source_terms, std::vector<double>& potentials)
+{
+    timers_.run_GMRES.start();
+
+    long int restrt = params_.gmres_restart_;
+    long int length = output_.potential().size();
+    long int ldw    = length;
+    long int ldh    = restrt + 1;
+    
+    long int num_systems = source_terms.size() / length;
+    long int block_size  = std::min<long int>(params_.charge_set_block_size_, num_systems);
+    
+    if (inner_) console::out() << "FGMRES is not supported for charge set blocks, using GMRES. " << std::endl;
+    
+    potentials.assign(source_terms.size(), 0.);
+    BoundaryElement::init_block(block_size);
+
+    // Each system keeps its own Krylov basis and Hessenberg matrix; the two
+    // trailing block columns gather the matvec operands of all systems.
+    std::vector<double> work_vec(ldw * (block_size * (restrt + 4) + 2 * block_size));
+    std::vector<double> h_vec   (ldh * (restrt + 2) * block_size);
+
+    BoundaryElement::copyin_clusters_to_device();
+
+    long int max_iter = 0;
+    double max_residual = 0.;
+    
+    for (long int begin = 0; begin < num_systems; begin += block_size) {
+        long int count = std::min(block_size, num_systems - begin);
+        
+        // These values are modified on return
+        double residual   = params_.gmres_residual_;
+        long int num_iter = params_.gmres_num_iter_;
+        
+        int err_code = BoundaryElement::block_gmres_(length, count,
+                                source_terms.data() + begin * length, potentials.data() + begin * length,
+                                restrt, work_vec.data(), ldw, h_vec.data(), ldh, num_iter, residual);
+        
+        max_iter     = std::max(max_iter, num_iter);
+        max_residual = std::max(max_residual, residual);
+        
+        if (err_code) {
+            BoundaryElement::delete_clusters_from_device();
+            timers_.run_GMRES.stop();
+            throw std::runtime_error("GMRES error code " + std::to_string(err_code));
+        }
     }
+
+    BoundaryElement::delete_clusters_from_device();
+    
+    output_.set_residual(max_residual);
+    output_.set_num_iter(max_iter);
     
-    std::cout << "GMRES completed. " << num_iter << " iterations, " << residual << " residual.";
+    console::out() << "Block GMRES completed. " << num_systems << " systems, at most "
+              << max_iter << " iterations, " << max_residual << " residual.";
 
     timers_.run_GMRES.stop();
 }
@@ -81,13 +255,18 @@ void BoundaryElement::run_GMRES()
 void BoundaryElement::matrix_vector(double alpha, const double* __restrict potential_old,
                                      double beta,       double* __restrict potential_new)
 {
+    const Timers_BoundaryElement::Matvec matvec_start = timers_.elapsed();
     timers_.matrix_vector.start();
+    
+    // a Session may solve again after raising the thread count
+    workspace_.reserve_threads();
+    counters_.reserve();
 
     double potential_coeff_1 = 0.5 * (1. +      params_.phys_eps_);
     double potential_coeff_2 = 0.5 * (1. + 1. / params_.phys_eps_);
     
     std::size_t potential_num = potential_.size();
-    auto* potential_temp = (double *)std::malloc(potential_num * sizeof(double));
+    double* potential_temp = potential_temp_.data();
     std::memcpy(potential_temp, potential_new, potential_num * sizeof(double));
     std::memset(potential_new, 0, potential_num * sizeof(double));
 
@@ -102,6 +281,191 @@ void BoundaryElement::matrix_vector(double alpha, const double* __restrict poten
     elements_.compute_charges(potential_old);
     BoundaryElement::upward_pass();
 
+#ifndef OPENACC_ENABLED
+    if (owner_computes_) BoundaryElement::interact_target_leaves(potential_new, potential_old);
+    else
+#endif
+    BoundaryElement::interact_target_nodes(potential_new, potential_old);
+
+#ifdef OPENACC_ENABLED
+    #pragma acc wait
+#endif
+    
+    BoundaryElement::downward_pass(potential_new);
+
+#ifdef OPENACC_ENABLED
+    #pragma acc exit data copyout(potential_old[0:potential_num], \
+                                  potential_new[0:potential_num])
+#endif
+    
+    for (std::size_t i = 0; i < potential_.size() / 2; ++i)
+        potential_new[i] = beta * potential_temp[i]
+                + alpha * (potential_coeff_1 * potential_old[i] - potential_new[i]);
+                                             
+    for (std::size_t i = potential_.size() / 2; i < potential_.size(); ++i)
+        potential_new[i] =  beta * potential_temp[i]
+                + alpha * (potential_coeff_2 * potential_old[i] - potential_new[i]);
+
+
+    timers_.matrix_vector.stop();
+    BoundaryElement::record_matvec(1, matvec_start);
+}
+
+
+void BoundaryElement::apply(const double* potential_old, double* potential_new)
+{
+    std::fill(potential_new, potential_new + potential_.size(), 0.);
+    BoundaryElement::matrix_vector(1., potential_old, 0., potential_new);
+}
+
+
+void BoundaryElement::apply_direct(const double* potential_old,
+                                   const std::vector<std::size_t>& targets,
+                                   std::vector<double>& potential_new)
+{
+    double potential_coeff_1 = 0.5 * (1. +      params_.phys_eps_);
+    double potential_coeff_2 = 0.5 * (1. + 1. / params_.phys_eps_);
+    
+    std::size_t num_elements = elements_.num();
+    std::size_t num_targets  = targets.size();
+    
+    // targets are distinct, so threads write disjoint entries
+    std::vector<double>& potential = potential_temp_;
+    std::fill(potential.begin(), potential.end(), 0.);
+    potential_new.assign(2 * num_targets, 0.);
+    
+    elements_.compute_charges(potential_old);
+
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t i = 0; i < num_targets; ++i) {
+        std::size_t j = targets[i];
+        BoundaryElement::particle_particle_interact(potential.data(), potential_old,
+                std::array<std::size_t, 2> {j, j + 1}, std::array<std::size_t, 2> {0, num_elements});
+        
+        potential_new[i]               = potential_coeff_1 * potential_old[j] - potential[j];
+        potential_new[i + num_targets] = potential_coeff_2 * potential_old[j + num_elements]
+                                       - potential[j + num_elements];
+    }
+}
+
+
+void BoundaryElement::matrix_vector_block(std::size_t num_vectors,
+                                           double alpha, const double* __restrict potential_old,
+                                           double beta,        double* __restrict potential_new)
+{
+    std::size_t potential_num = potential_.size();
+
+    // OpenACC and the single precision far field have no block kernels
+#ifndef OPENACC_ENABLED
+    if (mixed_precision_)
+#endif
+    {
+        for (std::size_t v = 0; v < num_vectors; ++v)
+            BoundaryElement::matrix_vector(alpha, potential_old + v * potential_num,
+                                           beta,  potential_new + v * potential_num);
+        return;
+    }
+
+    const Timers_BoundaryElement::Matvec matvec_start = timers_.elapsed();
+    timers_.matrix_vector.start();
+    
+    workspace_.reserve_threads();
+    counters_.reserve();
+
+    double potential_coeff_1 = 0.5 * (1. +      params_.phys_eps_);
+    double potential_coeff_2 = 0.5 * (1. + 1. / params_.phys_eps_);
+    
+    std::size_t num_elements = elements_.num();
+    double* potential_temp = block_potential_temp_.data();
+    std::memcpy(potential_temp, potential_new, num_vectors * potential_num * sizeof(double));
+    std::memset(potential_new, 0, num_vectors * potential_num * sizeof(double));
+
+    // The upward pass is linear in the charges and cheap, so it runs once per
+    // vector; the interactions then run once for the whole block.
+    for (std::size_t v = 0; v < num_vectors; ++v) {
+        BoundaryElement::clear_cluster_charges();
+        elements_.compute_charges(potential_old + v * potential_num);
+        BoundaryElement::upward_pass();
+        
+        std::copy(elements_.source_charge_ptr(),    elements_.source_charge_ptr()    + num_elements,
+                  block_source_charge_   .begin() + v * num_elements);
+        std::copy(elements_.source_charge_dx_ptr(), elements_.source_charge_dx_ptr() + num_elements,
+                  block_source_charge_dx_.begin() + v * num_elements);
+        std::copy(elements_.source_charge_dy_ptr(), elements_.source_charge_dy_ptr() + num_elements,
+                  block_source_charge_dy_.begin() + v * num_elements);
+        std::copy(elements_.source_charge_dz_ptr(), elements_.source_charge_dz_ptr() + num_elements,
+                  block_source_charge_dz_.begin() + v * num_elements);
+        
+        std::copy(interp_charge_   .begin(), interp_charge_   .end(), block_interp_charge_   .begin() + v * num_charges_);
+        std::copy(interp_charge_dx_.begin(), interp_charge_dx_.end(), block_interp_charge_dx_.begin() + v * num_charges_);
+        std::copy(interp_charge_dy_.begin(), interp_charge_dy_.end(), block_interp_charge_dy_.begin() + v * num_charges_);
+        std::copy(interp_charge_dz_.begin(), interp_charge_dz_.end(), block_interp_charge_dz_.begin() + v * num_charges_);
+    }
+    
+    std::fill(block_interp_potential_   .begin(), block_interp_potential_   .end(), 0.);
+    std::fill(block_interp_potential_dx_.begin(), block_interp_potential_dx_.end(), 0.);
+    std::fill(block_interp_potential_dy_.begin(), block_interp_potential_dy_.end(), 0.);
+    std::fill(block_interp_potential_dz_.begin(), block_interp_potential_dz_.end(), 0.);
+
+    BoundaryElement::interact_target_leaves_block(num_vectors, potential_new, potential_old);
+    
+    for (std::size_t v = 0; v < num_vectors; ++v) {
+        std::size_t begin = v * num_charges_, end = begin + num_charges_;
+        std::copy(block_interp_potential_   .begin() + begin, block_interp_potential_   .begin() + end, interp_potential_   .begin());
+        std::copy(block_interp_potential_dx_.begin() + begin, block_interp_potential_dx_.begin() + end, interp_potential_dx_.begin());
+        std::copy(block_interp_potential_dy_.begin() + begin, block_interp_potential_dy_.begin() + end, interp_potential_dy_.begin());
+        std::copy(block_interp_potential_dz_.begin() + begin, block_interp_potential_dz_.begin() + end, interp_potential_dz_.begin());
+        
+        BoundaryElement::downward_pass(potential_new + v * potential_num);
+    }
+    
+    for (std::size_t v = 0; v < num_vectors; ++v) {
+        const double* old_v  = potential_old  + v * potential_num;
+        const double* temp_v = potential_temp + v * potential_num;
+        double* new_v        = potential_new  + v * potential_num;
+        
+        for (std::size_t i = 0; i < num_elements; ++i)
+            new_v[i] = beta * temp_v[i] + alpha * (potential_coeff_1 * old_v[i] - new_v[i]);
+        
+        for (std::size_t i = num_elements; i < potential_num; ++i)
+            new_v[i] = beta * temp_v[i] + alpha * (potential_coeff_2 * old_v[i] - new_v[i]);
+    }
+
+    timers_.matrix_vector.stop();
+    BoundaryElement::record_matvec(num_vectors, matvec_start);
+}
+
+
+void BoundaryElement::record_matvec(std::size_t num_vectors, const Timers_BoundaryElement::Matvec& start)
+{
+    InteractionCounters::Counts counts = counters_.collect();
+    
+    Timers_BoundaryElement::Matvec matvec = timers_.elapsed();
+    matvec.num_vectors    = num_vectors;
+    matvec.seconds       -= start.seconds;
+    matvec.upward_pass   -= start.upward_pass;
+    matvec.downward_pass -= start.downward_pass;
+    matvec.counts         = counts;
+    
+    if (estimating_deviation_) {
+        timers_.estimate_matvecs.push_back(matvec);
+        return;
+    }
+    
+    timers_.particle_particle_interact.add(counts.seconds[InteractionCounters::PP]);
+    timers_.particle_cluster_interact .add(counts.seconds[InteractionCounters::PC]);
+    timers_.cluster_particle_interact .add(counts.seconds[InteractionCounters::CP]);
+    timers_.cluster_cluster_interact  .add(counts.seconds[InteractionCounters::CC]);
+    timers_.interactions.add(counts);
+    timers_.matvecs.push_back(matvec);
+}
+
+
+void BoundaryElement::interact_target_nodes(double* __restrict potential_new,
+                                      const double* __restrict potential_old)
+{
 #ifdef OPENMP_ENABLED
     #pragma omp parallel for
 #endif
@@ -122,33 +486,103 @@ void BoundaryElement::matrix_vector(double alpha, const double* __restrict poten
         for (auto source_node_idx : interaction_list_.cluster_cluster(target_node_idx))
             BoundaryElement::cluster_cluster_interact(potential_new, target_node_idx, source_node_idx);
     }
+}
 
-#ifdef OPENACC_ENABLED
-    #pragma acc wait
+
+void BoundaryElement::interact_target_leaves(double* __restrict potential_new,
+                                       const double* __restrict potential_old)
+{
+    // Particle targets: every element belongs to exactly one leaf, so each leaf
+    // gathers the PP and PC interactions of itself and all of its ancestors,
+    // restricted to its own elements. Threads write disjoint element ranges,
+    // and each element is summed in the same order regardless of thread count.
+
+    const auto& leaves = tree_.leaves();
+    std::size_t num_leaves = leaves.size();
+
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
 #endif
-    
-#ifdef OPENACC_ENABLED
-    #pragma acc wait
+    for (std::size_t leaf = 0; leaf < num_leaves; ++leaf) {
+
+        auto leaf_element_idxs = tree_.node_particle_idxs(leaves[leaf]);
+        std::size_t target_node_idx = leaves[leaf];
+
+        while (true) {
+            for (auto source_node_idx : interaction_list_.particle_particle(target_node_idx))
+                BoundaryElement::particle_particle_interact(potential_new, potential_old,
+                        leaf_element_idxs, tree_.node_particle_idxs(source_node_idx));
+
+            for (auto source_node_idx : interaction_list_.particle_cluster(target_node_idx))
+                BoundaryElement::particle_cluster_interact(potential_new, leaf_element_idxs, source_node_idx);
+
+            if (target_node_idx == 0) break;
+            target_node_idx = tree_.node_parent_idx(target_node_idx);
+        }
+    }
+
+    // Cluster targets: a node's interpolation potentials are only written by
+    // that node's own CP and CC interactions.
+
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
 #endif
-    
-    BoundaryElement::downward_pass(potential_new);
+    for (std::size_t target_node_idx = 0; target_node_idx < tree_.num_nodes(); ++target_node_idx) {
 
-#ifdef OPENACC_ENABLED
-    #pragma acc exit data copyout(potential_old[0:potential_num], \
-                                  potential_new[0:potential_num])
+        for (auto source_node_idx : interaction_list_.cluster_particle(target_node_idx))
+            BoundaryElement::cluster_particle_interact(potential_new,
+                    target_node_idx, tree_.node_particle_idxs(source_node_idx));
+
+        for (auto source_node_idx : interaction_list_.cluster_cluster(target_node_idx))
+            BoundaryElement::cluster_cluster_interact(potential_new, target_node_idx, source_node_idx);
+    }
+}
+
+
+void BoundaryElement::interact_target_leaves_block(std::size_t num_vectors,
+                                             double* __restrict potential_new,
+                                       const double* __restrict potential_old)
+{
+    // Same ownership as interact_target_leaves: leaves own their elements in
+    // every vector, and nodes own their interpolation potentials.
+
+    const auto& leaves = tree_.leaves();
+    std::size_t num_leaves = leaves.size();
+
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
 #endif
-    
-    for (std::size_t i = 0; i < potential_.size() / 2; ++i)
-        potential_new[i] = beta * potential_temp[i]
-                + alpha * (potential_coeff_1 * potential_old[i] - potential_new[i]);
-                                             
-    for (std::size_t i = potential_.size() / 2; i < potential_.size(); ++i)
-        potential_new[i] =  beta * potential_temp[i]
-                + alpha * (potential_coeff_2 * potential_old[i] - potential_new[i]);
-                
-    std::free(potential_temp);
+    for (std::size_t leaf = 0; leaf < num_leaves; ++leaf) {
 
-    timers_.matrix_vector.stop();
+        auto leaf_element_idxs = tree_.node_particle_idxs(leaves[leaf]);
+        std::size_t target_node_idx = leaves[leaf];
+
+        while (true) {
+            for (auto source_node_idx : interaction_list_.particle_particle(target_node_idx))
+                BoundaryElement::particle_particle_interact_block(num_vectors, potential_new, potential_old,
+                        leaf_element_idxs, tree_.node_particle_idxs(source_node_idx));
+
+            for (auto source_node_idx : interaction_list_.particle_cluster(target_node_idx))
+                BoundaryElement::particle_cluster_interact_block(num_vectors, potential_new,
+                        leaf_element_idxs, source_node_idx);
+
+            if (target_node_idx == 0) break;
+            target_node_idx = tree_.node_parent_idx(target_node_idx);
+        }
+    }
+
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t target_node_idx = 0; target_node_idx < tree_.num_nodes(); ++target_node_idx) {
+
+        for (auto source_node_idx : interaction_list_.cluster_particle(target_node_idx))
+            BoundaryElement::cluster_particle_interact_block(num_vectors,
+                    target_node_idx, tree_.node_particle_idxs(source_node_idx));
+
+        for (auto source_node_idx : interaction_list_.cluster_cluster(target_node_idx))
+            BoundaryElement::cluster_cluster_interact_block(num_vectors, target_node_idx, source_node_idx);
+    }
 }
 
 
@@ -157,7 +591,9 @@ void BoundaryElement::particle_particle_interact(double* __restrict potential,
                                           std::array<std::size_t, 2> target_node_element_idxs,
                                           std::array<std::size_t, 2> source_node_element_idxs)
 {
-    timers_.particle_particle_interact.start();
+    CountedInteraction counted(counters_, InteractionCounters::PP,
+                               target_node_element_idxs[1] - target_node_element_idxs[0],
+                               source_node_element_idxs[1] - source_node_element_idxs[0]);
 
     std::size_t target_node_element_begin = target_node_element_idxs[0];
     std::size_t target_node_element_end   = target_node_element_idxs[1];
@@ -179,14 +615,13 @@ void BoundaryElement::particle_particle_interact(double* __restrict potential,
 
     const double* __restrict elements_area_ptr = elements_.area_ptr();
     
+#ifdef OPENACC_ENABLED
     std::size_t num_elements = elements_.num();
 
-#ifdef OPENACC_ENABLED
     int stream_id = std::rand() % 3;
     #pragma acc parallel loop async(stream_id) present(elements_x_ptr,  elements_y_ptr,  elements_z_ptr, \
                                       elements_nx_ptr, elements_ny_ptr, elements_nz_ptr, \
                                       elements_area_ptr, potential, potential_old)
-#endif
     for (std::size_t j = target_node_element_begin; j < target_node_element_end; ++j) {
         
         double target_x = elements_x_ptr[j];
@@ -200,9 +635,7 @@ void BoundaryElement::particle_particle_interact(double* __restrict potential,
         double pot_temp_1 = 0.;
         double pot_temp_2 = 0.;
 
-#ifdef OPENACC_ENABLED
         #pragma acc loop reduction(+:pot_temp_1,pot_temp_2)
-#endif
         for (std::size_t k = source_node_element_begin; k < source_node_element_end; ++k) {
         
             double source_x = elements_x_ptr[k];
@@ -249,21 +682,47 @@ void BoundaryElement::particle_particle_interact(double* __restrict potential,
             }
         }
         
-#ifdef OPENACC_ENABLED
         #pragma acc atomic update
-#elif OPENMP_ENABLED
-        #pragma omp atomic update
-#endif
         potential[j]                += pot_temp_1;
-#ifdef OPENACC_ENABLED
         #pragma acc atomic update
-#elif OPENMP_ENABLED
-        #pragma omp atomic update
-#endif
         potential[j + num_elements] += pot_temp_2;
     }
 
-    timers_.particle_particle_interact.stop();
+#else
+    std::size_t num_elements = elements_.num();
+    std::size_t num_targets  = target_node_element_end - target_node_element_begin;
+
+    near_field::Geometry geom {elements_x_ptr,  elements_y_ptr,  elements_z_ptr,
+                               elements_nx_ptr, elements_ny_ptr, elements_nz_ptr,
+                               elements_area_ptr, num_elements, eps, kappa, kappa2};
+
+    double* __restrict pot_temp_1_ptr = workspace_.doubles();
+    double* __restrict pot_temp_2_ptr = pot_temp_1_ptr + num_targets;
+    std::fill(pot_temp_1_ptr, pot_temp_1_ptr + 2 * num_targets, 0.);
+
+    near_field_kernel_(geom, potential_old,
+                       target_node_element_begin, target_node_element_end,
+                       source_node_element_begin, source_node_element_end,
+                       pot_temp_1_ptr, pot_temp_2_ptr);
+
+    for (std::size_t jj = 0; jj < num_targets; ++jj) {
+        std::size_t j = target_node_element_begin + jj;
+
+        if (owner_computes_) {
+            potential[j]                += pot_temp_1_ptr[jj];
+            potential[j + num_elements] += pot_temp_2_ptr[jj];
+        } else {
+#ifdef OPENMP_ENABLED
+            #pragma omp atomic update
+#endif
+            potential[j]                += pot_temp_1_ptr[jj];
+#ifdef OPENMP_ENABLED
+            #pragma omp atomic update
+#endif
+            potential[j + num_elements] += pot_temp_2_ptr[jj];
+        }
+    }
+#endif
 }
 
 
@@ -271,7 +730,14 @@ void BoundaryElement::particle_cluster_interact(double* __restrict potential,
                                          std::array<std::size_t, 2> target_node_element_idxs,
                                          std::size_t source_node_idx)
 {
-    timers_.particle_cluster_interact.start();
+    CountedInteraction counted(counters_, InteractionCounters::PC,
+                               target_node_element_idxs[1] - target_node_element_idxs[0],
+                               num_charges_per_node_);
+
+    if (mixed_precision_) {
+        BoundaryElement::particle_cluster_interact_mixed(potential, target_node_element_idxs, source_node_idx);
+        return;
+    }
 
     std::size_t num_elements   = elements_.num();
     int num_interp_pts_per_node = interp_pts_.num_interp_pts_per_node();
@@ -376,23 +842,32 @@ void BoundaryElement::particle_cluster_interact(double* __restrict potential,
         }
         }
         
+        double pot_temp_1 = targets_q_ptr   [j] * pot_comp_;
+        double pot_temp_2 = targets_q_dx_ptr[j] * pot_comp_dx
+                          + targets_q_dy_ptr[j] * pot_comp_dy
+                          + targets_q_dz_ptr[j] * pot_comp_dz;
+
 #ifdef OPENACC_ENABLED
         #pragma acc atomic update
-#elif OPENMP_ENABLED
-        #pragma omp atomic update
-#endif
-        potential[j]                += targets_q_ptr   [j] * pot_comp_;
-#ifdef OPENACC_ENABLED
+        potential[j]                += pot_temp_1;
         #pragma acc atomic update
-#elif OPENMP_ENABLED
-        #pragma omp atomic update
+        potential[j + num_elements] += pot_temp_2;
+#else
+        if (owner_computes_) {
+            potential[j]                += pot_temp_1;
+            potential[j + num_elements] += pot_temp_2;
+        } else {
+#ifdef OPENMP_ENABLED
+            #pragma omp atomic update
+#endif
+            potential[j]                += pot_temp_1;
+#ifdef OPENMP_ENABLED
+            #pragma omp atomic update
+#endif
+            potential[j + num_elements] += pot_temp_2;
+        }
 #endif
-        potential[j + num_elements] += targets_q_dx_ptr[j] * pot_comp_dx
-                                     + targets_q_dy_ptr[j] * pot_comp_dy
-                                     + targets_q_dz_ptr[j] * pot_comp_dz;
     }
-
-    timers_.particle_cluster_interact.stop();
 }
 
 
@@ -400,7 +875,14 @@ void BoundaryElement::cluster_particle_interact(double* __restrict potential,
                                          std::size_t target_node_idx,
                                          std::array<std::size_t, 2> source_node_element_idxs)
 {
-    timers_.cluster_particle_interact.start();
+    CountedInteraction counted(counters_, InteractionCounters::CP,
+                               num_charges_per_node_,
+                               source_node_element_idxs[1] - source_node_element_idxs[0]);
+
+    if (mixed_precision_) {
+        BoundaryElement::cluster_particle_interact_mixed(target_node_idx, source_node_element_idxs);
+        return;
+    }
 
     int num_interp_pts_per_node = interp_pts_.num_interp_pts_per_node();
     int num_potentials_per_node = num_charges_per_node_;
@@ -504,33 +986,23 @@ void BoundaryElement::cluster_particle_interact(double* __restrict potential,
     
 #ifdef OPENACC_ENABLED
         #pragma acc atomic update
-#elif OPENMP_ENABLED
-        #pragma omp atomic update
 #endif
         clusters_p_ptr   [jj] += pot_comp_;
 #ifdef OPENACC_ENABLED
         #pragma acc atomic update
-#elif OPENMP_ENABLED
-        #pragma omp atomic update
 #endif
         clusters_p_dx_ptr[jj] += pot_comp_dx;
 #ifdef OPENACC_ENABLED
         #pragma acc atomic update
-#elif OPENMP_ENABLED
-        #pragma omp atomic update
 #endif
         clusters_p_dy_ptr[jj] += pot_comp_dy;
 #ifdef OPENACC_ENABLED
         #pragma acc atomic update
-#elif OPENMP_ENABLED
-        #pragma omp atomic update
 #endif
         clusters_p_dz_ptr[jj] += pot_comp_dz;
     }
     }
     }
-
-    timers_.cluster_particle_interact.stop();
 }
 
 
@@ -538,7 +1010,14 @@ void BoundaryElement::cluster_cluster_interact(double* __restrict potential,
                                         std::size_t target_node_idx,
                                         std::size_t source_node_idx)
 {
-    timers_.cluster_cluster_interact.start();
+    CountedInteraction counted(counters_, InteractionCounters::CC,
+                               num_charges_per_node_,
+                               num_charges_per_node_);
+
+    if (mixed_precision_) {
+        BoundaryElement::cluster_cluster_interact_mixed(target_node_idx, source_node_idx);
+        return;
+    }
 
     int num_interp_pts_per_node = interp_pts_.num_interp_pts_per_node();
     int num_charges_per_node    = num_charges_per_node_;
@@ -645,33 +1124,353 @@ void BoundaryElement::cluster_cluster_interact(double* __restrict potential,
     
 #ifdef OPENACC_ENABLED
         #pragma acc atomic update
-#elif OPENMP_ENABLED
-        #pragma omp atomic update
 #endif
         clusters_p_ptr   [jj] += pot_comp_;
 #ifdef OPENACC_ENABLED
         #pragma acc atomic update
-#elif OPENMP_ENABLED
-        #pragma omp atomic update
 #endif
         clusters_p_dx_ptr[jj] += pot_comp_dx;
 #ifdef OPENACC_ENABLED
         #pragma acc atomic update
-#elif OPENMP_ENABLED
-        #pragma omp atomic update
 #endif
         clusters_p_dy_ptr[jj] += pot_comp_dy;
 #ifdef OPENACC_ENABLED
         #pragma acc atomic update
-#elif OPENMP_ENABLED
-        #pragma omp atomic update
 #endif
         clusters_p_dz_ptr[jj] += pot_comp_dz;
     }
     }
     }
+}
+
+
+void BoundaryElement::particle_cluster_interact_mixed(double* __restrict potential,
+                                         std::array<std::size_t, 2> target_node_element_idxs,
+                                         std::size_t source_node_idx)
+{
+    constexpr std::size_t chunk = 256;
+    
+    std::size_t num_elements         = elements_.num();
+    std::size_t num_charges_per_node = num_charges_per_node_;
+    
+    const double* __restrict targets_q_ptr    = elements_.target_charge_ptr();
+    const double* __restrict targets_q_dx_ptr = elements_.target_charge_dx_ptr();
+    const double* __restrict targets_q_dy_ptr = elements_.target_charge_dy_ptr();
+    const double* __restrict targets_q_dz_ptr = elements_.target_charge_dz_ptr();
+    
+    far_field::Cloud targets {elements_x_f_.data(), elements_y_f_.data(), elements_z_f_.data(),
+                              nullptr, nullptr, nullptr, nullptr};
+    far_field::Cloud sources {clusters_x_f_.data(), clusters_y_f_.data(), clusters_z_f_.data(),
+                              interp_charge_f_.data(),    interp_charge_dx_f_.data(),
+                              interp_charge_dy_f_.data(), interp_charge_dz_f_.data()};
+    
+    float pot[chunk], pot_dx[chunk], pot_dy[chunk], pot_dz[chunk];
+    
+    for (std::size_t begin = target_node_element_idxs[0]; begin < target_node_element_idxs[1]; begin += chunk) {
+        std::size_t end = std::min(begin + chunk, target_node_element_idxs[1]);
+        
+        std::fill(pot,    pot    + chunk, 0.f);
+        std::fill(pot_dx, pot_dx + chunk, 0.f);
+        std::fill(pot_dy, pot_dy + chunk, 0.f);
+        std::fill(pot_dz, pot_dz + chunk, 0.f);
+        
+        far_field_kernel_(targets, begin, end,
+                          sources, source_node_idx * num_charges_per_node, (source_node_idx + 1) * num_charges_per_node,
+                          params_.phys_eps_, params_.phys_kappa_, pot, pot_dx, pot_dy, pot_dz);
+        
+        for (std::size_t j = begin; j < end; ++j) {
+            double pot_temp_1 = targets_q_ptr   [j] * pot   [j - begin];
+            double pot_temp_2 = targets_q_dx_ptr[j] * pot_dx[j - begin]
+                              + targets_q_dy_ptr[j] * pot_dy[j - begin]
+                              + targets_q_dz_ptr[j] * pot_dz[j - begin];
+            
+            if (owner_computes_) {
+                potential[j]                += pot_temp_1;
+                potential[j + num_elements] += pot_temp_2;
+            } else {
+#ifdef OPENMP_ENABLED
+                #pragma omp atomic update
+#endif
+                potential[j]                += pot_temp_1;
+#ifdef OPENMP_ENABLED
+                #pragma omp atomic update
+#endif
+                potential[j + num_elements] += pot_temp_2;
+            }
+        }
+    }
+}
+
+
+void BoundaryElement::cluster_particle_interact_mixed(std::size_t target_node_idx,
+                                         std::array<std::size_t, 2> source_node_element_idxs)
+{
+    std::size_t num_charges_per_node = num_charges_per_node_;
+    std::size_t target_begin = target_node_idx * num_charges_per_node;
+    
+    far_field::Cloud targets {clusters_x_f_.data(), clusters_y_f_.data(), clusters_z_f_.data(),
+                              nullptr, nullptr, nullptr, nullptr};
+    far_field::Cloud sources {elements_x_f_.data(), elements_y_f_.data(), elements_z_f_.data(),
+                              source_charge_f_.data(),    source_charge_dx_f_.data(),
+                              source_charge_dy_f_.data(), source_charge_dz_f_.data()};
+    
+    far_field_kernel_(targets, target_begin, target_begin + num_charges_per_node,
+                      sources, source_node_element_idxs[0], source_node_element_idxs[1],
+                      params_.phys_eps_, params_.phys_kappa_,
+                      interp_potential_f_   .data() + target_begin, interp_potential_dx_f_.data() + target_begin,
+                      interp_potential_dy_f_.data() + target_begin, interp_potential_dz_f_.data() + target_begin);
+}
+
+
+void BoundaryElement::cluster_cluster_interact_mixed(std::size_t target_node_idx, std::size_t source_node_idx)
+{
+    std::size_t num_charges_per_node = num_charges_per_node_;
+    std::size_t target_begin = target_node_idx * num_charges_per_node;
+    std::size_t source_begin = source_node_idx * num_charges_per_node;
+    
+    far_field::Cloud clusters {clusters_x_f_.data(), clusters_y_f_.data(), clusters_z_f_.data(),
+                               interp_charge_f_.data(),    interp_charge_dx_f_.data(),
+                               interp_charge_dy_f_.data(), interp_charge_dz_f_.data()};
+    
+    far_field_kernel_(clusters, target_begin, target_begin + num_charges_per_node,
+                      clusters, source_begin, source_begin + num_charges_per_node,
+                      params_.phys_eps_, params_.phys_kappa_,
+                      interp_potential_f_   .data() + target_begin, interp_potential_dx_f_.data() + target_begin,
+                      interp_potential_dy_f_.data() + target_begin, interp_potential_dz_f_.data() + target_begin);
+}
+
+
+void BoundaryElement::particle_particle_interact_block(std::size_t num_vectors,
+                                          double* __restrict potential,
+                                          const double* __restrict potential_old,
+                                          std::array<std::size_t, 2> target_node_element_idxs,
+                                          std::array<std::size_t, 2> source_node_element_idxs)
+{
+    CountedInteraction counted(counters_, InteractionCounters::PP,
+                               target_node_element_idxs[1] - target_node_element_idxs[0],
+                               source_node_element_idxs[1] - source_node_element_idxs[0], num_vectors);
+
+    std::size_t num_elements  = elements_.num();
+    std::size_t potential_num = 2 * num_elements;
+    std::size_t target_begin  = target_node_element_idxs[0];
+    std::size_t num_targets   = target_node_element_idxs[1] - target_begin;
+
+    near_field::Geometry geom {elements_.x_ptr(),  elements_.y_ptr(),  elements_.z_ptr(),
+                               elements_.nx_ptr(), elements_.ny_ptr(), elements_.nz_ptr(),
+                               elements_.area_ptr(), num_elements,
+                               params_.phys_eps_, params_.phys_kappa_, params_.phys_kappa2_};
+
+    double* __restrict pot_temp_1_ptr = workspace_.doubles();
+    double* __restrict pot_temp_2_ptr = pot_temp_1_ptr + num_vectors * num_targets;
+    std::fill(pot_temp_1_ptr, pot_temp_1_ptr + 2 * num_vectors * num_targets, 0.);
+
+    near_field_block_kernel_(geom, potential_old, num_vectors,
+                             target_node_element_idxs[0], target_node_element_idxs[1],
+                             source_node_element_idxs[0], source_node_element_idxs[1],
+                             pot_temp_1_ptr, pot_temp_2_ptr);
+
+    for (std::size_t v = 0; v < num_vectors; ++v) {
+        double* potential_v = potential + v * potential_num + target_begin;
+        for (std::size_t jj = 0; jj < num_targets; ++jj) {
+            potential_v[jj]                += pot_temp_1_ptr[v * num_targets + jj];
+            potential_v[jj + num_elements] += pot_temp_2_ptr[v * num_targets + jj];
+        }
+    }
+}
+
+
+void BoundaryElement::particle_cluster_interact_block(std::size_t num_vectors,
+                                         double* __restrict potential,
+                                         std::array<std::size_t, 2> target_node_element_idxs,
+                                         std::size_t source_node_idx)
+{
+    CountedInteraction counted(counters_, InteractionCounters::PC,
+                               target_node_element_idxs[1] - target_node_element_idxs[0],
+                               num_charges_per_node_, num_vectors);
+
+    std::size_t num_elements  = elements_.num();
+    std::size_t potential_num = 2 * num_elements;
+    std::size_t target_begin  = target_node_element_idxs[0];
+    std::size_t target_end    = target_node_element_idxs[1];
+    std::size_t num_targets   = target_end - target_begin;
+    std::size_t source_begin  = source_node_idx * num_charges_per_node_;
+    
+    const double* __restrict targets_q_ptr    = elements_.target_charge_ptr();
+    const double* __restrict targets_q_dx_ptr = elements_.target_charge_dx_ptr();
+    const double* __restrict targets_q_dy_ptr = elements_.target_charge_dy_ptr();
+    const double* __restrict targets_q_dz_ptr = elements_.target_charge_dz_ptr();
+
+    far_field::BlockCloud targets {elements_.x_ptr(), elements_.y_ptr(), elements_.z_ptr(),
+                                   nullptr, nullptr, nullptr, nullptr, 0};
+    far_field::BlockCloud sources {clusters_x_.data(), clusters_y_.data(), clusters_z_.data(),
+                                   block_interp_charge_   .data(), block_interp_charge_dx_.data(),
+                                   block_interp_charge_dy_.data(), block_interp_charge_dz_.data(), num_charges_};
+
+    std::size_t block = num_vectors * num_targets;
+    double* __restrict pot    = workspace_.doubles();
+    double* __restrict pot_dx = pot    + block;
+    double* __restrict pot_dy = pot_dx + block;
+    double* __restrict pot_dz = pot_dy + block;
+    std::fill(pot, pot + 4 * block, 0.);
+    
+    far_field::interact_block(targets, target_begin, target_end,
+                              sources, source_begin, source_begin + num_charges_per_node_,
+                              num_vectors, params_.phys_eps_, params_.phys_kappa_,
+                              pot, pot_dx, pot_dy, pot_dz, num_targets);
+
+    for (std::size_t v = 0; v < num_vectors; ++v) {
+        double* potential_v = potential + v * potential_num;
+        for (std::size_t j = target_begin; j < target_end; ++j) {
+            std::size_t jj = v * num_targets + j - target_begin;
+            potential_v[j]                += targets_q_ptr   [j] * pot   [jj];
+            potential_v[j + num_elements] += targets_q_dx_ptr[j] * pot_dx[jj]
+                                           + targets_q_dy_ptr[j] * pot_dy[jj]
+                                           + targets_q_dz_ptr[j] * pot_dz[jj];
+        }
+    }
+}
+
+
+void BoundaryElement::cluster_particle_interact_block(std::size_t num_vectors,
+                                         std::size_t target_node_idx,
+                                         std::array<std::size_t, 2> source_node_element_idxs)
+{
+    CountedInteraction counted(counters_, InteractionCounters::CP,
+                               num_charges_per_node_,
+                               source_node_element_idxs[1] - source_node_element_idxs[0], num_vectors);
+
+    std::size_t target_begin = target_node_idx * num_charges_per_node_;
+    
+    far_field::BlockCloud targets {clusters_x_.data(), clusters_y_.data(), clusters_z_.data(),
+                                   nullptr, nullptr, nullptr, nullptr, 0};
+    far_field::BlockCloud sources {elements_.x_ptr(), elements_.y_ptr(), elements_.z_ptr(),
+                                   block_source_charge_   .data(), block_source_charge_dx_.data(),
+                                   block_source_charge_dy_.data(), block_source_charge_dz_.data(), elements_.num()};
+    
+    far_field::interact_block(targets, target_begin, target_begin + num_charges_per_node_,
+                              sources, source_node_element_idxs[0], source_node_element_idxs[1],
+                              num_vectors, params_.phys_eps_, params_.phys_kappa_,
+                              block_interp_potential_   .data() + target_begin,
+                              block_interp_potential_dx_.data() + target_begin,
+                              block_interp_potential_dy_.data() + target_begin,
+                              block_interp_potential_dz_.data() + target_begin, num_charges_);
+}
+
+
+void BoundaryElement::cluster_cluster_interact_block(std::size_t num_vectors,
+                                        std::size_t target_node_idx, std::size_t source_node_idx)
+{
+    CountedInteraction counted(counters_, InteractionCounters::CC,
+                               num_charges_per_node_,
+                               num_charges_per_node_, num_vectors);
+
+    std::size_t target_begin = target_node_idx * num_charges_per_node_;
+    std::size_t source_begin = source_node_idx * num_charges_per_node_;
+    
+    far_field::BlockCloud clusters {clusters_x_.data(), clusters_y_.data(), clusters_z_.data(),
+                                    block_interp_charge_   .data(), block_interp_charge_dx_.data(),
+                                    block_interp_charge_dy_.data(), block_interp_charge_dz_.data(), num_charges_};
+    
+    far_field::interact_block(clusters, target_begin, target_begin + num_charges_per_node_,
+                              clusters, source_begin, source_begin + num_charges_per_node_,
+                              num_vectors, params_.phys_eps_, params_.phys_kappa_,
+                              block_interp_potential_   .data() + target_begin,
+                              block_interp_potential_dx_.data() + target_begin,
+                              block_interp_potential_dy_.data() + target_begin,
+                              block_interp_potential_dz_.data() + target_begin, num_charges_);
+}
+
+
+void BoundaryElement::init_mixed_precision()
+{
+#ifdef OPENACC_ENABLED
+    if (mixed_precision_) {
+        console::out() << "mixed precision is not supported with OpenACC, using double. " << std::endl;
+        mixed_precision_ = false;
+    }
+#endif
+    if (!mixed_precision_) return;
+    
+    std::size_t num_elements = elements_.num();
+    
+    elements_x_f_.assign(elements_.x_ptr(), elements_.x_ptr() + num_elements);
+    elements_y_f_.assign(elements_.y_ptr(), elements_.y_ptr() + num_elements);
+    elements_z_f_.assign(elements_.z_ptr(), elements_.z_ptr() + num_elements);
+    
+    source_charge_f_   .resize(num_elements);
+    source_charge_dx_f_.resize(num_elements);
+    source_charge_dy_f_.resize(num_elements);
+    source_charge_dz_f_.resize(num_elements);
+    
+    interp_charge_f_   .resize(num_charges_);
+    interp_charge_dx_f_.resize(num_charges_);
+    interp_charge_dy_f_.resize(num_charges_);
+    interp_charge_dz_f_.resize(num_charges_);
+    
+    interp_potential_f_   .resize(num_charges_);
+    interp_potential_dx_f_.resize(num_charges_);
+    interp_potential_dy_f_.resize(num_charges_);
+    interp_potential_dz_f_.resize(num_charges_);
+    
+    clusters_x_f_.resize(num_charges_);
+    clusters_y_f_.resize(num_charges_);
+    clusters_z_f_.resize(num_charges_);
+    
+    int num_interp_pts_per_node = interp_pts_.num_interp_pts_per_node();
+    const double* clusters_x_ptr = interp_pts_.interp_x_ptr();
+    const double* clusters_y_ptr = interp_pts_.interp_y_ptr();
+    const double* clusters_z_ptr = interp_pts_.interp_z_ptr();
+    
+    for (std::size_t node_idx = 0; node_idx < tree_.num_nodes(); ++node_idx) {
+        std::size_t interp_pts_begin = node_idx * num_interp_pts_per_node;
+        std::size_t kk = node_idx * num_charges_per_node_;
+        
+        for (int k1 = 0; k1 < num_interp_pts_per_node; ++k1) {
+        for (int k2 = 0; k2 < num_interp_pts_per_node; ++k2) {
+        for (int k3 = 0; k3 < num_interp_pts_per_node; ++k3, ++kk) {
+            clusters_x_f_[kk] = clusters_x_ptr[interp_pts_begin + k1];
+            clusters_y_f_[kk] = clusters_y_ptr[interp_pts_begin + k2];
+            clusters_z_f_[kk] = clusters_z_ptr[interp_pts_begin + k3];
+        }
+        }
+        }
+    }
+}
 
-    timers_.cluster_cluster_interact.stop();
+
+void BoundaryElement::convert_to_mixed_precision()
+{
+    std::size_t num_elements = elements_.num();
+    
+    const double* __restrict sources_q_ptr    = elements_.source_charge_ptr();
+    const double* __restrict sources_q_dx_ptr = elements_.source_charge_dx_ptr();
+    const double* __restrict sources_q_dy_ptr = elements_.source_charge_dy_ptr();
+    const double* __restrict sources_q_dz_ptr = elements_.source_charge_dz_ptr();
+    
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for
+#endif
+    for (std::size_t i = 0; i < num_elements; ++i) {
+        source_charge_f_   [i] = sources_q_ptr   [i];
+        source_charge_dx_f_[i] = sources_q_dx_ptr[i];
+        source_charge_dy_f_[i] = sources_q_dy_ptr[i];
+        source_charge_dz_f_[i] = sources_q_dz_ptr[i];
+    }
+    
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for
+#endif
+    for (std::size_t i = 0; i < num_charges_; ++i) {
+        interp_charge_f_   [i] = interp_charge_   [i];
+        interp_charge_dx_f_[i] = interp_charge_dx_[i];
+        interp_charge_dy_f_[i] = interp_charge_dy_[i];
+        interp_charge_dz_f_[i] = interp_charge_dz_[i];
+        
+        interp_potential_f_   [i] = 0.f;
+        interp_potential_dx_f_[i] = 0.f;
+        interp_potential_dy_f_[i] = 0.f;
+        interp_potential_dz_f_[i] = 0.f;
+    }
 }
 
 
@@ -697,14 +1496,10 @@ void BoundaryElement::upward_pass()
     const double* __restrict sources_q_dy_ptr = elements_.source_charge_dy_ptr();
     const double* __restrict sources_q_dz_ptr = elements_.source_charge_dz_ptr();
         
-    std::vector<double> weights (interp_pts_.num_interp_pts_per_node());
-    double* weights_ptr = weights.data();
-    int weights_num = weights.size();
-    
-    for (int i = 0; i < weights_num; ++i) {
-        weights[i] = ((i % 2 == 0)? 1 : -1);
-        if (i == 0 || i == weights_num-1) weights[i] = ((i % 2 == 0)? 1 : -1) * 0.5;
-    }
+    const double* weights_ptr = interp_pts_.weights_ptr();
+#ifdef OPENACC_ENABLED
+    int weights_num = interp_pts_.num_interp_pts_per_node();
+#endif
 
     int num_interp_pts_per_node = interp_pts_.num_interp_pts_per_node();
     
@@ -712,7 +1507,16 @@ void BoundaryElement::upward_pass()
     #pragma acc enter data copyin(weights_ptr[0:weights_num])
 #endif
     
+#ifdef OPENACC_ENABLED
     for (std::size_t node_idx = 0; node_idx < tree_.num_nodes(); ++node_idx) {
+#else
+    const auto& leaves = tree_.leaves();
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t leaf = 0; leaf < leaves.size(); ++leaf) {
+        std::size_t node_idx = leaves[leaf];
+#endif
         
         auto particle_idxs = tree_.node_particle_idxs(node_idx);
         
@@ -722,15 +1526,42 @@ void BoundaryElement::upward_pass()
         std::size_t particle_start = particle_idxs[0];
         std::size_t num_particles  = particle_idxs[1] - particle_idxs[0];
         
-        std::vector<int> exact_idx_x(num_particles);
-        std::vector<int> exact_idx_y(num_particles);
-        std::vector<int> exact_idx_z(num_particles);
-        std::vector<double> denominator(num_particles);
+#ifndef OPENACC_ENABLED
+        if (interp_basis_begin_[node_idx] != NOT_CACHED) {
+            const double* basis_ptr = &interp_basis_[interp_basis_begin_[node_idx]];
+            
+            for (std::size_t i = 0; i < num_particles; ++i) {
+                const double* basis_x = basis_ptr + 3 * num_interp_pts_per_node * i;
+                const double* basis_y = basis_x + num_interp_pts_per_node;
+                const double* basis_z = basis_y + num_interp_pts_per_node;
+                
+                double q    = sources_q_ptr   [particle_start + i];
+                double q_dx = sources_q_dx_ptr[particle_start + i];
+                double q_dy = sources_q_dy_ptr[particle_start + i];
+                double q_dz = sources_q_dz_ptr[particle_start + i];
+                
+                std::size_t kk = node_charges_start;
+                for (int k1 = 0; k1 < num_interp_pts_per_node; ++k1) {
+                for (int k2 = 0; k2 < num_interp_pts_per_node; ++k2) {
+                    double l12 = basis_x[k1] * basis_y[k2];
+                    for (int k3 = 0; k3 < num_interp_pts_per_node; ++k3, ++kk) {
+                        double l123 = l12 * basis_z[k3];
+                        clusters_q_ptr   [kk] += q    * l123;
+                        clusters_q_dx_ptr[kk] += q_dx * l123;
+                        clusters_q_dy_ptr[kk] += q_dy * l123;
+                        clusters_q_dz_ptr[kk] += q_dz * l123;
+                    }
+                }
+                }
+            }
+            continue;
+        }
         
-        int* exact_idx_x_ptr = exact_idx_x.data();
-        int* exact_idx_y_ptr = exact_idx_y.data();
-        int* exact_idx_z_ptr = exact_idx_z.data();
-        double* denominator_ptr = denominator.data();
+#endif
+        int* exact_idx_x_ptr = workspace_.ints();
+        int* exact_idx_y_ptr = exact_idx_x_ptr + num_particles;
+        int* exact_idx_z_ptr = exact_idx_y_ptr + num_particles;
+        double* denominator_ptr = workspace_.doubles();
         
 #ifdef OPENACC_ENABLED
     int stream_id = std::rand() % 3;
@@ -875,6 +1706,13 @@ void BoundaryElement::upward_pass()
     } // end loop over nodes
 #ifdef OPENACC_ENABLED
     #pragma acc exit data delete(weights_ptr[0:weights_num])
+#else
+    interp_pts_.upward_transfer(clusters_q_ptr, workspace_);
+    interp_pts_.upward_transfer(clusters_q_dx_ptr, workspace_);
+    interp_pts_.upward_transfer(clusters_q_dy_ptr, workspace_);
+    interp_pts_.upward_transfer(clusters_q_dz_ptr, workspace_);
+    
+    if (mixed_precision_) BoundaryElement::convert_to_mixed_precision();
 #endif
 
     timers_.upward_pass.stop();
@@ -885,6 +1723,25 @@ void BoundaryElement::downward_pass(double* __restrict potential)
 {
     timers_.downward_pass.start();
 
+#ifndef OPENACC_ENABLED
+    if (mixed_precision_) {
+#ifdef OPENMP_ENABLED
+        #pragma omp parallel for
+#endif
+        for (std::size_t i = 0; i < num_charges_; ++i) {
+            interp_potential_   [i] = interp_potential_f_   [i];
+            interp_potential_dx_[i] = interp_potential_dx_f_[i];
+            interp_potential_dy_[i] = interp_potential_dy_f_[i];
+            interp_potential_dz_[i] = interp_potential_dz_f_[i];
+        }
+    }
+    
+    interp_pts_.downward_transfer(interp_potential_.data(), workspace_);
+    interp_pts_.downward_transfer(interp_potential_dx_.data(), workspace_);
+    interp_pts_.downward_transfer(interp_potential_dy_.data(), workspace_);
+    interp_pts_.downward_transfer(interp_potential_dz_.data(), workspace_);
+#endif
+
     const double* __restrict clusters_x_ptr    = interp_pts_.interp_x_ptr();
     const double* __restrict clusters_y_ptr    = interp_pts_.interp_y_ptr();
     const double* __restrict clusters_z_ptr    = interp_pts_.interp_z_ptr();
@@ -903,14 +1760,10 @@ void BoundaryElement::downward_pass(double* __restrict potential)
     const double* __restrict targets_q_dy_ptr  = elements_.target_charge_dy_ptr();
     const double* __restrict targets_q_dz_ptr  = elements_.target_charge_dz_ptr();
     
-    std::vector<double> weights (interp_pts_.num_interp_pts_per_node());
-    double* weights_ptr = weights.data();
-    int weights_num = weights.size();
-    
-    for (int i = 0; i < weights_num; ++i) {
-        weights[i] = ((i % 2 == 0)? 1 : -1);
-        if (i == 0 || i == weights_num-1) weights[i] = ((i % 2 == 0)? 1 : -1) * 0.5;
-    }
+    const double* weights_ptr = interp_pts_.weights_ptr();
+#ifdef OPENACC_ENABLED
+    int weights_num = interp_pts_.num_interp_pts_per_node();
+#endif
     
     std::size_t potential_offset = elements_.num();
     int num_interp_pts_per_node = interp_pts_.num_interp_pts_per_node();
@@ -919,7 +1772,16 @@ void BoundaryElement::downward_pass(double* __restrict potential)
 #pragma acc enter data copyin(weights_ptr[0:weights_num])
 #endif
     
+#ifdef OPENACC_ENABLED
     for (std::size_t node_idx = 0; node_idx < tree_.num_nodes(); ++node_idx) {
+#else
+    const auto& leaves = tree_.leaves();
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t leaf = 0; leaf < leaves.size(); ++leaf) {
+        std::size_t node_idx = leaves[leaf];
+#endif
         
         auto particle_idxs = tree_.node_particle_idxs(node_idx);
         std::size_t node_interp_pts_start = node_idx * num_interp_pts_per_node;
@@ -928,6 +1790,43 @@ void BoundaryElement::downward_pass(double* __restrict potential)
         std::size_t particle_start = particle_idxs[0];
         std::size_t num_particles  = particle_idxs[1] - particle_idxs[0];
 
+#ifndef OPENACC_ENABLED
+        if (interp_basis_begin_[node_idx] != NOT_CACHED) {
+            const double* basis_ptr = &interp_basis_[interp_basis_begin_[node_idx]];
+            
+            for (std::size_t i = 0; i < num_particles; ++i) {
+                const double* basis_x = basis_ptr + 3 * num_interp_pts_per_node * i;
+                const double* basis_y = basis_x + num_interp_pts_per_node;
+                const double* basis_z = basis_y + num_interp_pts_per_node;
+                
+                double pot_comp_   = 0.;
+                double pot_comp_dx = 0.;
+                double pot_comp_dy = 0.;
+                double pot_comp_dz = 0.;
+                
+                std::size_t kk = node_potentials_start;
+                for (int k1 = 0; k1 < num_interp_pts_per_node; ++k1) {
+                for (int k2 = 0; k2 < num_interp_pts_per_node; ++k2) {
+                    double l12 = basis_x[k1] * basis_y[k2];
+                    for (int k3 = 0; k3 < num_interp_pts_per_node; ++k3, ++kk) {
+                        double l123 = l12 * basis_z[k3];
+                        pot_comp_   += l123 * clusters_p_ptr   [kk];
+                        pot_comp_dx += l123 * clusters_p_dx_ptr[kk];
+                        pot_comp_dy += l123 * clusters_p_dy_ptr[kk];
+                        pot_comp_dz += l123 * clusters_p_dz_ptr[kk];
+                    }
+                }
+                }
+                
+                potential[particle_start + i]                    += targets_q_ptr   [particle_start + i] * pot_comp_;
+                potential[particle_start + i + potential_offset] += targets_q_dx_ptr[particle_start + i] * pot_comp_dx
+                                                                  + targets_q_dy_ptr[particle_start + i] * pot_comp_dy
+                                                                  + targets_q_dz_ptr[particle_start + i] * pot_comp_dz;
+            }
+            continue;
+        }
+
+#endif
 #ifdef OPENACC_ENABLED
         int stream_id = std::rand() % 3;
 #pragma acc parallel loop async(stream_id) present(elements_x_ptr, elements_y_ptr, elements_z_ptr, \
@@ -1052,31 +1951,175 @@ void BoundaryElement::downward_pass(double* __restrict potential)
 }
 
 
+void BoundaryElement::reserve_workspace()
+{
+    // Per-thread scratch shared by the kernels, sized for the largest user:
+    // the PP target sums, the leaf anterpolation temporaries, the block
+    // preconditioner right-hand side plus its LU solve temporary, and the two
+    // node grids of the upward and downward transfers.
+
+    std::size_t max_leaf_size = tree_.max_leaf_size();
+    std::size_t max_pp_target_size = max_leaf_size;
+    
+    for (std::size_t node_idx = 0; node_idx < tree_.num_nodes(); ++node_idx) {
+        if (interaction_list_.particle_particle(node_idx).empty()) continue;
+        auto particle_idxs = tree_.node_particle_idxs(node_idx);
+        max_pp_target_size = std::max(max_pp_target_size, particle_idxs[1] - particle_idxs[0]);
+    }
+
+#ifdef OPENACC_ENABLED
+    std::size_t max_node_particles = tree_.node_particle_idxs(0)[1];
+#else
+    std::size_t max_node_particles = max_leaf_size;
+#endif
+
+    workspace_.reserve(std::max({2 * max_pp_target_size, max_node_particles, 4 * max_leaf_size,
+                                 interp_pts_.transfer_workspace_size()}),
+                       3 * max_node_particles);
+    counters_.reserve();
+}
+
+
+void BoundaryElement::init_block(std::size_t num_vectors)
+{
+    if (num_vectors <= num_block_vectors_) return;
+    num_block_vectors_ = num_vectors;
+    
+    std::size_t num_elements = elements_.num();
+    
+    block_potential_temp_.assign(num_vectors * 2 * num_elements, 0.);
+    
+    block_source_charge_   .assign(num_vectors * num_elements, 0.);
+    block_source_charge_dx_.assign(num_vectors * num_elements, 0.);
+    block_source_charge_dy_.assign(num_vectors * num_elements, 0.);
+    block_source_charge_dz_.assign(num_vectors * num_elements, 0.);
+    
+    block_interp_charge_   .assign(num_vectors * num_charges_, 0.);
+    block_interp_charge_dx_.assign(num_vectors * num_charges_, 0.);
+    block_interp_charge_dy_.assign(num_vectors * num_charges_, 0.);
+    block_interp_charge_dz_.assign(num_vectors * num_charges_, 0.);
+    
+    block_interp_potential_   .assign(num_vectors * num_charges_, 0.);
+    block_interp_potential_dx_.assign(num_vectors * num_charges_, 0.);
+    block_interp_potential_dy_.assign(num_vectors * num_charges_, 0.);
+    block_interp_potential_dz_.assign(num_vectors * num_charges_, 0.);
+    
+    clusters_x_.resize(num_charges_);
+    clusters_y_.resize(num_charges_);
+    clusters_z_.resize(num_charges_);
+    
+    int num_interp_pts_per_node = interp_pts_.num_interp_pts_per_node();
+    const double* clusters_x_ptr = interp_pts_.interp_x_ptr();
+    const double* clusters_y_ptr = interp_pts_.interp_y_ptr();
+    const double* clusters_z_ptr = interp_pts_.interp_z_ptr();
+    
+    for (std::size_t node_idx = 0; node_idx < tree_.num_nodes(); ++node_idx) {
+        std::size_t interp_pts_begin = node_idx * num_interp_pts_per_node;
+        std::size_t kk = node_idx * num_charges_per_node_;
+        
+        for (int k1 = 0; k1 < num_interp_pts_per_node; ++k1) {
+        for (int k2 = 0; k2 < num_interp_pts_per_node; ++k2) {
+        for (int k3 = 0; k3 < num_interp_pts_per_node; ++k3, ++kk) {
+            clusters_x_[kk] = clusters_x_ptr[interp_pts_begin + k1];
+            clusters_y_[kk] = clusters_y_ptr[interp_pts_begin + k2];
+            clusters_z_[kk] = clusters_z_ptr[interp_pts_begin + k3];
+        }
+        }
+        }
+    }
+    
+    // PP and PC temporaries of a target leaf for every vector
+    workspace_.reserve(4 * num_vectors * tree_.max_leaf_size(), 0);
+}
+
+
+void BoundaryElement::build_interp_cache()
+{
+    timers_.build_interp_cache.start();
+    
+    // Element and interpolation point positions are fixed for the life of the
+    // solver, so the barycentric basis rows used by the leaf anterpolation and
+    // interpolation are computed once. Leaves are cached in order until the
+    // memory budget is used up; the remaining leaves are evaluated on the fly.
+
+    interp_basis_.clear();
+    interp_basis_begin_.assign(tree_.num_nodes(), NOT_CACHED);
+
+#ifndef OPENACC_ENABLED
+    int num_interp_pts_per_node = interp_pts_.num_interp_pts_per_node();
+    std::size_t budget = params_.interp_cache_budget_ * 1024. * 1024. / sizeof(double);
+    
+    std::vector<std::size_t> cached_leaves;
+    std::size_t cache_size = 0;
+    for (auto node_idx : tree_.leaves()) {
+        auto particle_idxs = tree_.node_particle_idxs(node_idx);
+        std::size_t node_size = 3 * num_interp_pts_per_node * (particle_idxs[1] - particle_idxs[0]);
+        if (cache_size + node_size > budget) break;
+        
+        interp_basis_begin_[node_idx] = cache_size;
+        cached_leaves.push_back(node_idx);
+        cache_size += node_size;
+    }
+    
+    interp_basis_.resize(cache_size);
+    
+    const double* __restrict clusters_x_ptr = interp_pts_.interp_x_ptr();
+    const double* __restrict clusters_y_ptr = interp_pts_.interp_y_ptr();
+    const double* __restrict clusters_z_ptr = interp_pts_.interp_z_ptr();
+    
+    const double* __restrict elements_x_ptr = elements_.x_ptr();
+    const double* __restrict elements_y_ptr = elements_.y_ptr();
+    const double* __restrict elements_z_ptr = elements_.z_ptr();
+    
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t leaf = 0; leaf < cached_leaves.size(); ++leaf) {
+    
+        std::size_t node_idx = cached_leaves[leaf];
+        auto particle_idxs = tree_.node_particle_idxs(node_idx);
+        std::size_t node_interp_pts_start = node_idx * num_interp_pts_per_node;
+        double* basis_ptr = &interp_basis_[interp_basis_begin_[node_idx]];
+        
+        const double* clusters_ptr[3] = {clusters_x_ptr + node_interp_pts_start,
+                                         clusters_y_ptr + node_interp_pts_start,
+                                         clusters_z_ptr + node_interp_pts_start};
+        
+        for (std::size_t i = particle_idxs[0]; i < particle_idxs[1]; ++i) {
+            double coord[3] = {elements_x_ptr[i], elements_y_ptr[i], elements_z_ptr[i]};
+            
+            for (int dim = 0; dim < 3; ++dim, basis_ptr += num_interp_pts_per_node)
+                InterpolationPoints::lagrange_basis(coord[dim], clusters_ptr[dim], num_interp_pts_per_node, basis_ptr);
+        }
+    }
+#endif
+
+    timers_.build_interp_cache.stop();
+}
+
+
 void BoundaryElement::clear_cluster_charges()
 {
     timers_.clear_cluster_charges.start();
 
-#ifdef OPENACC_ENABLED
     std::size_t num_charges = num_charges_;
     double* __restrict clusters_q_ptr    = interp_charge_.data();
     double* __restrict clusters_q_dx_ptr = interp_charge_dx_.data();
     double* __restrict clusters_q_dy_ptr = interp_charge_dy_.data();
     double* __restrict clusters_q_dz_ptr = interp_charge_dz_.data();
     
+#ifdef OPENACC_ENABLED
     #pragma acc parallel loop present(clusters_q_ptr, clusters_q_dx_ptr, \
                                       clusters_q_dy_ptr, clusters_q_dz_ptr)
+#elif OPENMP_ENABLED
+    #pragma omp parallel for
+#endif
     for (std::size_t i = 0; i < num_charges; ++i) {
         clusters_q_ptr[i] = 0.;
         clusters_q_dx_ptr[i] = 0.;
         clusters_q_dy_ptr[i] = 0.;
         clusters_q_dz_ptr[i] = 0.;
     }
-#else
-    std::fill(interp_charge_.begin(),    interp_charge_.end(),    0);
-    std::fill(interp_charge_dx_.begin(), interp_charge_dx_.end(), 0);
-    std::fill(interp_charge_dy_.begin(), interp_charge_dy_.end(), 0);
-    std::fill(interp_charge_dz_.begin(), interp_charge_dz_.end(), 0);
-#endif
 
     timers_.clear_cluster_charges.stop();
 }
@@ -1086,27 +2129,24 @@ void BoundaryElement::clear_cluster_potentials()
 {
     timers_.clear_cluster_potentials.start();
 
-#ifdef OPENACC_ENABLED
     std::size_t num_potentials = num_charges_;
     double* __restrict clusters_p_ptr    = interp_potential_.data();
     double* __restrict clusters_p_dx_ptr = interp_potential_dx_.data();
     double* __restrict clusters_p_dy_ptr = interp_potential_dy_.data();
     double* __restrict clusters_p_dz_ptr = interp_potential_dz_.data();
     
+#ifdef OPENACC_ENABLED
     #pragma acc parallel loop present(clusters_p_ptr, clusters_p_dx_ptr, \
                                       clusters_p_dy_ptr, clusters_p_dz_ptr)
+#elif OPENMP_ENABLED
+    #pragma omp parallel for
+#endif
     for (std::size_t i = 0; i < num_potentials; ++i) {
         clusters_p_ptr[i] = 0.;
         clusters_p_dx_ptr[i] = 0.;
         clusters_p_dy_ptr[i] = 0.;
         clusters_p_dz_ptr[i] = 0.;
     }
-#else
-    std::fill(interp_potential_.begin(),    interp_potential_.end(),    0);
-    std::fill(interp_potential_dx_.begin(), interp_potential_dx_.end(), 0);
-    std::fill(interp_potential_dy_.begin(), interp_potential_dy_.end(), 0);
-    std::fill(interp_potential_dz_.begin(), interp_potential_dz_.end(), 0);
-#endif
 
     timers_.clear_cluster_potentials.stop();
 }
@@ -1212,30 +2252,63 @@ void BoundaryElement::delete_clusters_from_device() const
 
 void Timers_BoundaryElement::print() const
 {
-    std::cout.setf(std::ios::fixed, std::ios::floatfield);
-    std::cout.precision(5);
-    std::cout << "|...BoundaryElement function times (s)...." << std::endl;
-    std::cout << "|   |...ctor.......................: ";
-    std::cout << std::setw(12) << std::right << ctor                       .elapsed_time() << std::endl;
-    std::cout << "|   |...run_GMRES..................: ";
-    std::cout << std::setw(12) << std::right << run_GMRES                  .elapsed_time() << std::endl;
-    std::cout << "|       |...matrix_vector..........: ";
-    std::cout << std::setw(12) << std::right << matrix_vector              .elapsed_time() << std::endl;
-    std::cout << "|           |...upward pass........: ";
-    std::cout << std::setw(12) << std::right << upward_pass                .elapsed_time() << std::endl;
-    std::cout << "|           |...PP interact........: ";
-    std::cout << std::setw(12) << std::right << particle_particle_interact .elapsed_time() << std::endl;
-    std::cout << "|           |...PC interact........: ";
-    std::cout << std::setw(12) << std::right << particle_cluster_interact  .elapsed_time() << std::endl;
-    std::cout << "|           |...CP interact........: ";
-    std::cout << std::setw(12) << std::right << cluster_particle_interact  .elapsed_time() << std::endl;
-    std::cout << "|           |...CC interact........: ";
-    std::cout << std::setw(12) << std::right << cluster_cluster_interact   .elapsed_time() << std::endl;
-    std::cout << "|           |...downward pass......: ";
-    std::cout << std::setw(12) << std::right << downward_pass              .elapsed_time() << std::endl;
-    std::cout << "|       |...precondition...........: ";
-    std::cout << std::setw(12) << std::right << precondition               .elapsed_time() << std::endl;
-    std::cout << "|" << std::endl;
+    console::out().setf(std::ios::fixed, std::ios::floatfield);
+    console::out().precision(5);
+    console::out() << "|...BoundaryElement function times (s)...." << std::endl;
+    console::out() << "|   |...ctor.......................: ";
+    console::out() << std::setw(12) << std::right << ctor                       .elapsed_time() << std::endl;
+    console::out() << "|   |...run_GMRES..................: ";
+    console::out() << std::setw(12) << std::right << run_GMRES                  .elapsed_time() << std::endl;
+    console::out() << "|       |...matrix_vector..........: ";
+    console::out() << std::setw(12) << std::right << matrix_vector              .elapsed_time() << std::endl;
+    console::out() << "|           |...upward pass........: ";
+    console::out() << std::setw(12) << std::right << upward_pass                .elapsed_time() << std::endl;
+    console::out() << "|           |...PP interact........: ";
+    console::out() << std::setw(12) << std::right << particle_particle_interact .elapsed_time() << std::endl;
+    console::out() << "|           |...PC interact........: ";
+    console::out() << std::setw(12) << std::right << particle_cluster_interact  .elapsed_time() << std::endl;
+    console::out() << "|           |...CP interact........: ";
+    console::out() << std::setw(12) << std::right << cluster_particle_interact  .elapsed_time() << std::endl;
+    console::out() << "|           |...CC interact........: ";
+    console::out() << std::setw(12) << std::right << cluster_cluster_interact   .elapsed_time() << std::endl;
+    console::out() << "|           |...downward pass......: ";
+    console::out() << std::setw(12) << std::right << downward_pass              .elapsed_time() << std::endl;
+    console::out() << "|       |...build_interp_cache.....: ";
+    console::out() << std::setw(12) << std::right << build_interp_cache         .elapsed_time() << std::endl;
+    console::out() << "|       |...precondition...........: ";
+    console::out() << std::setw(12) << std::right << precondition               .elapsed_time() << std::endl;
+    console::out() << "|       |...factor_precondition....: ";
+    console::out() << std::setw(12) << std::right << factor_precondition_blocks .elapsed_time() << std::endl;
+    console::out() << "|       |...fgmres_inner_solve.....: ";
+    console::out() << std::setw(12) << std::right << fgmres_inner_solve         .elapsed_time() << std::endl;
+    console::out() << "|       |...mixed_prec_estimate....: ";
+    console::out() << std::setw(12) << std::right << mixed_precision_estimate   .elapsed_time() << std::endl;
+    console::out() << "|" << std::endl;
+    
+    // interact times are summed over threads, so they may exceed the matvec time
+    static const char* KIND_NAMES[] = {"PP", "PC", "CP", "CC"};
+    console::out() << "|...Interactions of " << matvecs.size() << " matvecs (time summed over threads)...." << std::endl;
+    console::out() << "|   kind    interactions           pairs      Gflop         GB     time (s)" << std::endl;
+    for (int k = 0; k < InteractionCounters::NUM_KINDS; ++k) {
+        console::out() << "|   " << std::setw(4) << std::left << KIND_NAMES[k] << std::right
+                  << std::setw(16) << interactions.interactions[k]
+                  << std::setw(16) << interactions.pairs[k]
+                  << std::setw(11) << std::setprecision(3) << interactions.flops(k) * 1e-9
+                  << std::setw(11) << interactions.bytes[k] * 1e-9
+                  << std::setw(13) << std::setprecision(5) << interactions.seconds[k] << std::endl;
+    }
+    console::out() << "|" << std::endl;
+}
+
+
+Timers_BoundaryElement::Matvec Timers_BoundaryElement::elapsed() const
+{
+    Matvec totals;
+    totals.seconds       = matrix_vector.elapsed_time();
+    totals.upward_pass   = upward_pass  .elapsed_time();
+    totals.downward_pass = downward_pass.elapsed_time();
+    
+    return totals;
 }
 
 
@@ -1251,7 +2324,19 @@ std::string Timers_BoundaryElement::get_durations() const
     durations.append(std::to_string(cluster_particle_interact  .elapsed_time())).append(", ");
     durations.append(std::to_string(cluster_cluster_interact   .elapsed_time())).append(", ");
     durations.append(std::to_string(downward_pass              .elapsed_time())).append(", ");
+    durations.append(std::to_string(build_interp_cache         .elapsed_time())).append(", ");
     durations.append(std::to_string(precondition               .elapsed_time())).append(", ");
+    durations.append(std::to_string(factor_precondition_blocks .elapsed_time())).append(", ");
+    durations.append(std::to_string(fgmres_inner_solve         .elapsed_time())).append(", ");
+    durations.append(std::to_string(mixed_precision_estimate   .elapsed_time())).append(", ");
+    
+    durations.append(std::to_string(matvecs.size())).append(", ");
+    for (int k = 0; k < InteractionCounters::NUM_KINDS; ++k) {
+        durations.append(std::to_string(interactions.interactions[k])).append(", ");
+        durations.append(std::to_string(interactions.pairs[k]))       .append(", ");
+        durations.append(std::to_string(interactions.flops(k)))       .append(", ");
+        durations.append(std::to_string(interactions.bytes[k]))       .append(", ");
+    }
     
     return durations;
 }
@@ -1273,7 +2358,60 @@ std::string Timers_BoundaryElement::get_headers() const
     headers.append("BoundaryElement cluster_particle_interact, ");
     headers.append("BoundaryElement cluster_cluster_interact, ");
     headers.append("BoundaryElement downward_pass, ");
+    headers.append("BoundaryElement build_interp_cache, ");
     headers.append("BoundaryElement precondition, ");
+    headers.append("BoundaryElement factor_precondition_blocks, ");
+    headers.append("BoundaryElement fgmres_inner_solve, ");
+    headers.append("BoundaryElement mixed_precision_estimate, ");
+    
+    headers.append("BoundaryElement num_matvecs, ");
+    for (const char* kind : {"PP", "PC", "CP", "CC"}) {
+        headers.append("BoundaryElement ").append(kind).append(" interactions, ");
+        headers.append("BoundaryElement ").append(kind).append(" pairs, ");
+        headers.append("BoundaryElement ").append(kind).append(" flops, ");
+        headers.append("BoundaryElement ").append(kind).append(" bytes, ");
+    }
     
     return headers;
 }
+
+
+std::string Timers_BoundaryElement::get_json() const
+{
+    static const char* KIND_NAMES[] = {"PP", "PC", "CP", "CC"};
+    
+    auto counts_json = [](const InteractionCounters::Counts& counts) {
+        std::string json;
+        for (int k = 0; k < InteractionCounters::NUM_KINDS; ++k) {
+            json.append(k ? ", " : "").append("\"").append(KIND_NAMES[k]).append("\": {")
+                .append("\"interactions\": ").append(std::to_string(counts.interactions[k]))
+                .append(", \"pairs\": ")     .append(std::to_string(counts.pairs[k]))
+                .append(", \"flops\": ")     .append(std::to_string(counts.flops(k)))
+                .append(", \"bytes\": ")     .append(std::to_string(counts.bytes[k]))
+                .append(", \"seconds\": ")   .append(std::to_string(counts.seconds[k])).append("}");
+        }
+        return json;
+    };
+    
+    auto matvecs_json = [&counts_json](const std::vector<Matvec>& list) {
+        std::string json("[");
+        for (std::size_t i = 0; i < list.size(); ++i) {
+            const Matvec& matvec = list[i];
+            json.append(i ? ",\n" : "\n").append("    {")
+                .append("\"num_vectors\": ")    .append(std::to_string(matvec.num_vectors))
+                .append(", \"seconds\": ")      .append(std::to_string(matvec.seconds))
+                .append(", \"upward_pass\": ")  .append(std::to_string(matvec.upward_pass))
+                .append(", \"downward_pass\": ").append(std::to_string(matvec.downward_pass))
+                .append(", ").append(counts_json(matvec.counts)).append("}");
+        }
+        return json.append(list.empty() ? "]" : "\n  ]");
+    };
+    
+    std::string json;
+    json.append("  \"interactions\": {").append(counts_json(interactions)).append("},\n");
+    json.append("  \"matvecs\": ").append(matvecs_json(matvecs));
+    if (!estimate_matvecs.empty())
+        json.append(",\n  \"mixed_precision_estimate_matvecs\": ").append(matvecs_json(estimate_matvecs));
+    
+    return json;
+}
@@ -1,13 +1,74 @@
 #ifndef H_TABIPB_TREECODE_STRUCT_H
 #define H_TABIPB_TREECODE_STRUCT_H
 
+#include <memory>
+
 #include "timer.h"
 #include "output.h"
 #include "elements.h"
 #include "interp_pts.h"
 #include "interaction_list.h"
+#include "near_field_kernel.h"
+#include "far_field_kernel.h"
+#include "workspace.h"
+#include "interaction_counters.h"
+
+struct Timers_BoundaryElement
+{
+    Timer ctor;
+    Timer run_GMRES;
+    
+    Timer clear_charges;
+    Timer clear_potentials;
+
+    Timer matrix_vector;
+    Timer precondition;
+    Timer factor_precondition_blocks;
+    Timer fgmres_inner_solve;
+    Timer mixed_precision_estimate;
+    
+    Timer particle_particle_interact;
+    Timer particle_cluster_interact;
+    Timer cluster_particle_interact;
+    Timer cluster_cluster_interact;
+    Timer upward_pass;
+    Timer downward_pass;
+    Timer build_interp_cache;
+    
+    Timer clear_cluster_charges;
+    Timer clear_cluster_potentials;
+    Timer copyin_clusters_to_device;
+    Timer delete_clusters_from_device;
+    
+    /* times and interactions of one matvec; GMRES does one per iteration, plus
+     * one for the residual of each restart */
+    struct Matvec {
+        std::size_t num_vectors = 1;
+        double seconds = 0.;
+        double upward_pass = 0.;
+        double downward_pass = 0.;
+        InteractionCounters::Counts counts;
+    };
+    
+    InteractionCounters::Counts interactions;
+    std::vector<Matvec> matvecs;
+    
+    /* the two matvecs estimating the mixed precision deviation after GMRES, kept
+     * out of the totals, interactions and matvecs above */
+    std::vector<Matvec> estimate_matvecs;
+    
+    /* the matvec times so far, to be subtracted from those after the next matvec */
+    Matvec elapsed() const;
+
+    void print() const;
+    std::string get_durations() const;
+    std::string get_headers() const;
+    std::string get_json() const;
+
+    Timers_BoundaryElement() = default;
+    ~Timers_BoundaryElement() = default;
+};
 
-struct Timers_BoundaryElement;
 
 class BoundaryElement
 {
@@ -22,6 +83,19 @@ private:
     struct Timers_BoundaryElement& timers_;
     
     std::vector<double> potential_;
+    std::vector<double> potential_temp_;
+    bool owner_computes_;
+    near_field::Kernel near_field_kernel_;
+    near_field::BlockKernel near_field_block_kernel_;
+    far_field::Kernel far_field_kernel_;
+    bool mixed_precision_;
+    bool estimating_deviation_ = false;
+    class Workspace workspace_;
+    class InteractionCounters counters_;
+    
+    /* low accuracy operator on the same tree, preconditioning FGMRES */
+    struct InnerOperator;
+    std::unique_ptr<struct InnerOperator> inner_;
     
     /* cluster specific data */
     int num_charges_per_node_;
@@ -37,6 +111,66 @@ private:
     std::vector<double> interp_potential_dy_;
     std::vector<double> interp_potential_dz_;
     
+    /* single precision copies for the mixed precision far field; cluster
+     * coordinates are expanded to one entry per interpolation point */
+    std::vector<float> elements_x_f_;
+    std::vector<float> elements_y_f_;
+    std::vector<float> elements_z_f_;
+    
+    std::vector<float> source_charge_f_;
+    std::vector<float> source_charge_dx_f_;
+    std::vector<float> source_charge_dy_f_;
+    std::vector<float> source_charge_dz_f_;
+    
+    std::vector<float> clusters_x_f_;
+    std::vector<float> clusters_y_f_;
+    std::vector<float> clusters_z_f_;
+    
+    std::vector<float> interp_charge_f_;
+    std::vector<float> interp_charge_dx_f_;
+    std::vector<float> interp_charge_dy_f_;
+    std::vector<float> interp_charge_dz_f_;
+    
+    std::vector<float> interp_potential_f_;
+    std::vector<float> interp_potential_dx_f_;
+    std::vector<float> interp_potential_dy_f_;
+    std::vector<float> interp_potential_dz_f_;
+    
+    /* charges and potentials of the block matvec, vector-major: set v of the
+     * element arrays starts at v * num_elements, of the cluster arrays at
+     * v * num_charges_. Cluster coordinates are expanded as in mixed precision. */
+    std::size_t num_block_vectors_ = 0;
+    std::vector<double> block_potential_temp_;
+    
+    std::vector<double> block_source_charge_;
+    std::vector<double> block_source_charge_dx_;
+    std::vector<double> block_source_charge_dy_;
+    std::vector<double> block_source_charge_dz_;
+    
+    std::vector<double> block_interp_charge_;
+    std::vector<double> block_interp_charge_dx_;
+    std::vector<double> block_interp_charge_dy_;
+    std::vector<double> block_interp_charge_dz_;
+    
+    std::vector<double> block_interp_potential_;
+    std::vector<double> block_interp_potential_dx_;
+    std::vector<double> block_interp_potential_dy_;
+    std::vector<double> block_interp_potential_dz_;
+    
+    std::vector<double> clusters_x_;
+    std::vector<double> clusters_y_;
+    std::vector<double> clusters_z_;
+    
+    /* 1D Lagrange basis rows of the elements of cached leaves */
+    std::vector<double> interp_basis_;
+    std::vector<std::size_t> interp_basis_begin_;
+    
+    /* block preconditioner, leaf blocks are LU factored once per solver */
+    std::vector<double> precondition_blocks_;
+    std::vector<int> precondition_pivots_;
+    std::vector<std::size_t> precondition_blocks_begin_;
+    std::vector<std::size_t> precondition_pivots_begin_;
+    
     /* output */
     double solvation_energy_;
     double free_energy_;
@@ -50,12 +184,33 @@ private:
     int gmres_(long int n, const double* b, double* x, long int restrt,
                double* work, long int ldw, double *h, long int ldh,
                long int& iter, double& residual);
+    int fgmres_(long int n, const double* b, double* x, long int restrt,
+                double* work, long int ldw, double *h, long int ldh,
+                long int& iter, double& residual);
+    void inner_solve_(long int n, const double* v, double* z);
+    int block_gmres_(long int n, long int num_systems, const double* b, double* x, long int restrt,
+                     double* work, long int ldw, double *h, long int ldh,
+                     long int& iter, double& residual);
     
     void matrix_vector(double alpha, const double* __restrict potential_old,
                        double beta,        double* __restrict potential_new);
+    
+    /* merges the interaction counters into the timers after a matvec, or into
+     * the estimate matvecs alone while estimating_deviation_ */
+    void record_matvec(std::size_t num_vectors, const struct Timers_BoundaryElement::Matvec& start);
+                       
+    void matrix_vector_block(std::size_t num_vectors,
+                       double alpha, const double* __restrict potential_old,
+                       double beta,        double* __restrict potential_new);
+                       
+    void interact_target_nodes(double* __restrict potential_new, const double* __restrict potential_old);
+    void interact_target_leaves(double* __restrict potential_new, const double* __restrict potential_old);
+    void interact_target_leaves_block(std::size_t num_vectors,
+                       double* __restrict potential_new, const double* __restrict potential_old);
                        
     void precondition_diagonal(double* z, double* r);
     void precondition_block(double* z, double* r);
+    void factor_precondition_blocks();
     
     void particle_particle_interact(double* __restrict potential,
                               const double* __restrict potential_old,
@@ -71,8 +226,31 @@ private:
     void cluster_cluster_interact(double* __restrict potential,
             std::size_t target_node_idx, std::size_t source_node_idx);
             
+    void particle_cluster_interact_mixed(double* __restrict potential,
+            std::array<std::size_t, 2> target_node_particle_idxs, std::size_t source_node_idx);
+    void cluster_particle_interact_mixed(std::size_t target_node_idx,
+            std::array<std::size_t, 2> source_node_particle_idxs);
+    void cluster_cluster_interact_mixed(std::size_t target_node_idx, std::size_t source_node_idx);
+            
+    void particle_particle_interact_block(std::size_t num_vectors, double* __restrict potential,
+                              const double* __restrict potential_old,
+            std::array<std::size_t, 2> target_node_particle_idxs,
+            std::array<std::size_t, 2> source_node_particle_idxs);
+    void particle_cluster_interact_block(std::size_t num_vectors, double* __restrict potential,
+            std::array<std::size_t, 2> target_node_particle_idxs, std::size_t source_node_idx);
+    void cluster_particle_interact_block(std::size_t num_vectors, std::size_t target_node_idx,
+            std::array<std::size_t, 2> source_node_particle_idxs);
+    void cluster_cluster_interact_block(std::size_t num_vectors,
+            std::size_t target_node_idx, std::size_t source_node_idx);
+            
     void upward_pass();
     void downward_pass(double* __restrict potential);
+    void build_interp_cache();
+    void init_operator();
+    void init_mixed_precision();
+    void convert_to_mixed_precision();
+    void reserve_workspace();
+    void init_block(std::size_t num_vectors);
     
     void clear_cluster_charges();
     void clear_cluster_potentials();
@@ -84,49 +262,54 @@ private:
                                            num_charges_per_node_ * (node_idx + 1)};
     };
 
+    /* the FGMRES inner operator, sharing everything but the interpolation and lists */
+    BoundaryElement(const BoundaryElement& outer, const class InterpolationPoints& interp_pts,
+             const class InteractionList& interaction_list, struct Timers_BoundaryElement& timers);
     
 public:
     BoundaryElement(class Elements& elements, const class InterpolationPoints& interp_pts,
              const class Tree& tree, const class InteractionList& interaction_list,
              const class Molecule& molecule, const struct Params& params, class Output& output,
              struct Timers_BoundaryElement& timers);
-    ~BoundaryElement() = default;
+    ~BoundaryElement();
     
     void run_GMRES();
+    
+    /* solves for every right-hand side in source_terms, each of the length of
+     * the potential, in blocks of charge_set_block_size sharing each matvec */
+    void run_block_GMRES(const std::vector<double>& source_terms, std::vector<double>& potentials);
+    
+    /* one matvec on a potential in tree order, for tuning the treecode */
+    void apply(const double* potential_old, double* potential_new);
+    
+    /* rows targets of the matvec summed directly over every element: the
+     * potentials first, then their normal derivatives */
+    void apply_direct(const double* potential_old, const std::vector<std::size_t>& targets,
+                      std::vector<double>& potential_new);
     //void finalize();
 
 };
 
 
-struct Timers_BoundaryElement
+/* interpolation points, lists and workspace of the FGMRES inner operator */
+struct BoundaryElement::InnerOperator
 {
-    Timer ctor;
-    Timer run_GMRES;
+    struct Timers_InteractionList interaction_list_timers;
+    struct Timers_BoundaryElement timers;
     
-    Timer clear_charges;
-    Timer clear_potentials;
-
-    Timer matrix_vector;
-    Timer precondition;
+    class InterpolationPoints interp_pts;
+    class InteractionList interaction_list;
+    std::unique_ptr<class BoundaryElement> boundary_element;
     
-    Timer particle_particle_interact;
-    Timer particle_cluster_interact;
-    Timer cluster_particle_interact;
-    Timer cluster_cluster_interact;
-    Timer upward_pass;
-    Timer downward_pass;
+    long int num_iter;
+    long int total_iter = 0;
+    std::vector<double> work;
+    std::vector<double> h;
+    std::vector<double> s;
+    std::vector<double> y;
     
-    Timer clear_cluster_charges;
-    Timer clear_cluster_potentials;
-    Timer copyin_clusters_to_device;
-    Timer delete_clusters_from_device;
-
-    void print() const;
-    std::string get_durations() const;
-    std::string get_headers() const;
-
-    Timers_BoundaryElement() = default;
-    ~Timers_BoundaryElement() = default;
+    InnerOperator(const BoundaryElement& outer, int degree, double theta, long int num_iter);
+    ~InnerOperator();
 };
 
 #endif /* H_TABIPB_TREECODE_STRUCT_H */
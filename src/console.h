@@ -0,0 +1,40 @@
+#ifndef H_TABIPB_CONSOLE_H
+#define H_TABIPB_CONSOLE_H
+
+#include <iostream>
+#include <ostream>
+
+/* The stream the solver reports on: std::cout, unless the calling thread has
+ * redirected it. Batch jobs running side by side each redirect to a stream of
+ * their own, so they neither share the format state of std::cout nor mix
+ * their output. OpenMP workers of a job report on std::cout. */
+namespace console {
+
+    inline std::ostream*& thread_stream() {
+        static thread_local std::ostream* stream = nullptr;
+        return stream;
+    }
+
+    inline std::ostream& out() {
+        std::ostream* stream = thread_stream();
+        return stream ? *stream : std::cout;
+    }
+
+    /* reports of the calling thread go to stream while this is in scope */
+    class Redirect
+    {
+    private:
+        std::ostream* previous_;
+
+    public:
+        explicit Redirect(std::ostream& stream) : previous_(thread_stream()) {
+            thread_stream() = &stream;
+        }
+        ~Redirect() { thread_stream() = previous_; }
+
+        Redirect(const Redirect&) = delete;
+        Redirect& operator=(const Redirect&) = delete;
+    };
+}
+
+#endif /* H_TABIPB_CONSOLE_H */
@@ -1,6 +1,8 @@
+#include "console.h"
 #include "params.h"
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
 #include <cstdio>
@@ -9,28 +11,50 @@
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
 #include <numeric>
 #include <sstream>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+#ifdef _WIN32
+    #include <process.h>
+#else
+    #include <unistd.h>
+#endif
+
 #ifdef PLY_ENABLED
 #include <tinyply.h>
 #endif // PLY_ENABLED
 
 #include "constants.h"
 #include "elements.h"
+#include "mapped_file.h"
 #include "source_term_compute.h"
+#include "surface_mesh.h"
 
 static double triangle_area(std::array<std::array<double, 3>, 3> v);
 
+static std::mutex nanoshaper_mutex;
+
 Elements::Elements(const class Molecule &mol, const struct Params &params,
                    struct Timers_Elements &timers)
     : Particles(params), molecule_(mol), timers_(timers) {
   timers_.ctor.start();
 
-  Elements::generate_elements(params_.mesh_, params_.mesh_format_,
-                              params_.mesh_density_, params_.mesh_probe_radius_,
-                              params_.input_mesh_prefix_);
+  // meshes read from input files are not cached
+  bool use_cache =
+      !params_.mesh_cache_dir_.empty() && params_.input_mesh_prefix_.empty();
+  uint64_t cache_key = use_cache ? mesh_cache_key() : 0;
+
+  if (!use_cache || !read_mesh_cache(cache_key)) {
+    Elements::generate_elements(params_.mesh_, params_.mesh_format_,
+                                params_.mesh_density_, params_.mesh_probe_radius_,
+                                params_.input_mesh_prefix_);
+    if (use_cache)
+      write_mesh_cache(cache_key);
+  }
 
   source_charge_.assign(num_, 0.);
   source_charge_dx_.assign(num_, 0.);
@@ -79,24 +103,24 @@ bool Elements::read_ply_file(const std::string &filepath) {
     tinyply::PlyFile file;
     file.parse_header(*file_stream);
 
-    std::cout << "\t[ply_header] Type: "
+    console::out() << "\t[ply_header] Type: "
               << (file.is_binary_file() ? "binary" : "ascii") << std::endl;
     for (const auto &c : file.get_comments())
-      std::cout << "\t[ply_header] Comment: " << c << std::endl;
+      console::out() << "\t[ply_header] Comment: " << c << std::endl;
     for (const auto &c : file.get_info())
-      std::cout << "\t[ply_header] Info: " << c << std::endl;
+      console::out() << "\t[ply_header] Info: " << c << std::endl;
 
     for (const auto &e : file.get_elements()) {
-      std::cout << "\t[ply_header] element: " << e.name << " (" << e.size << ")"
+      console::out() << "\t[ply_header] element: " << e.name << " (" << e.size << ")"
                 << std::endl;
       for (const auto &p : e.properties) {
-        std::cout << "\t[ply_header] \tproperty: " << p.name
+        console::out() << "\t[ply_header] \tproperty: " << p.name
                   << " (type=" << tinyply::PropertyTable[p.propertyType].str
                   << ")";
         if (p.isList)
-          std::cout << " (list_type=" << tinyply::PropertyTable[p.listType].str
+          console::out() << " (list_type=" << tinyply::PropertyTable[p.listType].str
                     << ")";
-        std::cout << std::endl;
+        console::out() << std::endl;
       }
     }
 
@@ -134,13 +158,13 @@ bool Elements::read_ply_file(const std::string &filepath) {
     file.read(*file_stream);
 
     if (vertices)
-      std::cout << "\tRead " << vertices->count << " total vertices "
+      console::out() << "\tRead " << vertices->count << " total vertices "
                 << std::endl;
     if (normals)
-      std::cout << "\tRead " << normals->count << " total vertex normals "
+      console::out() << "\tRead " << normals->count << " total vertex normals "
                 << std::endl;
     if (faces)
-      std::cout << "\tRead " << faces->count << " total faces (triangles) "
+      console::out() << "\tRead " << faces->count << " total faces (triangles) "
                 << std::endl;
 
     if (vertices) {
@@ -195,82 +219,86 @@ bool Elements::read_ply_file(const std::string &filepath) {
   return false;
 }
 
+// MSMS files open with comment lines and a line whose first number is the
+// record count; returns the position after that line
+static const char *msms_body(const MappedFile &file, const std::string &name,
+                             std::size_t &count) {
+  const char *p = file.begin();
+  while (p < file.end() && *text_parse::skip_blanks(p, file.end()) == '#')
+    p = text_parse::line_end(p, file.end()) + 1;
+
+  uint64_t value;
+  const char *line_end = text_parse::line_end(std::min(p, file.end()), file.end());
+  if (p >= file.end() || !text_parse::parse_uint(p, line_end, value))
+    throw std::runtime_error(name + " has no record count");
+
+  count = value;
+  return std::min(line_end + 1, file.end());
+}
+
 bool Elements::read_msms_file(const std::string &input_mesh_prefix) {
-  std::string line;
+  namespace tp = text_parse;
 
   // Read in the vert file
-  std::cout << "Reading " << input_mesh_prefix << ".vert" << std::endl;
-  std::ifstream vert_file(input_mesh_prefix + ".vert");
-  // Throw away first two lines
-  std::getline(vert_file, line);
-  std::getline(vert_file, line);
-
-  std::getline(vert_file, line);
-  try {
-    num_ = std::stoul(line);
-    std::cout << "Reading " << num_ <<" vertices" << std::endl;
-
-    x_.reserve(num_);
-    y_.reserve(num_);
-    z_.reserve(num_);
-    nx_.reserve(num_);
-    ny_.reserve(num_);
-    nz_.reserve(num_);
-
-    while (std::getline(vert_file, line)) {
-
-      std::istringstream iss(line);
-      std::vector<std::string> tokenized_line{
-          std::istream_iterator<std::string>{iss},
-          std::istream_iterator<std::string>{}};
-
-      x_.push_back(std::stod(tokenized_line[0]));
-      y_.push_back(std::stod(tokenized_line[1]));
-      z_.push_back(std::stod(tokenized_line[2]));
-      nx_.push_back(std::stod(tokenized_line[3]));
-      ny_.push_back(std::stod(tokenized_line[4]));
-      nz_.push_back(std::stod(tokenized_line[5]));
-  }
-  } catch (std::invalid_argument const& ex) {
-     std::cout << "Vert: line: |" << line << "| caused invalid argument exception" << std::endl;
-     throw;
-  }
-
-  vert_file.close();
+  std::string vert_name = input_mesh_prefix + ".vert";
+  console::out() << "Reading " << vert_name << std::endl;
+  MappedFile vert_file(vert_name);
+
+  const char *vert_body = msms_body(vert_file, vert_name, num_);
+  console::out() << "Reading " << num_ << " vertices" << std::endl;
+
+  x_.resize(num_);
+  y_.resize(num_);
+  z_.resize(num_);
+  nx_.resize(num_);
+  ny_.resize(num_);
+  nz_.resize(num_);
+
+  std::size_t num_lines;
+  bool parsed = tp::parse_lines(vert_body, vert_file.end(),
+      [&](const char *p, const char *end, std::size_t i) {
+        return i < num_ && (p = tp::parse_double(p, end, x_[i]))
+                        && (p = tp::parse_double(p, end, y_[i]))
+                        && (p = tp::parse_double(p, end, z_[i]))
+                        && (p = tp::parse_double(p, end, nx_[i]))
+                        && (p = tp::parse_double(p, end, ny_[i]))
+                        && (p = tp::parse_double(p, end, nz_[i]));
+      }, num_lines);
+
+  if (!parsed || num_lines != num_)
+    throw std::runtime_error(vert_name + ": vertex " + std::to_string(num_lines + 1) +
+                             (parsed ? " missing" : " is not six numbers"));
 
   // Read in the face file
-  std::cout << "Reading " << input_mesh_prefix << ".face" << std::endl;
-  std::ifstream face_file(input_mesh_prefix + ".face");
-  // Throw away first two lines
-  std::getline(face_file, line);
-  std::getline(face_file, line);
-
-  std::getline(face_file, line);
-  try{
-    num_faces_ = std::stoul(line);
-    std::cout << "Reading " << num_faces_ <<" faces" << std::endl;
-
-    face_x_.reserve(num_faces_);
-    face_y_.reserve(num_faces_);
-    face_z_.reserve(num_faces_);
-
-    while (std::getline(face_file, line)) {
-
-      std::istringstream iss(line);
-      std::vector<std::string> tokenized_line{
-          std::istream_iterator<std::string>{iss},
-          std::istream_iterator<std::string>{}};
-
-      face_x_.push_back(std::stoul(tokenized_line[0]));
-      face_y_.push_back(std::stoul(tokenized_line[1]));
-      face_z_.push_back(std::stoul(tokenized_line[2]));
-  }
-  } catch (std::invalid_argument const& ex) {
-     std::cout << "Face: line: |" << line << "| caused invalid argument exception" << std::endl;
-     throw;
-  }
-
-  face_file.close();
+  std::string face_name = input_mesh_prefix + ".face";
+  console::out() << "Reading " << face_name << std::endl;
+  MappedFile face_file(face_name);
+
+  const char *face_body = msms_body(face_file, face_name, num_faces_);
+  console::out() << "Reading " << num_faces_ << " faces" << std::endl;
+
+  face_x_.resize(num_faces_);
+  face_y_.resize(num_faces_);
+  face_z_.resize(num_faces_);
+
+  parsed = tp::parse_lines(face_body, face_file.end(),
+      [&](const char *p, const char *end, std::size_t i) {
+        uint64_t v[3];
+        if (i >= num_faces_ || !(p = tp::parse_uint(p, end, v[0]))
+                            || !(p = tp::parse_uint(p, end, v[1]))
+                            || !(p = tp::parse_uint(p, end, v[2])))
+          return false;
+        for (uint64_t vertex : v)
+          if (vertex < 1 || vertex > num_) return false;
+        face_x_[i] = v[0];
+        face_y_[i] = v[1];
+        face_z_[i] = v[2];
+        return true;
+      }, num_lines);
+
+  if (!parsed || num_lines != num_faces_)
+    throw std::runtime_error(face_name + ": face " + std::to_string(num_lines + 1) +
+                             (parsed ? " missing" : " is not three vertex numbers"));
 
   return true;
 }
@@ -323,10 +351,21 @@ void Elements::generate_elements(Params::Mesh mesh,
                                  Params::MeshFormat mesh_format,
                                  double mesh_density, double probe_radius,
                                  const std::string &input_mesh_prefix) {
+  // NanoShaper reads and writes fixed file names in the working directory,
+  // so concurrent jobs of a batch take turns until its mesh has been read
+  std::unique_lock<std::mutex> nanoshaper_lock(nanoshaper_mutex, std::defer_lock);
+
+  bool mesh_in_process =
+      Params::Mesh::GAUSSIAN == mesh && input_mesh_prefix.empty();
+
   std::string input_mesh_file_name = "";
-  if (input_mesh_prefix.empty()) {
+  if (mesh_in_process) {
+    generate_gaussian_surface(mesh_density);
+  } else if (input_mesh_prefix.empty()) {
+    nanoshaper_lock.lock();
     // Gotta write the files and run NanoShaper
     input_mesh_file_name = "triangulatedSurf";
+    molecule_.build_xyzr_file();
     write_nanaoshaper_config(mesh, mesh_format, mesh_density, probe_radius);
 #ifdef _WIN32
     std::system("NanoShaper.exe");
@@ -343,13 +382,15 @@ void Elements::generate_elements(Params::Mesh mesh,
     input_mesh_file_name = input_mesh_prefix;
   }
 
-  if (Params::MeshFormat::PLY == mesh_format) {
+  if (mesh_in_process) {
+    // vertices and faces are already in place
+  } else if (Params::MeshFormat::PLY == mesh_format) {
     read_ply_file(input_mesh_file_name + ".ply");
   } else {
     read_msms_file(input_mesh_file_name);
   }
 
-  if (input_mesh_prefix.empty()) {
+  if (!mesh_in_process && input_mesh_prefix.empty()) {
     if (Params::MeshFormat::PLY == mesh_format) {
       std::remove("triangulatedSurf.ply");
     } else {
@@ -357,17 +398,26 @@ void Elements::generate_elements(Params::Mesh mesh,
       std::remove("triangulatedSurf.face");
     }
     std::remove("molecule.xyzr");
+    nanoshaper_lock.unlock();
   }
 
   area_.assign(num_, 0.);
 
+  // faces count vertices from 1 except in PLY files
   int face_vertex_index_shift = 1;
-  if (Params::MeshFormat::PLY == mesh_format) {
+  if (Params::MeshFormat::PLY == mesh_format && !mesh_in_process) {
     face_vertex_index_shift = 0;
   } else {
     face_vertex_index_shift = 1;
   }
 
+  // Face areas are computed in parallel, then added to their vertices in face
+  // order, which keeps the sums independent of the number of threads
+  std::vector<double> face_area(num_faces_);
+
+#ifdef OPENMP_ENABLED
+#pragma omp parallel for
+#endif
   for (std::size_t i = 0; i < num_faces_; ++i) {
     std::array<uint32_t, 3> iface{face_x_[i], face_y_[i], face_z_[i]};
     std::array<std::array<double, 3>, 3> r;
@@ -378,20 +428,201 @@ void Elements::generate_elements(Params::Mesh mesh,
       r[2][ii] = z_[iface[ii] - face_vertex_index_shift];
     }
 
-    for (int j = 0; j < 3; ++j) {
-      area_[iface[j] - face_vertex_index_shift] += triangle_area(r);
-    }
+    face_area[i] = triangle_area(r);
+  }
+
+  for (std::size_t i = 0; i < num_faces_; ++i) {
+    area_[face_x_[i] - face_vertex_index_shift] += face_area[i];
+    area_[face_y_[i] - face_vertex_index_shift] += face_area[i];
+    area_[face_z_[i] - face_vertex_index_shift] += face_area[i];
   }
 
   std::transform(area_.begin(), area_.end(), area_.begin(),
                  [=](double x) { return x / 3.; });
   surface_area_ = std::accumulate(area_.begin(), area_.end(),
                                   decltype(area_)::value_type(0));
-  std::cout << "Surface area of triangulated mesh is " << surface_area_ << ". "
+  console::out() << "Surface area of triangulated mesh is " << surface_area_ << ". "
             << std::endl
             << std::endl;
 }
 
+namespace {
+
+  // binary mesh cache layout: the header, then x, y, z, nx, ny, nz and area as
+  // doubles and face_x, face_y and face_z as uint32_t, each array contiguous;
+  // the checksum is the hash of everything after the header
+  struct MeshCacheHeader {
+    char magic[8];
+    uint64_t key;
+    uint64_t num_vertices;
+    uint64_t num_faces;
+    uint64_t checksum;
+  };
+
+  const char MESH_CACHE_MAGIC[8] = {'T', 'A', 'B', 'I', 'M', 'S', 'H', '2'};
+
+  // 64-bit FNV-1a
+  uint64_t hash_bytes(const void *data, std::size_t size, uint64_t hash) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  // distinguishes the temporary files of the jobs of one process
+  std::atomic<unsigned long> mesh_cache_temp_count(0);
+}
+
+uint64_t Elements::mesh_cache_key() const {
+  // the key covers everything the mesh depends on: the atoms (the contents of
+  // the xyzr file) and the surface settings
+  uint64_t key = 14695981039346656037ULL;
+  key = hash_bytes(MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC), key);
+  key = hash_bytes(molecule_.x_ptr(), molecule_.num() * sizeof(double), key);
+  key = hash_bytes(molecule_.y_ptr(), molecule_.num() * sizeof(double), key);
+  key = hash_bytes(molecule_.z_ptr(), molecule_.num() * sizeof(double), key);
+  key = hash_bytes(molecule_.radius_ptr(), molecule_.num() * sizeof(double), key);
+
+  int mesh = static_cast<int>(params_.mesh_);
+  int mesh_format = static_cast<int>(params_.mesh_format_);
+  key = hash_bytes(&mesh, sizeof(mesh), key);
+  key = hash_bytes(&mesh_format, sizeof(mesh_format), key);
+  key = hash_bytes(&params_.mesh_density_, sizeof(double), key);
+  key = hash_bytes(&params_.mesh_probe_radius_, sizeof(double), key);
+  if (Params::Mesh::GAUSSIAN == params_.mesh_)
+    key = hash_bytes(&params_.mesh_gaussian_decay_, sizeof(double), key);
+
+  return key;
+}
+
+std::string Elements::mesh_cache_file_name(uint64_t key) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.mesh",
+                static_cast<unsigned long long>(key));
+
+  return params_.mesh_cache_dir_ + "/" + name;
+}
+
+bool Elements::read_mesh_cache(uint64_t key) {
+  std::string file_name = mesh_cache_file_name(key);
+  if (!std::ifstream(file_name).good())
+    return false;
+
+  // a cache file that does not fit its key is ignored and rewritten
+  MappedFile file(file_name);
+  MeshCacheHeader header;
+  if (file.size() < sizeof(header))
+    return false;
+  std::memcpy(&header, file.begin(), sizeof(header));
+
+  std::size_t expected_size =
+      sizeof(header) + header.num_vertices * 7 * sizeof(double) +
+      header.num_faces * 3 * sizeof(uint32_t);
+
+  if (std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.key != key ||
+      file.size() != expected_size ||
+      hash_bytes(file.begin() + sizeof(header), file.size() - sizeof(header),
+                 14695981039346656037ULL) != header.checksum)
+    return false;
+
+  num_ = header.num_vertices;
+  num_faces_ = header.num_faces;
+
+  const char *p = file.begin() + sizeof(header);
+  for (std::vector<double> *array : {&x_, &y_, &z_, &nx_, &ny_, &nz_, &area_}) {
+    array->resize(num_);
+    std::memcpy(array->data(), p, num_ * sizeof(double));
+    p += num_ * sizeof(double);
+  }
+  for (std::vector<uint32_t> *array : {&face_x_, &face_y_, &face_z_}) {
+    array->resize(num_faces_);
+    std::memcpy(array->data(), p, num_faces_ * sizeof(uint32_t));
+    p += num_faces_ * sizeof(uint32_t);
+  }
+
+  surface_area_ = std::accumulate(area_.begin(), area_.end(), 0.);
+  console::out() << "Read " << num_ << " vertices and " << num_faces_
+            << " faces from mesh cache " << file_name << std::endl;
+  console::out() << "Surface area of triangulated mesh is " << surface_area_ << ". "
+            << std::endl
+            << std::endl;
+
+  return true;
+}
+
+void Elements::write_mesh_cache(uint64_t key) const {
+  std::string file_name = mesh_cache_file_name(key);
+
+  MeshCacheHeader header;
+  std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+  header.key = key;
+  header.num_vertices = num_;
+  header.num_faces = num_faces_;
+
+  header.checksum = 14695981039346656037ULL;
+  for (const std::vector<double> *array : {&x_, &y_, &z_, &nx_, &ny_, &nz_, &area_})
+    header.checksum = hash_bytes(array->data(), num_ * sizeof(double), header.checksum);
+  for (const std::vector<uint32_t> *array : {&face_x_, &face_y_, &face_z_})
+    header.checksum = hash_bytes(array->data(), num_faces_ * sizeof(uint32_t), header.checksum);
+
+  // written under a temporary name unique to this process and job and then
+  // renamed, so that concurrent jobs never read or write a partial file
+  std::string temp_name = file_name + "." + std::to_string(getpid()) + "." +
+      std::to_string(mesh_cache_temp_count++) + ".tmp";
+  std::ofstream cache_file(temp_name, std::ofstream::binary);
+  if (!cache_file.good()) {
+    console::out() << "Cannot write mesh cache " << file_name << std::endl;
+    return;
+  }
+
+  cache_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  for (const std::vector<double> *array : {&x_, &y_, &z_, &nx_, &ny_, &nz_, &area_})
+    cache_file.write(reinterpret_cast<const char *>(array->data()),
+                     num_ * sizeof(double));
+  for (const std::vector<uint32_t> *array : {&face_x_, &face_y_, &face_z_})
+    cache_file.write(reinterpret_cast<const char *>(array->data()),
+                     num_faces_ * sizeof(uint32_t));
+  cache_file.close();
+
+  if (cache_file.fail() || std::rename(temp_name.c_str(), file_name.c_str()) != 0) {
+    std::remove(temp_name.c_str());
+    console::out() << "Cannot write mesh cache " << file_name << std::endl;
+    return;
+  }
+
+  console::out() << "Wrote mesh cache " << file_name << std::endl;
+}
+
+void Elements::generate_gaussian_surface(double mesh_density) {
+  console::out() << "Meshing the Gaussian surface of " << molecule_.num()
+            << " atoms" << std::endl;
+
+  surface_mesh::Mesh mesh;
+  surface_mesh::gaussian_surface(molecule_.x_ptr(), molecule_.y_ptr(),
+                                 molecule_.z_ptr(), molecule_.radius_ptr(),
+                                 molecule_.num(), mesh_density,
+                                 params_.mesh_gaussian_decay_, mesh);
+
+  x_.swap(mesh.x);
+  y_.swap(mesh.y);
+  z_.swap(mesh.z);
+  nx_.swap(mesh.nx);
+  ny_.swap(mesh.ny);
+  nz_.swap(mesh.nz);
+
+  face_x_.swap(mesh.face_x);
+  face_y_.swap(mesh.face_y);
+  face_z_.swap(mesh.face_z);
+
+  num_ = x_.size();
+  num_faces_ = face_x_.size();
+  console::out() << "Generated " << num_ << " vertices and " << num_faces_
+            << " faces" << std::endl;
+}
+
 void Elements::compute_source_term() {
   /* this computes the source term where
    * S1=sum(qk*G0)/e1 S2=sim(qk*G0')/e1 */
@@ -524,6 +755,10 @@ void Elements::unorder(std::vector<double> &potential) {
   apply_unorder(order_.begin(), order_.end(), source_term_.begin());
   apply_unorder(order_.begin(), order_.end(), source_term_.begin() + num_);
 
+  Elements::unorder_potential(potential);
+}
+
+void Elements::unorder_potential(std::vector<double> &potential) const {
   apply_unorder(order_.begin(), order_.end(), potential.begin());
   apply_unorder(order_.begin(), order_.end(), potential.begin() + num_);
 }
@@ -631,6 +866,17 @@ void Elements::copyin_to_device() const {
   timers_.copyin_to_device.stop();
 }
 
+void Elements::clear_source_term() {
+  std::fill(source_term_.begin(), source_term_.end(), 0.);
+
+#ifdef OPENACC_ENABLED
+  const double *source_term_ptr = source_term_.data();
+  std::size_t source_term_num = source_term_.size();
+
+#pragma acc update device(source_term_ptr[0 : source_term_num])
+#endif
+}
+
 void Elements::update_source_term_on_host() const {
 #ifdef OPENACC_ENABLED
   const double *source_term_ptr = source_term_.data();
@@ -717,26 +963,26 @@ static double triangle_area(std::array<std::array<double, 3>, 3> v) {
 }
 
 void Timers_Elements::print() const {
-  std::cout.setf(std::ios::fixed, std::ios::floatfield);
-  std::cout.precision(5);
-  std::cout << "|...Elements function times (s)...." << std::endl;
-  std::cout << "|   |...ctor.......................: ";
-  std::cout << std::setw(12) << std::right << ctor.elapsed_time() << std::endl;
-  std::cout << "|   |...compute_source_term........: ";
-  std::cout << std::setw(12) << std::right << compute_source_term.elapsed_time()
+  console::out().setf(std::ios::fixed, std::ios::floatfield);
+  console::out().precision(5);
+  console::out() << "|...Elements function times (s)...." << std::endl;
+  console::out() << "|   |...ctor.......................: ";
+  console::out() << std::setw(12) << std::right << ctor.elapsed_time() << std::endl;
+  console::out() << "|   |...compute_source_term........: ";
+  console::out() << std::setw(12) << std::right << compute_source_term.elapsed_time()
             << std::endl;
-  std::cout << "|   |...compute_charges............: ";
-  std::cout << std::setw(12) << std::right << compute_charges.elapsed_time()
+  console::out() << "|   |...compute_charges............: ";
+  console::out() << std::setw(12) << std::right << compute_charges.elapsed_time()
             << std::endl;
 #ifdef OPENACC_ENABLED
-  std::cout << "|   |...copyin_to_device...........: ";
-  std::cout << std::setw(12) << std::right << copyin_to_device.elapsed_time()
+  console::out() << "|   |...copyin_to_device...........: ";
+  console::out() << std::setw(12) << std::right << copyin_to_device.elapsed_time()
             << std::endl;
-  std::cout << "|   |...delete_from_device.........: ";
-  std::cout << std::setw(12) << std::right << copyin_to_device.elapsed_time()
+  console::out() << "|   |...delete_from_device.........: ";
+  console::out() << std::setw(12) << std::right << copyin_to_device.elapsed_time()
             << std::endl;
 #endif
-  std::cout << "|" << std::endl;
+  console::out() << "|" << std::endl;
 }
 
 std::string Timers_Elements::get_durations() const {
@@ -45,6 +45,11 @@ private:
                                 double);
   void generate_elements(Params::Mesh, Params::MeshFormat, double, double,
                          const std::string &);
+  void generate_gaussian_surface(double mesh_density);
+  uint64_t mesh_cache_key() const;
+  std::string mesh_cache_file_name(uint64_t key) const;
+  bool read_mesh_cache(uint64_t key);
+  void write_mesh_cache(uint64_t key) const;
   bool read_msms_file(const std::string &);
   bool read_ply_file(const std::string &filepath);
   bool file_exists(const std::string &name);
@@ -95,6 +100,9 @@ public:
   void unorder() override;
   void unorder(std::vector<double> &potential);
 
+  /* puts a potential in tree order back into the order of the input mesh */
+  void unorder_potential(std::vector<double> &potential) const;
+
   void compute_source_term();
   void compute_source_term(const class InterpolationPoints &elem_interp_pts,
                            const class Tree &elem_tree,
@@ -103,6 +111,9 @@ public:
                            const class Tree &mol_tree,
                            const class InteractionList &interaction_list);
 
+  /* zeroes the source term before it is computed for another charge set */
+  void clear_source_term();
+
   void compute_charges(const double *potential);
 
   void copyin_to_device() const override;
@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <cmath>
+
+#include "far_field_kernel.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) \
+    && !defined(OPENACC_ENABLED)
+    #define FAR_FIELD_X86_DISPATCH
+    #include <immintrin.h>
+    #define FAR_FIELD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+
+namespace far_field {
+
+/* exp(x) for x <= 0 in single precision: Cody-Waite reduction by ln2 and a
+ * degree 7 Taylor polynomial on |r| <= ln2/2, accurate to about 1 ulp. */
+constexpr float EXP_LOWER_BOUND = -87.f;
+constexpr float LOG2E  = 1.44269504088896341f;
+constexpr float LN2_HI = 0.693359375f;
+constexpr float LN2_LO = -2.12194440e-4f;
+constexpr float EXP_COEFF[8] = {
+    1.f,        1.f,         1.f / 2.f,    1.f / 6.f,
+    1.f / 24.f, 1.f / 120.f, 1.f / 720.f,  1.f / 5040.f};
+
+/* charge sets accumulated per pass of interact_block */
+constexpr std::size_t BLOCK_VECTORS = 16;
+
+
+void interact_scalar(const Cloud& targets, std::size_t target_begin, std::size_t target_end,
+                     const Cloud& sources, std::size_t source_begin, std::size_t source_end,
+                     float eps, float kappa,
+                     float* __restrict pot,    float* __restrict pot_dx,
+                     float* __restrict pot_dy, float* __restrict pot_dz)
+{
+    for (std::size_t j = target_begin; j < target_end; ++j) {
+
+        float target_x = targets.x[j];
+        float target_y = targets.y[j];
+        float target_z = targets.z[j];
+
+        float pot_comp_   = 0.f;
+        float pot_comp_dx = 0.f;
+        float pot_comp_dy = 0.f;
+        float pot_comp_dz = 0.f;
+
+        for (std::size_t k = source_begin; k < source_end; ++k) {
+
+            float dx = target_x - sources.x[k];
+            float dy = target_y - sources.y[k];
+            float dz = target_z - sources.z[k];
+
+            float r2    = dx*dx + dy*dy + dz*dz;
+            float r     = std::sqrt(r2);
+            float rinv  = 1.f / r;
+            float r3inv = rinv  * rinv * rinv;
+            float r5inv = r3inv * rinv * rinv;
+
+            float expkr   =  std::exp(-kappa * r);
+            float d1term  =  r3inv * expkr * (1.f + (kappa * r));
+            float d1term1 = -r3inv + d1term * eps;
+            float d1term2 = -r3inv + d1term / eps;
+            float d2term  =  r5inv * (-3.f + expkr * (3.f + (3.f * kappa * r)
+                                                   + (kappa * kappa * r2)));
+            float d3term  =  r3inv * ( 1.f - expkr * (1.f + kappa * r));
+
+            float q    = sources.q   [k];
+            float q_dx = sources.q_dx[k];
+            float q_dy = sources.q_dy[k];
+            float q_dz = sources.q_dz[k];
+
+            pot_comp_    += (rinv * (1.f - expkr) * q
+                                      + d1term1 * (q_dx * dx + q_dy * dy + q_dz * dz));
+
+            pot_comp_dx  += (q * (d1term2 * dx)
+                          - (q_dx * (dx * dx * d2term + d3term)
+                          +  q_dy * (dx * dy * d2term)
+                          +  q_dz * (dx * dz * d2term)));
+
+            pot_comp_dy  += (q * d1term2 * dy
+                          - (q_dx * (dx * dy * d2term)
+                          +  q_dy * (dy * dy * d2term + d3term)
+                          +  q_dz * (dy * dz * d2term)));
+
+            pot_comp_dz  += (q * d1term2 * dz
+                          - (q_dx * (dx * dz * d2term)
+                          +  q_dy * (dy * dz * d2term)
+                          +  q_dz * (dz * dz * d2term + d3term)));
+        }
+
+        pot   [j - target_begin] += pot_comp_;
+        pot_dx[j - target_begin] += pot_comp_dx;
+        pot_dy[j - target_begin] += pot_comp_dy;
+        pot_dz[j - target_begin] += pot_comp_dz;
+    }
+}
+
+
+void interact_block(const BlockCloud& targets, std::size_t target_begin, std::size_t target_end,
+                    const BlockCloud& sources, std::size_t source_begin, std::size_t source_end,
+                    std::size_t num_vectors, double eps, double kappa,
+                    double* __restrict pot,    double* __restrict pot_dx,
+                    double* __restrict pot_dy, double* __restrict pot_dz, std::size_t pot_stride)
+{
+    std::size_t stride = sources.stride;
+
+    for (std::size_t v_begin = 0; v_begin < num_vectors; v_begin += BLOCK_VECTORS) {
+        std::size_t v_count = std::min(BLOCK_VECTORS, num_vectors - v_begin);
+
+        const double* __restrict q    = sources.q    + v_begin * stride;
+        const double* __restrict q_dx = sources.q_dx + v_begin * stride;
+        const double* __restrict q_dy = sources.q_dy + v_begin * stride;
+        const double* __restrict q_dz = sources.q_dz + v_begin * stride;
+
+    for (std::size_t j = target_begin; j < target_end; ++j) {
+
+        double target_x = targets.x[j];
+        double target_y = targets.y[j];
+        double target_z = targets.z[j];
+
+        double pot_comp_  [BLOCK_VECTORS] = {};
+        double pot_comp_dx[BLOCK_VECTORS] = {};
+        double pot_comp_dy[BLOCK_VECTORS] = {};
+        double pot_comp_dz[BLOCK_VECTORS] = {};
+
+        for (std::size_t k = source_begin; k < source_end; ++k) {
+
+            double dx = target_x - sources.x[k];
+            double dy = target_y - sources.y[k];
+            double dz = target_z - sources.z[k];
+
+            double r2    = dx*dx + dy*dy + dz*dz;
+            double r     = std::sqrt(r2);
+            double rinv  = 1. / r;
+            double r3inv = rinv  * rinv * rinv;
+            double r5inv = r3inv * rinv * rinv;
+
+            double expkr   =  std::exp(-kappa * r);
+            double d1term  =  r3inv * expkr * (1. + (kappa * r));
+            double d1term1 = -r3inv + d1term * eps;
+            double d1term2 = -r3inv + d1term / eps;
+            double d2term  =  r5inv * (-3. + expkr * (3. + (3. * kappa * r)
+                                                   + (kappa * kappa * r2)));
+            double d3term  =  r3inv * ( 1. - expkr * (1. + kappa * r));
+            double g0      =  rinv  * ( 1. - expkr);
+
+            /* the same expansion as interact_scalar, regrouped so that each
+             * charge set costs a handful of multiply-adds */
+            double xx = dx * dx * d2term + d3term, xy = dx * dy * d2term, xz = dx * dz * d2term;
+            double yy = dy * dy * d2term + d3term, yz = dy * dz * d2term;
+            double zz = dz * dz * d2term + d3term;
+            double ex = d1term1 * dx, ey = d1term1 * dy, ez = d1term1 * dz;
+            double fx = d1term2 * dx, fy = d1term2 * dy, fz = d1term2 * dz;
+
+            for (std::size_t v = 0; v < v_count; ++v) {
+                double s    = q   [v * stride + k];
+                double s_dx = q_dx[v * stride + k];
+                double s_dy = q_dy[v * stride + k];
+                double s_dz = q_dz[v * stride + k];
+
+                pot_comp_  [v] += g0 * s + ex * s_dx + ey * s_dy + ez * s_dz;
+                pot_comp_dx[v] += fx * s - (xx * s_dx + xy * s_dy + xz * s_dz);
+                pot_comp_dy[v] += fy * s - (xy * s_dx + yy * s_dy + yz * s_dz);
+                pot_comp_dz[v] += fz * s - (xz * s_dx + yz * s_dy + zz * s_dz);
+            }
+        }
+
+        for (std::size_t v = 0; v < v_count; ++v) {
+            std::size_t jj = (v_begin + v) * pot_stride + j - target_begin;
+            pot   [jj] += pot_comp_  [v];
+            pot_dx[jj] += pot_comp_dx[v];
+            pot_dy[jj] += pot_comp_dy[v];
+            pot_dz[jj] += pot_comp_dz[v];
+        }
+    }
+    }
+}
+
+
+#ifdef FAR_FIELD_X86_DISPATCH
+
+FAR_FIELD_TARGET_AVX2
+static inline __m256 exp_avx2(__m256 x)
+{
+    x = _mm256_max_ps(x, _mm256_set1_ps(EXP_LOWER_BOUND));
+
+    __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(LOG2E)),
+                               _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_HI), x);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_LO), r);
+
+    __m256 p = _mm256_set1_ps(EXP_COEFF[7]);
+    for (int i = 6; i >= 0; --i)
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_COEFF[i]));
+
+    __m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(scale));
+}
+
+
+FAR_FIELD_TARGET_AVX2
+static inline float hsum_avx2(__m256 v)
+{
+    __m128 lo = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    return _mm_cvtss_f32(_mm_add_ss(lo, _mm_movehdup_ps(lo)));
+}
+
+
+FAR_FIELD_TARGET_AVX2
+static void interact_avx2(const Cloud& targets, std::size_t target_begin, std::size_t target_end,
+                          const Cloud& sources, std::size_t source_begin, std::size_t source_end,
+                          float eps, float kappa,
+                          float* __restrict pot,    float* __restrict pot_dx,
+                          float* __restrict pot_dy, float* __restrict pot_dz)
+{
+    const __m256 one      = _mm256_set1_ps(1.f);
+    const __m256 three    = _mm256_set1_ps(3.f);
+    const __m256 v_eps    = _mm256_set1_ps(eps);
+    const __m256 v_kappa  = _mm256_set1_ps(kappa);
+    const __m256 v_kappa2 = _mm256_set1_ps(kappa * kappa);
+    const __m256 inv_eps  = _mm256_set1_ps(1.f / eps);
+
+    for (std::size_t j = target_begin; j < target_end; ++j) {
+
+        const __m256 target_x = _mm256_set1_ps(targets.x[j]);
+        const __m256 target_y = _mm256_set1_ps(targets.y[j]);
+        const __m256 target_z = _mm256_set1_ps(targets.z[j]);
+
+        __m256 acc    = _mm256_setzero_ps();
+        __m256 acc_dx = _mm256_setzero_ps();
+        __m256 acc_dy = _mm256_setzero_ps();
+        __m256 acc_dz = _mm256_setzero_ps();
+
+        for (std::size_t k = source_begin; k < source_end; k += 8) {
+
+            /* lanes past source_end load zeros and are masked out of the sums */
+            std::size_t remaining = source_end - k;
+            __m256i lanes = _mm256_cmpgt_epi32(_mm256_set1_epi32(remaining > 8 ? 8 : (int)remaining),
+                                               _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+            __m256 mask = _mm256_castsi256_ps(lanes);
+
+            __m256 dx = _mm256_sub_ps(target_x, _mm256_maskload_ps(sources.x + k, lanes));
+            __m256 dy = _mm256_sub_ps(target_y, _mm256_maskload_ps(sources.y + k, lanes));
+            __m256 dz = _mm256_sub_ps(target_z, _mm256_maskload_ps(sources.z + k, lanes));
+
+            __m256 q    = _mm256_maskload_ps(sources.q    + k, lanes);
+            __m256 q_dx = _mm256_maskload_ps(sources.q_dx + k, lanes);
+            __m256 q_dy = _mm256_maskload_ps(sources.q_dy + k, lanes);
+            __m256 q_dz = _mm256_maskload_ps(sources.q_dz + k, lanes);
+
+            __m256 r2 = _mm256_mul_ps(dx, dx);
+            r2 = _mm256_fmadd_ps(dy, dy, r2);
+            r2 = _mm256_fmadd_ps(dz, dz, r2);
+
+            __m256 r     = _mm256_sqrt_ps(r2);
+            __m256 rinv  = _mm256_div_ps(one, r);
+            __m256 rinv2 = _mm256_mul_ps(rinv, rinv);
+            __m256 r3inv = _mm256_mul_ps(rinv2, rinv);
+            __m256 r5inv = _mm256_mul_ps(r3inv, rinv2);
+
+            __m256 kappa_r       = _mm256_mul_ps(v_kappa, r);
+            __m256 expkr         = exp_avx2(_mm256_sub_ps(_mm256_setzero_ps(), kappa_r));
+            __m256 one_p_kappa_r = _mm256_add_ps(one, kappa_r);
+
+            __m256 d1term  = _mm256_mul_ps(_mm256_mul_ps(r3inv, expkr), one_p_kappa_r);
+            __m256 d1term1 = _mm256_fmsub_ps(d1term, v_eps, r3inv);
+            __m256 d1term2 = _mm256_fmsub_ps(d1term, inv_eps, r3inv);
+
+            __m256 d2inner = _mm256_fmadd_ps(v_kappa2, r2, _mm256_fmadd_ps(three, kappa_r, three));
+            __m256 d2term  = _mm256_mul_ps(r5inv, _mm256_fmsub_ps(expkr, d2inner, three));
+            __m256 d3term  = _mm256_mul_ps(r3inv, _mm256_fnmadd_ps(expkr, one_p_kappa_r, one));
+
+            __m256 q_dot_d = _mm256_mul_ps(q_dx, dx);
+            q_dot_d = _mm256_fmadd_ps(q_dy, dy, q_dot_d);
+            q_dot_d = _mm256_fmadd_ps(q_dz, dz, q_dot_d);
+
+            /* the gradient terms share q_dot_d * d2term and q * d1term2 */
+            __m256 qd2 = _mm256_mul_ps(q_dot_d, d2term);
+            __m256 qd1 = _mm256_mul_ps(q, d1term2);
+
+            __m256 p    = _mm256_fmadd_ps(d1term1, q_dot_d,
+                              _mm256_mul_ps(_mm256_mul_ps(rinv, _mm256_sub_ps(one, expkr)), q));
+            __m256 p_dx = _mm256_fnmadd_ps(q_dx, d3term, _mm256_fnmadd_ps(dx, qd2, _mm256_mul_ps(qd1, dx)));
+            __m256 p_dy = _mm256_fnmadd_ps(q_dy, d3term, _mm256_fnmadd_ps(dy, qd2, _mm256_mul_ps(qd1, dy)));
+            __m256 p_dz = _mm256_fnmadd_ps(q_dz, d3term, _mm256_fnmadd_ps(dz, qd2, _mm256_mul_ps(qd1, dz)));
+
+            acc    = _mm256_add_ps(acc,    _mm256_and_ps(p,    mask));
+            acc_dx = _mm256_add_ps(acc_dx, _mm256_and_ps(p_dx, mask));
+            acc_dy = _mm256_add_ps(acc_dy, _mm256_and_ps(p_dy, mask));
+            acc_dz = _mm256_add_ps(acc_dz, _mm256_and_ps(p_dz, mask));
+        }
+
+        pot   [j - target_begin] += hsum_avx2(acc);
+        pot_dx[j - target_begin] += hsum_avx2(acc_dx);
+        pot_dy[j - target_begin] += hsum_avx2(acc_dy);
+        pot_dz[j - target_begin] += hsum_avx2(acc_dz);
+    }
+}
+
+#endif /* FAR_FIELD_X86_DISPATCH */
+
+
+Kernel select_kernel(near_field::Isa isa)
+{
+#ifdef FAR_FIELD_X86_DISPATCH
+    if (isa == near_field::Isa::AVX512 || isa == near_field::Isa::AVX2) return interact_avx2;
+#endif
+    return interact_scalar;
+}
+
+}
@@ -0,0 +1,65 @@
+#ifndef H_TABIPB_FAR_FIELD_KERNEL_H
+#define H_TABIPB_FAR_FIELD_KERNEL_H
+
+#include <cstddef>
+
+#include "near_field_kernel.h"
+
+namespace far_field {
+
+    /* single precision points with the charges of the far-field expansion;
+     * target clouds only need x, y and z */
+    struct Cloud {
+        const float* __restrict x;
+        const float* __restrict y;
+        const float* __restrict z;
+
+        const float* __restrict q;
+        const float* __restrict q_dx;
+        const float* __restrict q_dy;
+        const float* __restrict q_dz;
+    };
+
+    /* Accumulates the potential and its gradient at targets [target_begin, target_end)
+     * due to sources [source_begin, source_end) into pot, pot_dx, pot_dy and pot_dz,
+     * which are indexed relative to target_begin. Sources and targets must be well
+     * separated, as they are for PC, CP and CC interactions. */
+    using Kernel = void (*)(const Cloud& targets, std::size_t target_begin, std::size_t target_end,
+                            const Cloud& sources, std::size_t source_begin, std::size_t source_end,
+                            float eps, float kappa,
+                            float* __restrict pot,    float* __restrict pot_dx,
+                            float* __restrict pot_dy, float* __restrict pot_dz);
+
+    Kernel select_kernel(near_field::Isa isa);
+
+    /* double precision points with num_vectors sets of charges; set v of q, q_dx,
+     * q_dy and q_dz starts at v * stride */
+    struct BlockCloud {
+        const double* __restrict x;
+        const double* __restrict y;
+        const double* __restrict z;
+
+        const double* __restrict q;
+        const double* __restrict q_dx;
+        const double* __restrict q_dy;
+        const double* __restrict q_dz;
+        std::size_t stride;
+    };
+
+    /* As Kernel in double precision, for num_vectors charge sets at once; the
+     * potentials of set v start at v * pot_stride. The geometry of each pair is
+     * evaluated once and applied to every set. */
+    void interact_block(const BlockCloud& targets, std::size_t target_begin, std::size_t target_end,
+                        const BlockCloud& sources, std::size_t source_begin, std::size_t source_end,
+                        std::size_t num_vectors, double eps, double kappa,
+                        double* __restrict pot,    double* __restrict pot_dx,
+                        double* __restrict pot_dy, double* __restrict pot_dz, std::size_t pot_stride);
+
+    void interact_scalar(const Cloud& targets, std::size_t target_begin, std::size_t target_end,
+                         const Cloud& sources, std::size_t source_begin, std::size_t source_end,
+                         float eps, float kappa,
+                         float* __restrict pot,    float* __restrict pot_dx,
+                         float* __restrict pot_dy, float* __restrict pot_dz);
+}
+
+#endif /* H_TABIPB_FAR_FIELD_KERNEL_H */
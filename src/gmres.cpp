@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <cmath>
+#include <vector>
 
+#include "console.h"
 #include "boundary_element.h"
 
 /*  -- Iterative template routine --
@@ -130,6 +133,8 @@ int BoundaryElement::gmres_(long int n, const double *b, double *x, long int res
     if (bnrm2 == 0.) bnrm2 = 1.;
     
     if (dnrm2_(n, work) / bnrm2 < tol) {
+        resid = dnrm2_(n, work) / bnrm2;
+        iter = 0;
         return 0;
     }
 
@@ -188,7 +193,7 @@ int BoundaryElement::gmres_(long int n, const double *b, double *x, long int res
                   h[i + (restrt) * ldh], h[i + (restrt + 1) * ldh]);
                             
             resid = std::fabs(work[i + 1 + ldw]) / bnrm2;
-            std::cout << "GMRES iteration " << std::setw(3) << iter
+            console::out() << "GMRES iteration " << std::setw(3) << iter
                       << ": error = " << std::scientific << resid << std::endl;
 
             if (resid <= tol) {
@@ -226,6 +231,347 @@ int BoundaryElement::gmres_(long int n, const double *b, double *x, long int res
 }
 
 
+/*  FGMRES (Saad, "A flexible inner-outer preconditioned GMRES algorithm",
+*   SIAM J. Sci. Comput. 14, 1993) on the same preconditioned system and with
+*   the same arguments and convergence test as GMRES above. The preconditioner
+*   may change every iteration: each Krylov vector V(I) is mapped to
+*   Z(I) = INNER_SOLVE(V(I)), and the solution is updated with Z instead of V.
+*
+*   WORK    (workspace) DOUBLE PRECISION array, dimension (LDW,2*RESTRT+5).
+*           Columns 3 to RESTRT+3 hold V, columns RESTRT+4 onward hold Z.
+*/
+
+//*****************************************************************
+int BoundaryElement::fgmres_(long int n, const double *b, double *x, long int restrt,
+                      double* work, long int ldw, double* h, long int ldh,
+                      long int& iter, double& resid)
+{
+    long int maxit = iter;
+    double tol = resid;
+    
+    double* v = &work[3 * ldw];
+    double* z = &work[(4 + restrt) * ldw];
+
+    for (long int idx = 0; idx < n; ++idx) work[2 * ldw + idx] = b[idx];
+
+    if (dnrm2_(n, x) != 0.) {
+        for (long int idx = 0; idx < n; ++idx) work[2 * ldw + idx] = b[idx];
+        BoundaryElement::matrix_vector(-1., x, 1., &work[2 * ldw]);
+    }
+
+    if (params_.precondition_) BoundaryElement::precondition_block   (work, &work[2 * ldw]);
+    else                       BoundaryElement::precondition_diagonal(work, &work[2 * ldw]);
+
+    double bnrm2 = dnrm2_(n, b);
+    if (bnrm2 == 0.) bnrm2 = 1.;
+    
+    if (dnrm2_(n, work) / bnrm2 < tol) {
+        resid = dnrm2_(n, work) / bnrm2;
+        iter = 0;
+        return 0;
+    }
+
+    iter = 0;
+
+    while (true) {
+
+        for (long int idx = 0; idx < n; ++idx) v[idx] = work[idx];
+        
+        double rnorm = dnrm2_(n, v);
+        dscal_(n, 1. / rnorm, v);
+
+        work[ldw] = rnorm;
+        for (long int k = 1; k < n; ++k) work[k + ldw] = 0.;
+
+        for (long int i = 0; i < restrt; ++i) {
+            ++iter;
+
+            BoundaryElement::inner_solve_(n, &v[i * ldw], &z[i * ldw]);
+
+            BoundaryElement::matrix_vector(1., &z[i * ldw], 0., &work[2 * ldw]);
+            if (params_.precondition_) BoundaryElement::precondition_block   (&work[2 * ldw], &work[2 * ldw]);
+            else                       BoundaryElement::precondition_diagonal(&work[2 * ldw], &work[2 * ldw]);
+
+            basis_(i+1, n, &h[i * ldh], v, ldw, &work[2 * ldw]);
+
+            for (long int k = 0; k < i; ++k) {
+                drot_(h[k + i * ldh],      h[k + 1 + i * ldh],
+                      h[k + restrt * ldh], h[k + (restrt + 1) * ldh]);
+            }
+                                  
+            drotg_(h[i * (ldh + 1)],      h[i * (ldh + 1) + 1],
+                   h[i + (restrt) * ldh], h[i + (restrt + 1) * ldh]);
+                             
+            drot_ (h[i * (ldh + 1)],      h[i * (ldh + 1) + 1],
+                   h[i + (restrt) * ldh], h[i + (restrt + 1) * ldh]);
+                            
+            drot_(work[i + ldw], work[i + ldw + 1],
+                  h[i + (restrt) * ldh], h[i + (restrt + 1) * ldh]);
+                            
+            resid = std::fabs(work[i + 1 + ldw]) / bnrm2;
+            console::out() << "FGMRES iteration " << std::setw(3) << iter
+                      << ": error = " << std::scientific << resid << std::endl;
+
+            if (resid <= tol) {
+
+                update_(i+1, n, x, h, ldh, &work[2 * ldw], &work[ldw], z, ldw);
+
+                return 0;
+            }
+        }
+
+        update_(restrt, n, x, h, ldh, &work[2 * ldw], &work[ldw], z, ldw);
+
+        for (long int idx = 0; idx < n; ++idx) work[2 * ldw + idx] = b[idx];
+        
+        BoundaryElement::matrix_vector(-1., x, 1., &work[2 * ldw]);
+        if (params_.precondition_) BoundaryElement::precondition_block   (work, &work[2 * ldw]);
+        else                       BoundaryElement::precondition_diagonal(work, &work[2 * ldw]);
+
+        work[restrt + ldw] = dnrm2_(n, work);
+        resid = work[restrt + ldw] / bnrm2;
+
+        if (resid <= tol) {
+            return 0;
+        }
+        
+        if (iter == maxit) {
+            return 1;
+        }
+    } /* Restart. */
+}
+
+
+/*  Block GMRES for NUM_SYSTEMS systems with the same matrix and different
+*   right hand sides, B(:,S) and X(:,S) for system S at S*N. Each system runs
+*   the preconditioned GMRES above with its own basis and convergence test,
+*   in lockstep so that one block matvec serves the systems still iterating;
+*   converged systems drop out of the block.
+*
+*   WORK    (workspace) DOUBLE PRECISION array, dimension
+*           (LDW,NUM_SYSTEMS*(RESTRT+4)+2*NUM_SYSTEMS). System S uses columns
+*           S*(RESTRT+4) onward as GMRES does, the last 2*NUM_SYSTEMS columns
+*           hold the block matvec operands.
+*
+*   H       (workspace) DOUBLE PRECISION array, dimension (LDH,NUM_SYSTEMS*(RESTRT+2)).
+*
+*   ITER and RESID return the largest over the systems.
+*/
+
+//*****************************************************************
+int BoundaryElement::block_gmres_(long int n, long int num_systems, const double *b, double *x,
+                           long int restrt, double* work, long int ldw, double* h, long int ldh,
+                           long int& iter, double& resid)
+{
+    long int maxit = iter;
+    double tol = resid;
+
+    long int sys_ldw = ldw * (restrt + 4);
+    long int sys_ldh = ldh * (restrt + 2);
+    double* block_in  = &work[num_systems * sys_ldw];
+    double* block_out = &block_in[num_systems * ldw];
+
+    std::vector<double> bnrm2(num_systems);
+    std::vector<double> sys_resid(num_systems, 0.);
+    std::vector<long int> active;
+
+    bool nonzero_guess = false;
+    for (long int s = 0; s < num_systems; ++s) {
+        if (dnrm2_(n, &x[s * n]) != 0.) nonzero_guess = true;
+        for (long int idx = 0; idx < n; ++idx) block_out[s * ldw + idx] = b[s * n + idx];
+    }
+    
+    if (nonzero_guess) BoundaryElement::matrix_vector_block(num_systems, -1., x, 1., block_out);
+
+    for (long int s = 0; s < num_systems; ++s) {
+        double* w = &work[s * sys_ldw];
+        if (params_.precondition_) BoundaryElement::precondition_block   (w, &block_out[s * ldw]);
+        else                       BoundaryElement::precondition_diagonal(w, &block_out[s * ldw]);
+        
+        bnrm2[s] = dnrm2_(n, &b[s * n]);
+        if (bnrm2[s] == 0.) bnrm2[s] = 1.;
+        
+        sys_resid[s] = dnrm2_(n, w) / bnrm2[s];
+        if (sys_resid[s] >= tol) active.push_back(s);
+    }
+
+    iter = 0;
+
+    while (!active.empty()) {
+
+        for (long int s : active) {
+            double* w = &work[s * sys_ldw];
+            for (long int idx = 0; idx < n; ++idx) w[3 * ldw + idx] = w[idx];
+            
+            double rnorm = dnrm2_(n, &w[3 * ldw]);
+            dscal_(n, 1. / rnorm, &w[3 * ldw]);
+            
+            w[ldw] = rnorm;
+            for (long int k = 1; k < n; ++k) w[k + ldw] = 0.;
+        }
+
+        for (long int i = 0; i < restrt && !active.empty(); ++i) {
+            ++iter;
+            
+            long int num_active = active.size();
+            for (long int a = 0; a < num_active; ++a) {
+                const double* v = &work[active[a] * sys_ldw + (3 + i) * ldw];
+                for (long int idx = 0; idx < n; ++idx) block_in[a * ldw + idx] = v[idx];
+            }
+
+            BoundaryElement::matrix_vector_block(num_active, 1., block_in, 0., block_out);
+            
+            double max_resid = 0.;
+            std::vector<long int> still_active;
+
+            for (long int a = 0; a < num_active; ++a) {
+                long int s = active[a];
+                double* w  = &work[s * sys_ldw];
+                double* hs = &h[s * sys_ldh];
+                
+                if (params_.precondition_) BoundaryElement::precondition_block   (&w[2 * ldw], &block_out[a * ldw]);
+                else                       BoundaryElement::precondition_diagonal(&w[2 * ldw], &block_out[a * ldw]);
+
+                basis_(i+1, n, &hs[i * ldh], &w[3 * ldw], ldw, &w[2 * ldw]);
+
+                for (long int k = 0; k < i; ++k) {
+                    drot_(hs[k + i * ldh],      hs[k + 1 + i * ldh],
+                          hs[k + restrt * ldh], hs[k + (restrt + 1) * ldh]);
+                }
+                                  
+                drotg_(hs[i * (ldh + 1)],      hs[i * (ldh + 1) + 1],
+                       hs[i + (restrt) * ldh], hs[i + (restrt + 1) * ldh]);
+                             
+                drot_ (hs[i * (ldh + 1)],      hs[i * (ldh + 1) + 1],
+                       hs[i + (restrt) * ldh], hs[i + (restrt + 1) * ldh]);
+                            
+                drot_(w[i + ldw], w[i + ldw + 1],
+                      hs[i + (restrt) * ldh], hs[i + (restrt + 1) * ldh]);
+                            
+                sys_resid[s] = std::fabs(w[i + 1 + ldw]) / bnrm2[s];
+                max_resid = std::max(max_resid, sys_resid[s]);
+
+                if (sys_resid[s] <= tol)
+                    update_(i+1, n, &x[s * n], hs, ldh, &w[2 * ldw], &w[ldw], &w[3 * ldw], ldw);
+                else
+                    still_active.push_back(s);
+            }
+            
+            console::out() << "GMRES iteration " << std::setw(3) << iter
+                      << ": error = " << std::scientific << max_resid
+                      << ", " << num_active << " systems" << std::endl;
+            
+            active.swap(still_active);
+        }
+        
+        if (active.empty()) break;
+
+    /*        Compute the solutions and residuals of the systems left. */
+
+        long int num_active = active.size();
+        for (long int a = 0; a < num_active; ++a) {
+            long int s = active[a];
+            double* w  = &work[s * sys_ldw];
+            
+            update_(restrt, n, &x[s * n], &h[s * sys_ldh], ldh, &w[2 * ldw], &w[ldw], &w[3 * ldw], ldw);
+            
+            for (long int idx = 0; idx < n; ++idx) {
+                block_in [a * ldw + idx] = x[s * n + idx];
+                block_out[a * ldw + idx] = b[s * n + idx];
+            }
+        }
+        
+        BoundaryElement::matrix_vector_block(num_active, -1., block_in, 1., block_out);
+        
+        std::vector<long int> still_active;
+        for (long int a = 0; a < num_active; ++a) {
+            long int s = active[a];
+            double* w  = &work[s * sys_ldw];
+            
+            if (params_.precondition_) BoundaryElement::precondition_block   (w, &block_out[a * ldw]);
+            else                       BoundaryElement::precondition_diagonal(w, &block_out[a * ldw]);
+
+            w[restrt + ldw] = dnrm2_(n, w);
+            sys_resid[s] = w[restrt + ldw] / bnrm2[s];
+            if (sys_resid[s] > tol) still_active.push_back(s);
+        }
+        active.swap(still_active);
+        
+        if (!active.empty() && iter >= maxit) {
+            resid = *std::max_element(sys_resid.begin(), sys_resid.end());
+            return 1;
+        }
+    } /* Restart. */
+    
+    resid = *std::max_element(sys_resid.begin(), sys_resid.end());
+    return 0;
+}
+
+
+/*     =============================================================== */
+void BoundaryElement::inner_solve_(long int n, const double* v, double* z)
+{
+/*     Approximately solves the preconditioned system with the inner */
+/*     operator: a single cycle of GMRES from a zero initial guess, which */
+/*     stops early once the inner residual falls below its tolerance. */
+
+    timers_.fgmres_inner_solve.start();
+
+    auto& inner = *inner_;
+    long int m   = inner.num_iter;
+    long int ldh = m + 1;
+    double* work = inner.work.data();
+    double* h    = inner.h.data();
+    double* s    = inner.s.data();
+    double* w    = work;
+    double* vv   = &work[n];
+
+    double vnorm = dnrm2_(n, v);
+    for (long int idx = 0; idx < n; ++idx) z[idx] = 0.;
+    if (vnorm == 0.) {
+        timers_.fgmres_inner_solve.stop();
+        return;
+    }
+
+    for (long int idx = 0; idx < n; ++idx) vv[idx] = v[idx] / vnorm;
+    
+    s[0] = vnorm;
+    for (long int k = 1; k <= m; ++k) s[k] = 0.;
+
+    long int num_cols = m;
+    for (long int i = 0; i < m; ++i) {
+        ++inner.total_iter;
+
+        inner.boundary_element->matrix_vector(1., &vv[i * n], 0., w);
+        if (params_.precondition_) BoundaryElement::precondition_block   (w, w);
+        else                       BoundaryElement::precondition_diagonal(w, w);
+
+        basis_(i+1, n, &h[i * ldh], vv, n, w);
+
+        for (long int k = 0; k < i; ++k) {
+            drot_(h[k + i * ldh], h[k + 1 + i * ldh],
+                  h[k + m * ldh], h[k + (m + 1) * ldh]);
+        }
+
+        drotg_(h[i * (ldh + 1)], h[i * (ldh + 1) + 1],
+               h[i + m * ldh],   h[i + (m + 1) * ldh]);
+
+        drot_ (h[i * (ldh + 1)], h[i * (ldh + 1) + 1],
+               h[i + m * ldh],   h[i + (m + 1) * ldh]);
+
+        drot_(s[i], s[i + 1], h[i + m * ldh], h[i + (m + 1) * ldh]);
+
+        if (std::fabs(s[i + 1]) / vnorm <= params_.fgmres_inner_residual_) {
+            num_cols = i + 1;
+            break;
+        }
+    }
+
+    update_(num_cols, n, z, h, ldh, inner.y.data(), s, vv, n);
+
+    timers_.fgmres_inner_solve.stop();
+}
+
 /*     =============================================================== */
 static void update_(long int i, long int n, double* x, const double* h, long int ldh,
                     double* y, const double* s, const double* v, long int ldv)
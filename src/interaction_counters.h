@@ -0,0 +1,132 @@
+#ifndef H_TABIPB_INTERACTION_COUNTERS_H
+#define H_TABIPB_INTERACTION_COUNTERS_H
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef OPENMP_ENABLED
+    #include <omp.h>
+#endif
+
+/* Number, size and time of the PP, PC, CP and CC interactions of the matvecs.
+ * The kernels run inside parallel loops, so each thread adds to its own slot,
+ * padded to a cache line as the workspace slabs are; collect() merges and
+ * clears the slots at a serial point. */
+class InteractionCounters
+{
+public:
+    enum Kind { PP, PC, CP, CC, NUM_KINDS };
+
+    struct Counts {
+        uint64_t interactions[NUM_KINDS] = {};
+        uint64_t pairs[NUM_KINDS] = {};
+        uint64_t bytes[NUM_KINDS] = {};  // of the point arrays read or written
+        double seconds[NUM_KINDS] = {};  // summed over threads
+
+        void add(const Counts& other) {
+            for (int k = 0; k < NUM_KINDS; ++k) {
+                interactions[k] += other.interactions[k];
+                pairs[k]        += other.pairs[k];
+                bytes[k]        += other.bytes[k];
+                seconds[k]      += other.seconds[k];
+            }
+        }
+
+        /* rough operation counts of the double precision kernels per target-source
+         * pair, counting sqrt, exp and division as one flop each */
+        double flops(int kind) const {
+            static const double FLOPS_PER_PAIR[NUM_KINDS] = {60., 80., 80., 80.};
+            return FLOPS_PER_PAIR[kind] * pairs[kind];
+        }
+    };
+
+private:
+    static constexpr std::size_t PAD = 64;
+
+    struct Slot {
+        Counts counts;
+        char pad[PAD - sizeof(Counts) % PAD];
+    };
+
+    int base_level_ = 0;
+    std::vector<Slot> slots_ = std::vector<Slot>(1);
+
+    std::size_t thread_num() const {
+#ifdef OPENMP_ENABLED
+        return omp_get_level() > base_level_ ? omp_get_thread_num() : 0;
+#else
+        return 0;
+#endif
+    }
+
+public:
+    InteractionCounters() = default;
+    ~InteractionCounters() = default;
+
+    /* one slot per thread of the parallel loops started from the calling level;
+     * only grows, so it can be called again before each matvec */
+    void reserve() {
+#ifdef OPENMP_ENABLED
+        base_level_ = omp_get_level();
+        if (slots_.size() < static_cast<std::size_t>(omp_get_max_threads()))
+            slots_.resize(omp_get_max_threads());
+#endif
+    }
+
+    void add(Kind kind, std::size_t num_targets, std::size_t num_sources,
+             std::size_t num_vectors, double seconds) {
+        // doubles per target and per source point of each kind
+        static const std::size_t TARGET_WORDS[NUM_KINDS] = {8, 9, 4, 4};
+        static const std::size_t SOURCE_WORDS[NUM_KINDS] = {9, 4, 7, 4};
+
+        assert(thread_num() < slots_.size());
+        Counts& counts = slots_[thread_num()].counts;
+        counts.interactions[kind] += 1;
+        counts.pairs[kind]        += num_targets * num_sources * num_vectors;
+        counts.bytes[kind]        += 8 * num_vectors * (num_targets * TARGET_WORDS[kind]
+                                                      + num_sources * SOURCE_WORDS[kind]);
+        counts.seconds[kind]      += seconds;
+    }
+
+    Counts collect() {
+        Counts total;
+        for (auto& slot : slots_) {
+            total.add(slot.counts);
+            slot.counts = Counts();
+        }
+        return total;
+    }
+};
+
+
+/* adds one interaction, timed from construction to destruction, to the counters */
+class CountedInteraction
+{
+private:
+    InteractionCounters& counters_;
+    InteractionCounters::Kind kind_;
+    std::size_t num_targets_;
+    std::size_t num_sources_;
+    std::size_t num_vectors_;
+    std::chrono::steady_clock::time_point start_;
+
+public:
+    CountedInteraction(InteractionCounters& counters, InteractionCounters::Kind kind,
+                       std::size_t num_targets, std::size_t num_sources, std::size_t num_vectors = 1)
+        : counters_(counters), kind_(kind), num_targets_(num_targets),
+          num_sources_(num_sources), num_vectors_(num_vectors),
+          start_(std::chrono::steady_clock::now()) {}
+
+    ~CountedInteraction() {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_;
+        counters_.add(kind_, num_targets_, num_sources_, num_vectors_, elapsed.count());
+    }
+
+    CountedInteraction(const CountedInteraction&) = delete;
+    CountedInteraction& operator=(const CountedInteraction&) = delete;
+};
+
+#endif /* H_TABIPB_INTERACTION_COUNTERS_H */
@@ -2,7 +2,17 @@
 #include <iomanip>
 #include <cmath>
 #include <cstddef>
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
 
+#ifdef OPENMP_ENABLED
+    #include <omp.h>
+#endif
+
+#include "console.h"
 #include "interaction_list.h"
 
 InteractionList::InteractionList(const class Tree& tree, const int degree, const double theta,
@@ -12,13 +22,11 @@ InteractionList::InteractionList(const class Tree& tree, const int degree, const
 {
     timers_.ctor.start();
 
-    particle_particle_.resize(target_tree_.num_nodes_);
-    particle_cluster_ .resize(target_tree_.num_nodes_);
-    cluster_particle_ .resize(target_tree_.num_nodes_);
-    cluster_cluster_  .resize(target_tree_.num_nodes_);
+    if (source_tree_.num_nodes_ > std::numeric_limits<node_index_t>::max()) {
+        throw std::runtime_error("too many tree nodes for interaction list indices");
+    }
     
-    //for (auto batch_idx : tree_.leaves_) InteractionList::build_BLTC_lists(batch_idx, 0);
-    InteractionList::build_BLDTT_lists(0,0);
+    InteractionList::build_BLDTT_lists();
 
     timers_.ctor.stop();
 }
@@ -30,101 +38,179 @@ InteractionList::InteractionList(const class Tree& target_tree, const class Tree
 {
     timers_.ctor.start();
 
-    particle_particle_.resize(target_tree_.num_nodes_);
-    particle_cluster_ .resize(target_tree_.num_nodes_);
-    cluster_particle_ .resize(target_tree_.num_nodes_);
-    cluster_cluster_  .resize(target_tree_.num_nodes_);
+    if (source_tree_.num_nodes_ > std::numeric_limits<node_index_t>::max()) {
+        throw std::runtime_error("too many tree nodes for interaction list indices");
+    }
     
-    //for (auto batch_idx : tree_.leaves_) InteractionList::build_BLTC_lists(batch_idx, 0);
-    InteractionList::build_BLDTT_lists(0,0);
+    InteractionList::build_BLDTT_lists();
 
     timers_.ctor.stop();
 }
 
 
-void InteractionList::build_BLTC_lists(std::size_t batch_idx, std::size_t node_idx)
+void InteractionList::build_BLTC_lists(std::size_t batch_idx, std::size_t node_idx,
+                                       std::vector<NodePair>& entries) const
 {
-    double dist_x = target_tree_.node_x_mid_[batch_idx] - source_tree_.node_x_mid_[node_idx];
-    double dist_y = target_tree_.node_y_mid_[batch_idx] - source_tree_.node_y_mid_[node_idx];
-    double dist_z = target_tree_.node_z_mid_[batch_idx] - source_tree_.node_z_mid_[node_idx];
+    const auto& batch = target_tree_.nodes_[batch_idx];
+    const auto& node  = source_tree_.nodes_[node_idx];
+    
+    double dist_x = batch.x_mid - node.x_mid;
+    double dist_y = batch.y_mid - node.y_mid;
+    double dist_z = batch.z_mid - node.z_mid;
     
     double dist = std::sqrt(dist_x*dist_x + dist_y*dist_y + dist_z*dist_z);
     
-    if ((source_tree_.node_radius_[batch_idx] + target_tree_.node_radius_[node_idx])
-         < dist * theta_
-       && target_tree_.node_num_particles_[node_idx] > size_check_) {
-       particle_cluster_[batch_idx].push_back(node_idx);
+    if ((batch.radius + node.radius) < dist * theta_
+       && node.num_particles() > size_check_) {
+       entries.push_back({batch_idx, node_idx, PC, false});
        
-    } else if (source_tree_.node_num_children_[node_idx] == 0) {
-        particle_particle_[batch_idx].push_back(node_idx);
+    } else if (node.num_children == 0) {
+        entries.push_back({batch_idx, node_idx, PP, false});
     
     } else {
-        for (int i = 0; i < source_tree_.node_num_children_[node_idx]; ++i)
-            InteractionList::build_BLTC_lists(batch_idx, source_tree_.node_children_idx_[8*node_idx + i]);
+        for (std::size_t i = 0; i < node.num_children; ++i)
+            InteractionList::build_BLTC_lists(batch_idx, source_tree_.children_[node.first_child + i], entries);
+    }
+}
+
+
+void InteractionList::build_BLDTT_lists()
+{
+    // Expand the root pair breadth-first until there is enough open work to
+    // share out. The frontier stays in depth-first order, so merging the
+    // per-pair fragments back in frontier order gives the same lists, in the
+    // same order, as a serial recursive traversal.
+    std::size_t num_threads = 1;
+#ifdef OPENMP_ENABLED
+    num_threads = omp_get_max_threads();
+#endif
+
+    std::vector<NodePair> frontier {{0, 0, PP, true}};
+    std::vector<NodePair> next_frontier;
+    std::size_t num_open = 1;
+    
+    while (num_threads > 1 && num_open > 0 && num_open < 16 * num_threads) {
+        next_frontier.clear();
+        for (const auto& pair : frontier) {
+            if (pair.open) InteractionList::expand_BLDTT(pair, next_frontier);
+            else next_frontier.push_back(pair);
+        }
+        frontier.swap(next_frontier);
+        num_open = std::count_if(frontier.begin(), frontier.end(),
+                                 [](const NodePair& pair) { return pair.open; });
+    }
+    
+    std::vector<std::vector<NodePair>> fragments(frontier.size());
+    
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t i = 0; i < frontier.size(); ++i) {
+        if (frontier[i].open) InteractionList::traverse_BLDTT(frontier[i], fragments[i]);
+    }
+    
+    // Count the entries of every row, then scatter them in frontier order
+    // into the flattened lists.
+    std::size_t num_rows = target_tree_.num_nodes_;
+    for (auto& list : lists_) list.offsets.assign(num_rows + 1, 0);
+    
+    for (std::size_t i = 0; i < frontier.size(); ++i) {
+        if (!frontier[i].open) lists_[frontier[i].type].offsets[frontier[i].target + 1]++;
+        for (const auto& entry : fragments[i]) lists_[entry.type].offsets[entry.target + 1]++;
+    }
+    
+    std::vector<std::size_t> cursors[4];
+    for (int type = 0; type < 4; ++type) {
+        auto& offsets = lists_[type].offsets;
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        lists_[type].indices.resize(offsets.back());
+        cursors[type].assign(offsets.begin(), offsets.end() - 1);
+    }
+    
+    auto scatter = [&](const NodePair& entry) {
+        lists_[entry.type].indices[cursors[entry.type][entry.target]++] = entry.source;
+    };
+    
+    for (std::size_t i = 0; i < frontier.size(); ++i) {
+        if (!frontier[i].open) scatter(frontier[i]);
+        for (const auto& entry : fragments[i]) scatter(entry);
+        std::vector<NodePair>().swap(fragments[i]);
+    }
+}
+
+
+void InteractionList::traverse_BLDTT(NodePair root, std::vector<NodePair>& entries) const
+{
+    // explicit stack, children pushed in reverse to keep depth-first order
+    std::vector<NodePair> stack {root};
+    std::vector<NodePair> expanded;
+    
+    while (!stack.empty()) {
+        NodePair pair = stack.back();
+        stack.pop_back();
+        
+        expanded.clear();
+        InteractionList::expand_BLDTT(pair, expanded);
+        
+        if (!expanded.back().open) entries.push_back(expanded.back());
+        else stack.insert(stack.end(), expanded.rbegin(), expanded.rend());
     }
 }
 
 
-void InteractionList::build_BLDTT_lists(std::size_t target_node_idx, std::size_t source_node_idx)
+void InteractionList::expand_BLDTT(NodePair pair, std::vector<NodePair>& out) const
 {
-    double dist_x = target_tree_.node_x_mid_[target_node_idx] - source_tree_.node_x_mid_[source_node_idx];
-    double dist_y = target_tree_.node_y_mid_[target_node_idx] - source_tree_.node_y_mid_[source_node_idx];
-    double dist_z = target_tree_.node_z_mid_[target_node_idx] - source_tree_.node_z_mid_[source_node_idx];
+    std::size_t target_node_idx = pair.target;
+    std::size_t source_node_idx = pair.source;
+    
+    const auto& target_node = target_tree_.nodes_[target_node_idx];
+    const auto& source_node = source_tree_.nodes_[source_node_idx];
+    
+    double dist_x = target_node.x_mid - source_node.x_mid;
+    double dist_y = target_node.y_mid - source_node.y_mid;
+    double dist_z = target_node.z_mid - source_node.z_mid;
     
     double accept_distance = std::sqrt(dist_x*dist_x + dist_y*dist_y + dist_z*dist_z) * theta_;
-    double sum_node_radius = target_tree_.node_radius_[target_node_idx]
-                           + source_tree_.node_radius_[source_node_idx];
+    double sum_node_radius = target_node.radius + source_node.radius;
 
-    bool target_node_size_check_passed = target_tree_.node_num_particles_[target_node_idx] > size_check_;
-    bool source_node_size_check_passed = source_tree_.node_num_particles_[source_node_idx] > size_check_;
+    std::size_t target_node_num_particles = target_node.num_particles();
+    std::size_t source_node_num_particles = source_node.num_particles();
     
-    int target_node_num_children = target_tree_.node_num_children_[target_node_idx];
-    int source_node_num_children = source_tree_.node_num_children_[source_node_idx];
+    bool target_node_size_check_passed = target_node_num_particles > size_check_;
+    bool source_node_size_check_passed = source_node_num_particles > size_check_;
     
-    std::size_t target_node_num_particles = target_tree_.node_num_particles_[target_node_idx];
-    std::size_t source_node_num_particles = source_tree_.node_num_particles_[source_node_idx];
+    int target_node_num_children = target_node.num_children;
+    int source_node_num_children = source_node.num_children;
     
     
     if (sum_node_radius < accept_distance) {
     
         if (!target_node_size_check_passed && !source_node_size_check_passed) {
-            particle_particle_[target_node_idx].push_back(source_node_idx);
+            out.push_back({target_node_idx, source_node_idx, PP, false});
         
         } else if (!source_node_size_check_passed) {
-            cluster_particle_[target_node_idx].push_back(source_node_idx);
+            out.push_back({target_node_idx, source_node_idx, CP, false});
             
         } else if (!target_node_size_check_passed) {
-            particle_cluster_[target_node_idx].push_back(source_node_idx);
+            out.push_back({target_node_idx, source_node_idx, PC, false});
             
         } else {
-            cluster_cluster_[target_node_idx].push_back(source_node_idx);
+            out.push_back({target_node_idx, source_node_idx, CC, false});
         }
        
     } else {
     
         if (!target_node_num_children && !source_node_num_children) {
-            particle_particle_[target_node_idx].push_back(source_node_idx);
+            out.push_back({target_node_idx, source_node_idx, PP, false});
     
-        } else if (!source_node_num_children) {
+        } else if (!source_node_num_children
+               || (target_node_num_children && source_node_num_particles < target_node_num_particles)) {
             for (int i = 0; i < target_node_num_children; ++i)
-                InteractionList::build_BLDTT_lists(target_tree_.node_children_idx_[8*target_node_idx + i],
-                                                   source_node_idx);
-    
-        } else if (!target_node_num_children) {
-            for (int i = 0; i < source_node_num_children; ++i)
-                InteractionList::build_BLDTT_lists(target_node_idx,
-                                                   source_tree_.node_children_idx_[8*source_node_idx + i]);
-    
-        } else if (source_node_num_particles < target_node_num_particles) {
-            for (int i = 0; i < target_node_num_children; ++i)
-                InteractionList::build_BLDTT_lists(target_tree_.node_children_idx_[8*target_node_idx + i],
-                                                   source_node_idx);
+                out.push_back({target_tree_.children_[target_node.first_child + i], source_node_idx, PP, true});
     
         } else {
             for (int i = 0; i < source_node_num_children; ++i)
-                InteractionList::build_BLDTT_lists(target_node_idx,
-                                                   source_tree_.node_children_idx_[8*source_node_idx + i]);
-        
+                out.push_back({target_node_idx, source_tree_.children_[source_node.first_child + i], PP, true});
         }
     }
 }
@@ -132,12 +218,12 @@ void InteractionList::build_BLDTT_lists(std::size_t target_node_idx, std::size_t
 
 void Timers_InteractionList::print() const
 {
-    std::cout.setf(std::ios::fixed, std::ios::floatfield);
-    std::cout.precision(5);
-    std::cout << "|...InteractionList function times (s)...." << std::endl;
-    std::cout << "|   |...ctor.......................: ";
-    std::cout << std::setw(12) << std::right << ctor.elapsed_time() << std::endl;
-    std::cout << "|" << std::endl;
+    console::out().setf(std::ios::fixed, std::ios::floatfield);
+    console::out().precision(5);
+    console::out() << "|...InteractionList function times (s)...." << std::endl;
+    console::out() << "|   |...ctor.......................: ";
+    console::out() << std::setw(12) << std::right << ctor.elapsed_time() << std::endl;
+    console::out() << "|" << std::endl;
 }
 
 
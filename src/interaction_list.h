@@ -2,6 +2,8 @@
 #define H_TABIPB_INTERACTION_LIST_STRUCT_H
 
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 
 #include "timer.h"
 #include "tree.h"
@@ -18,13 +20,48 @@ private:
     int size_check_;
     double theta_;
     
-    std::vector<std::vector<std::size_t>> particle_particle_;
-    std::vector<std::vector<std::size_t>> particle_cluster_;
-    std::vector<std::vector<std::size_t>> cluster_particle_;
-    std::vector<std::vector<std::size_t>> cluster_cluster_;
+public:
+    using node_index_t = std::uint32_t;
+    
+    /* source nodes interacting with one target node, contiguous in memory */
+    struct NodeRange {
+        const node_index_t* begin_;
+        const node_index_t* end_;
+        
+        const node_index_t* begin() const { return begin_; }
+        const node_index_t* end()   const { return end_; }
+        std::size_t size() const { return end_ - begin_; }
+        bool empty() const { return begin_ == end_; }
+    };
+    
+private:
+    /* compressed sparse rows: the sources of target i are
+     * indices[offsets[i], offsets[i+1]) */
+    struct List {
+        std::vector<std::size_t> offsets;
+        std::vector<node_index_t> indices;
+        
+        NodeRange row(std::size_t idx) const {
+            return {indices.data() + offsets[idx], indices.data() + offsets[idx + 1]};
+        }
+    };
+    
+    enum ListType { PP, PC, CP, CC };
+    
+    /* a target/source node pair, or an entry of the list given by type */
+    struct NodePair {
+        std::size_t target;
+        std::size_t source;
+        ListType type;
+        bool open;
+    };
+    
+    List lists_[4];
     
-    void build_BLTC_lists(std::size_t batch_idx, std::size_t node_idx);
-    void build_BLDTT_lists(std::size_t target_node_idx, std::size_t source_node_idx);
+    void build_BLTC_lists(std::size_t batch_idx, std::size_t node_idx, std::vector<NodePair>& entries) const;
+    void build_BLDTT_lists();
+    void traverse_BLDTT(NodePair root, std::vector<NodePair>& entries) const;
+    void expand_BLDTT(NodePair pair, std::vector<NodePair>& out) const;
     
 public:
     InteractionList(const class Tree&, const int degree, const double theta, struct Timers_InteractionList&);
@@ -32,10 +69,10 @@ public:
                     const int degree, const double theta, struct Timers_InteractionList&);
     ~InteractionList() = default;
     
-    const std::vector<std::size_t>& particle_particle(std::size_t idx) const { return particle_particle_[idx]; }
-    const std::vector<std::size_t>& particle_cluster (std::size_t idx) const { return particle_cluster_ [idx]; }
-    const std::vector<std::size_t>& cluster_particle (std::size_t idx) const { return cluster_particle_ [idx]; }
-    const std::vector<std::size_t>& cluster_cluster  (std::size_t idx) const { return cluster_cluster_  [idx]; }
+    NodeRange particle_particle(std::size_t idx) const { return lists_[PP].row(idx); }
+    NodeRange particle_cluster (std::size_t idx) const { return lists_[PC].row(idx); }
+    NodeRange cluster_particle (std::size_t idx) const { return lists_[CP].row(idx); }
+    NodeRange cluster_cluster  (std::size_t idx) const { return lists_[CC].row(idx); }
 };
 
 
@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
+#include <limits>
 
 #include "interp_pts.h"
 #include "tree.h"
@@ -17,6 +19,12 @@ InterpolationPoints::InterpolationPoints(const class Tree& tree, int degree)
     interp_y_.resize(num_interp_pts_);
     interp_z_.resize(num_interp_pts_);
 
+    weights_.resize(num_interp_pts_per_node_);
+    for (int i = 0; i < num_interp_pts_per_node_; ++i) {
+        weights_[i] = ((i % 2 == 0)? 1 : -1);
+        if (i == 0 || i == num_interp_pts_per_node_-1) weights_[i] = ((i % 2 == 0)? 1 : -1) * 0.5;
+    }
+
     //timers_.ctor.stop();
 }
 
@@ -47,10 +55,189 @@ void InterpolationPoints::compute_all_interp_pts()
         }
     }
 
+#ifndef OPENACC_ENABLED
+    InterpolationPoints::compute_transfer_operators();
+#endif
+
     //timers_.compute_all_interp_pts.stop();
 }
 
 
+void InterpolationPoints::compute_transfer_operators()
+{
+    int num_interp_pts_per_node = num_interp_pts_per_node_;
+    std::size_t transfer_size = 3 * num_interp_pts_per_node * num_interp_pts_per_node;
+    
+    transfer_.assign(tree_.num_nodes() * transfer_size, 0.);
+    
+    const double* clusters_ptr[3] = {interp_x_.data(), interp_y_.data(), interp_z_.data()};
+
+    for (std::size_t node_idx = 1; node_idx < tree_.num_nodes(); ++node_idx) {
+    
+        std::size_t node_start   = node_idx * num_interp_pts_per_node;
+        std::size_t parent_start = tree_.node_parent_idx(node_idx) * num_interp_pts_per_node;
+        double* transfer_ptr = &transfer_[node_idx * transfer_size];
+        
+        for (int dim = 0; dim < 3; ++dim) {
+        for (int k = 0; k < num_interp_pts_per_node; ++k) {
+            InterpolationPoints::lagrange_basis(clusters_ptr[dim][node_start + k],
+                                                clusters_ptr[dim] + parent_start,
+                                                num_interp_pts_per_node, transfer_ptr);
+            transfer_ptr += num_interp_pts_per_node;
+        }
+        }
+    }
+}
+
+
+void InterpolationPoints::upward_transfer(double* __restrict charge, class Workspace& workspace) const
+{
+    int num_pts = num_interp_pts_per_node_;
+    std::size_t num_charges_per_node = num_pts * num_pts * num_pts;
+    std::size_t transfer_size = 3 * num_pts * num_pts;
+    
+    for (std::size_t level = tree_.num_levels() - 1; level-- > 0;) {
+        const auto& level_nodes = tree_.level_nodes(level);
+        
+        // each parent accumulates into its own grid only
+#ifdef OPENMP_ENABLED
+        #pragma omp parallel for schedule(dynamic)
+#endif
+        for (std::size_t level_idx = 0; level_idx < level_nodes.size(); ++level_idx) {
+        
+            std::size_t node_idx = level_nodes[level_idx];
+            
+            double* __restrict temp_1 = workspace.doubles();
+            double* __restrict temp_2 = temp_1 + num_charges_per_node;
+        
+            double* parent_q = charge + node_idx * num_charges_per_node;
+            
+            for (std::size_t child = 0; child < tree_.node_num_children(node_idx); ++child) {
+            
+                std::size_t child_idx = tree_.node_child_idx(node_idx, child);
+                const double* child_q = charge + child_idx * num_charges_per_node;
+                
+                const double* transfer_x = &transfer_[child_idx * transfer_size];
+                const double* transfer_y = transfer_x + num_pts * num_pts;
+                const double* transfer_z = transfer_y + num_pts * num_pts;
+                
+                // contract one dimension at a time: z, then y, then x
+                std::fill(temp_1, temp_1 + num_charges_per_node, 0.);
+                for (int k1 = 0; k1 < num_pts; ++k1)
+                for (int k2 = 0; k2 < num_pts; ++k2)
+                for (int k3 = 0; k3 < num_pts; ++k3) {
+                    double q = child_q[(k1 * num_pts + k2) * num_pts + k3];
+                    for (int kk3 = 0; kk3 < num_pts; ++kk3)
+                        temp_1[(k1 * num_pts + k2) * num_pts + kk3] += transfer_z[k3 * num_pts + kk3] * q;
+                }
+                
+                std::fill(temp_2, temp_2 + num_charges_per_node, 0.);
+                for (int k1 = 0; k1 < num_pts; ++k1)
+                for (int k2 = 0; k2 < num_pts; ++k2)
+                for (int kk2 = 0; kk2 < num_pts; ++kk2) {
+                    double t = transfer_y[k2 * num_pts + kk2];
+                    for (int kk3 = 0; kk3 < num_pts; ++kk3)
+                        temp_2[(k1 * num_pts + kk2) * num_pts + kk3] += t * temp_1[(k1 * num_pts + k2) * num_pts + kk3];
+                }
+                
+                for (int k1 = 0; k1 < num_pts; ++k1)
+                for (int kk1 = 0; kk1 < num_pts; ++kk1) {
+                    double t = transfer_x[k1 * num_pts + kk1];
+                    for (std::size_t kk23 = 0; kk23 < (std::size_t)(num_pts * num_pts); ++kk23)
+                        parent_q[kk1 * num_pts * num_pts + kk23] += t * temp_2[k1 * num_pts * num_pts + kk23];
+                }
+            }
+        }
+    }
+}
+
+
+void InterpolationPoints::downward_transfer(double* __restrict potential, class Workspace& workspace) const
+{
+    int num_pts = num_interp_pts_per_node_;
+    std::size_t num_potentials_per_node = num_pts * num_pts * num_pts;
+    std::size_t transfer_size = 3 * num_pts * num_pts;
+    
+    for (std::size_t level = 0; level + 1 < tree_.num_levels(); ++level) {
+        const auto& level_nodes = tree_.level_nodes(level);
+        
+        // each parent writes to its own children's grids only
+#ifdef OPENMP_ENABLED
+        #pragma omp parallel for schedule(dynamic)
+#endif
+        for (std::size_t level_idx = 0; level_idx < level_nodes.size(); ++level_idx) {
+        
+            std::size_t node_idx = level_nodes[level_idx];
+            
+            double* __restrict temp_1 = workspace.doubles();
+            double* __restrict temp_2 = temp_1 + num_potentials_per_node;
+        
+            const double* parent_p = potential + node_idx * num_potentials_per_node;
+            
+            for (std::size_t child = 0; child < tree_.node_num_children(node_idx); ++child) {
+            
+                std::size_t child_idx = tree_.node_child_idx(node_idx, child);
+                double* child_p = potential + child_idx * num_potentials_per_node;
+                
+                const double* transfer_x = &transfer_[child_idx * transfer_size];
+                const double* transfer_y = transfer_x + num_pts * num_pts;
+                const double* transfer_z = transfer_y + num_pts * num_pts;
+                
+                // transpose of the upward contraction: z, then y, then x
+                std::fill(temp_1, temp_1 + num_potentials_per_node, 0.);
+                for (int kk1 = 0; kk1 < num_pts; ++kk1)
+                for (int kk2 = 0; kk2 < num_pts; ++kk2)
+                for (int k3 = 0; k3 < num_pts; ++k3) {
+                    double p = 0.;
+                    for (int kk3 = 0; kk3 < num_pts; ++kk3)
+                        p += transfer_z[k3 * num_pts + kk3] * parent_p[(kk1 * num_pts + kk2) * num_pts + kk3];
+                    temp_1[(kk1 * num_pts + kk2) * num_pts + k3] = p;
+                }
+                
+                std::fill(temp_2, temp_2 + num_potentials_per_node, 0.);
+                for (int kk1 = 0; kk1 < num_pts; ++kk1)
+                for (int k2 = 0; k2 < num_pts; ++k2)
+                for (int kk2 = 0; kk2 < num_pts; ++kk2) {
+                    double t = transfer_y[k2 * num_pts + kk2];
+                    for (int k3 = 0; k3 < num_pts; ++k3)
+                        temp_2[(kk1 * num_pts + k2) * num_pts + k3] += t * temp_1[(kk1 * num_pts + kk2) * num_pts + k3];
+                }
+                
+                for (int k1 = 0; k1 < num_pts; ++k1)
+                for (int kk1 = 0; kk1 < num_pts; ++kk1) {
+                    double t = transfer_x[k1 * num_pts + kk1];
+                    for (std::size_t k23 = 0; k23 < (std::size_t)(num_pts * num_pts); ++k23)
+                        child_p[k1 * num_pts * num_pts + k23] += t * temp_2[kk1 * num_pts * num_pts + k23];
+                }
+            }
+        }
+    }
+}
+
+void InterpolationPoints::lagrange_basis(double coord, const double* interp_pts, int num_interp_pts,
+                                         double* basis)
+{
+    // barycentric weights of the Chebyshev points of the second kind
+    double denominator = 0.;
+    int exact_idx = -1;
+    
+    for (int j = 0; j < num_interp_pts; ++j) {
+        double weight = ((j % 2 == 0)? 1 : -1);
+        if (j == 0 || j == num_interp_pts-1) weight *= 0.5;
+        
+        double dist = coord - interp_pts[j];
+        if (std::abs(dist) < std::numeric_limits<double>::min()) exact_idx = j;
+        basis[j] = weight / dist;
+        denominator += basis[j];
+    }
+    
+    for (int j = 0; j < num_interp_pts; ++j) {
+        if (exact_idx == -1) basis[j] /= denominator;
+        else basis[j] = (j == exact_idx) ? 1. : 0.;
+    }
+}
+
+
 
 
 void InterpolationPoints::copyin_to_device() const
@@ -2,8 +2,10 @@
 #define H_TABIPB_INTERP_PTS_STRUCT_H
 
 #include <cstddef>
+#include <vector>
 
 #include "tree.h"
+#include "workspace.h"
 
 class InterpolationPoints
 {
@@ -17,6 +19,14 @@ private:
     std::vector<double> interp_y_;
     std::vector<double> interp_z_;
     
+    /* barycentric weights of the Chebyshev points of the second kind */
+    std::vector<double> weights_;
+    
+    /* per node, its parent's 1D Lagrange basis evaluated at the node's interpolation points */
+    std::vector<double> transfer_;
+    
+    void compute_transfer_operators();
+    
     
 public:
     InterpolationPoints(const class Tree&, int degree);
@@ -32,8 +42,27 @@ public:
     const double* interp_x_ptr() const { return interp_x_.data(); };
     const double* interp_y_ptr() const { return interp_y_.data(); };
     const double* interp_z_ptr() const { return interp_z_.data(); };
+    const double* weights_ptr() const { return weights_.data(); };
     
     void compute_all_interp_pts();
+    
+    /* accumulates cluster charges from children into parents, level by level;
+     * on entry only the leaves need to hold their anterpolated charges. Each
+     * thread takes transfer_workspace_size() doubles from the workspace. */
+    void upward_transfer(double* __restrict charge, class Workspace& workspace) const;
+    
+    /* accumulates cluster potentials from parents into children, level by level;
+     * on exit every leaf holds the far-field potential of all its ancestors */
+    void downward_transfer(double* __restrict potential, class Workspace& workspace) const;
+    
+    /* scratch of the transfers per thread: two grids of a node */
+    std::size_t transfer_workspace_size() const {
+        return 2 * static_cast<std::size_t>(num_interp_pts_per_node_)
+                 * num_interp_pts_per_node_ * num_interp_pts_per_node_;
+    }
+    
+    static void lagrange_basis(double coord, const double* interp_pts, int num_interp_pts, double* basis);
+    
     void copyin_to_device() const;
     void delete_from_device() const;
     
@@ -0,0 +1,54 @@
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+
+MappedFile::MappedFile(const std::string& path)
+{
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("cannot open " + path);
+
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot open " + path);
+    }
+    size_ = status.st_size;
+
+    if (size_ > 0) {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(data);
+            mapped_ = true;
+        }
+    }
+    close(fd);
+    
+    if (mapped_ || size_ == 0) return;
+#endif
+
+    // no mapping available: read the whole file instead
+    std::ifstream file(path, std::ios::binary);
+    if (!file.good()) throw std::runtime_error("cannot open " + path);
+
+    buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+    if (mapped_) munmap(const_cast<char*>(data_), size_);
+#endif
+}
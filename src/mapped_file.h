@@ -0,0 +1,229 @@
+#ifndef H_TABIPB_MAPPED_FILE_H
+#define H_TABIPB_MAPPED_FILE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef OPENMP_ENABLED
+    #include <omp.h>
+#endif
+
+/* Read-only view of a whole file: memory mapped on POSIX systems, read into a
+ * buffer elsewhere. Throws std::runtime_error if the file cannot be read. */
+class MappedFile
+{
+private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+    bool mapped_ = false;
+    std::vector<char> buffer_;
+
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* begin() const { return data_; };
+    const char* end()   const { return data_ + size_; };
+    std::size_t size()  const { return size_; };
+};
+
+
+/* Number and line parsing on character ranges that need not be NUL terminated.
+ * The parse functions return the position after the number, or nullptr if none
+ * starts at p (after leading blanks). */
+namespace text_parse {
+
+    inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+    inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+    inline const char* skip_blanks(const char* p, const char* end) {
+        while (p < end && is_blank(*p)) ++p;
+        return p;
+    }
+
+    inline const char* line_end(const char* p, const char* end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        return newline ? newline : end;
+    }
+
+    inline bool is_blank_line(const char* p, const char* end) {
+        return skip_blanks(p, end) == end;
+    }
+
+    inline const char* parse_uint(const char* p, const char* end, uint64_t& value) {
+        p = skip_blanks(p, end);
+        if (p == end || !is_digit(*p)) return nullptr;
+        value = 0;
+        while (p < end && is_digit(*p)) value = value * 10 + (*p++ - '0');
+        return p;
+    }
+
+    /* Decimal mantissas of up to 15 digits with decimal exponents within 22 of
+     * zero convert exactly with one multiplication or division, which covers
+     * the fixed point values of mesh and structure files; anything longer falls
+     * back to strtod. */
+    inline const char* parse_double(const char* p, const char* end, double& value) {
+        static const double POW10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                       1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                       1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        p = skip_blanks(p, end);
+        const char* start = p;
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+        uint64_t mantissa = 0;
+        int num_digits = 0;
+        int exponent = 0;
+        bool any_digit = false;
+
+        for (; p < end && is_digit(*p); ++p, any_digit = true) {
+            if (mantissa == 0 && *p == '0') continue;
+            mantissa = mantissa * 10 + (*p - '0');
+            ++num_digits;
+        }
+        if (p < end && *p == '.') {
+            for (++p; p < end && is_digit(*p); ++p, any_digit = true) {
+                --exponent;
+                if (mantissa == 0 && *p == '0') continue;
+                mantissa = mantissa * 10 + (*p - '0');
+                ++num_digits;
+            }
+        }
+        if (!any_digit) return nullptr;
+
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            const char* q = p + 1;
+            bool exponent_negative = false;
+            if (q < end && (*q == '-' || *q == '+')) exponent_negative = (*q++ == '-');
+            uint64_t exponent_value;
+            const char* after = (q < end && is_digit(*q)) ? parse_uint(q, end, exponent_value) : nullptr;
+            if (after) {
+                exponent += exponent_negative ? -static_cast<int>(exponent_value)
+                                              :  static_cast<int>(exponent_value);
+                p = after;
+            }
+        }
+
+        if (num_digits <= 15 && exponent >= -22 && exponent <= 22) {
+            value = exponent < 0 ? mantissa / POW10[-exponent] : mantissa * POW10[exponent];
+            if (negative) value = -value;
+            return p;
+        }
+
+        char token[64];
+        std::size_t length = std::min<std::size_t>(p - start, sizeof(token) - 1);
+        std::memcpy(token, start, length);
+        token[length] = '\0';
+        value = std::strtod(token, nullptr);
+        return p;
+    }
+
+    /* lines of a range split at line boundaries into chunks, with the number of
+     * selected lines before each chunk */
+    struct LineChunks {
+        std::vector<const char*> begin;
+        std::vector<std::size_t> offset;
+
+        std::size_t num_chunks() const { return begin.size() - 1; };
+        std::size_t num_lines()  const { return offset.back(); };
+    };
+
+    /* Splits [begin, end) into chunks and counts, in parallel, the lines of each
+     * chunk for which select(line_begin, line_end) is true. */
+    template <typename Select>
+    LineChunks count_lines(const char* begin, const char* end, Select select)
+    {
+        std::size_t num_chunks = 1;
+#ifdef OPENMP_ENABLED
+        num_chunks = 4 * omp_get_max_threads();
+#endif
+        num_chunks = std::max<std::size_t>(1, std::min<std::size_t>(num_chunks, (end - begin) / 65536));
+
+        LineChunks chunks;
+        chunks.begin.assign(num_chunks + 1, end);
+        chunks.offset.assign(num_chunks + 1, 0);
+
+        chunks.begin[0] = begin;
+        for (std::size_t c = 1; c < num_chunks; ++c) {
+            const char* p = begin + (end - begin) * c / num_chunks;
+            p = std::max(p, chunks.begin[c - 1]);
+            chunks.begin[c] = std::min(line_end(p, end) + 1, end);
+        }
+
+#ifdef OPENMP_ENABLED
+        #pragma omp parallel for schedule(dynamic)
+#endif
+        for (std::size_t c = 0; c < num_chunks; ++c) {
+            std::size_t count = 0;
+            for (const char* p = chunks.begin[c]; p < chunks.begin[c + 1];) {
+                const char* q = line_end(p, chunks.begin[c + 1]);
+                if (select(p, q)) ++count;
+                p = q + 1;
+            }
+            chunks.offset[c + 1] = count;
+        }
+
+        for (std::size_t c = 0; c < num_chunks; ++c) chunks.offset[c + 1] += chunks.offset[c];
+
+        return chunks;
+    }
+
+    /* Calls parse_line(line_begin, line_end, index) in parallel for the lines
+     * counted by count_lines with the same select, numbering them in file order.
+     * Returns false, with failed_line set to the index of the first line that
+     * parse_line rejected by returning false, if there is one. */
+    template <typename Select, typename ParseLine>
+    bool parse_lines(const LineChunks& chunks, Select select, ParseLine parse_line,
+                     std::size_t& failed_line)
+    {
+        std::vector<std::size_t> chunk_failure(chunks.num_chunks(), SIZE_MAX);
+
+#ifdef OPENMP_ENABLED
+        #pragma omp parallel for schedule(dynamic)
+#endif
+        for (std::size_t c = 0; c < chunks.num_chunks(); ++c) {
+            std::size_t index = chunks.offset[c];
+            for (const char* p = chunks.begin[c]; p < chunks.begin[c + 1];) {
+                const char* q = line_end(p, chunks.begin[c + 1]);
+                if (select(p, q)) {
+                    if (!parse_line(p, q, index)) {
+                        chunk_failure[c] = index;
+                        break;
+                    }
+                    ++index;
+                }
+                p = q + 1;
+            }
+        }
+
+        failed_line = *std::min_element(chunk_failure.begin(), chunk_failure.end());
+        return failed_line == SIZE_MAX;
+    }
+
+    /* count_lines and parse_lines over the non-blank lines of [begin, end), for
+     * files whose header gives the line count. Returns false, with num_lines set
+     * to the index of the first rejected line, if parse_line rejected one, and
+     * true with num_lines set to the number of lines otherwise. */
+    template <typename ParseLine>
+    bool parse_lines(const char* begin, const char* end, ParseLine parse_line, std::size_t& num_lines)
+    {
+        auto non_blank = [](const char* p, const char* q) { return !is_blank_line(p, q); };
+
+        LineChunks chunks = count_lines(begin, end, non_blank);
+        if (!parse_lines(chunks, non_blank, parse_line, num_lines)) return false;
+
+        num_lines = chunks.num_lines();
+        return true;
+    }
+}
+
+#endif /* H_TABIPB_MAPPED_FILE_H */
@@ -4,51 +4,168 @@
 #include <iterator>
 #include <numeric>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
-// #include <cmath>
+#include <cmath>
 #include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
+#include "console.h"
+#include "mapped_file.h"
 #include "molecule.h"
 
-Molecule::Molecule(struct Params &params, struct Timers_Molecule &timers)
-    : Particles(params), timers_(timers) {
-  timers_.ctor.start();
+namespace {
+
+  bool is_atom_record(const char *p, const char *end) {
+    return (end - p >= 4 && std::memcmp(p, "ATOM", 4) == 0) ||
+           (end - p >= 6 && std::memcmp(p, "HETATM", 6) == 0);
+  }
+
+  /* Reads x, y, z, charge and radius from an ATOM or HETATM record: the last
+   * five fields when the record splits cleanly on whitespace, otherwise the
+   * PDB coordinate columns, which may run together, then charge and radius. */
+  bool parse_pqr_record(const char *p, const char *end, double (&values)[5]) {
+    using namespace text_parse;
+
+    const char *field_end = end;
+    const char *fields[5];
+    int num_fields = 0;
+    for (const char *q = end; num_fields < 5 && q > p;) {
+      while (q > p && is_blank(q[-1])) --q;
+      field_end = q;
+      while (q > p && !is_blank(q[-1])) --q;
+      if (q == field_end) break;
+      fields[4 - num_fields++] = q;
+    }
+
+    if (num_fields == 5) {
+      bool parsed = true;
+      for (int i = 0; i < 5 && parsed; ++i) {
+        const char *after = parse_double(fields[i], end, values[i]);
+        parsed = after && (after == end || is_blank(*after));
+      }
+      if (parsed) return true;
+    }
+
+    if (end - p < 54) return false;
+    for (int i = 0; i < 3; ++i) {
+      const char *column_end = p + 38 + 8 * i;
+      const char *after = parse_double(p + 30 + 8 * i, column_end, values[i]);
+      if (!after || skip_blanks(after, column_end) != column_end) return false;
+    }
+    const char *after = parse_double(p + 54, end, values[3]);
+    return after && (after = parse_double(after, end, values[4])) &&
+           skip_blanks(after, end) == end;
+  }
+
+  /* x, y, z, charge and radius of the atom records of a pqr file, in order */
+  void read_pqr(const std::string &file_name, std::vector<double> (&columns)[5]) {
+    MappedFile file(file_name);
 
-  std::string line;
-  while (std::getline(params.pqr_file_, line)) {
+    text_parse::LineChunks chunks =
+        text_parse::count_lines(file.begin(), file.end(), is_atom_record);
 
-    std::istringstream iss(line);
-    std::vector<std::string> tokenized_line{
-        std::istream_iterator<std::string>{iss},
-        std::istream_iterator<std::string>{}};
+    for (auto &column : columns)
+      column.resize(chunks.num_lines());
 
-    if (tokenized_line[0] == "ATOM") {
-      x_.push_back(std::stod(tokenized_line[5]));
-      y_.push_back(std::stod(tokenized_line[6]));
-      z_.push_back(std::stod(tokenized_line[7]));
-      charge_.push_back(std::stod(tokenized_line[8]));
-      radius_.push_back(std::stod(tokenized_line[9]));
+    std::size_t failed_atom;
+    bool parsed = text_parse::parse_lines(chunks, is_atom_record,
+        [&](const char *p, const char *end, std::size_t i) {
+          double values[5];
+          if (!parse_pqr_record(p, end, values)) return false;
+          for (int k = 0; k < 5; ++k)
+            columns[k][i] = values[k];
+          return true;
+        }, failed_atom);
+
+    if (!parsed) {
+      throw std::runtime_error(file_name + ": atom " + std::to_string(failed_atom + 1) +
+                               " is not a valid pqr record");
     }
   }
+}
+
+Molecule::Molecule(struct Params &params, struct Timers_Molecule &timers)
+    : Particles(params), timers_(timers) {
+  timers_.ctor.start();
+
+  std::vector<double> columns[5];
+  read_pqr(params.pqr_file_name_, columns);
+
+  x_      = std::move(columns[0]);
+  y_      = std::move(columns[1]);
+  z_      = std::move(columns[2]);
+  charge_ = std::move(columns[3]);
+  radius_ = std::move(columns[4]);
 
   num_ = radius_.size();
   order_.resize(num_);
   std::iota(order_.begin(), order_.end(), 0);
 
+  if (!params.charge_set_files_.empty()) {
+    charge_sets_.push_back(charge_);
+    for (const auto &file_name : params.charge_set_files_)
+      Molecule::read_charge_set(file_name);
+  }
+
   timers_.ctor.stop();
 }
 
+void Molecule::read_charge_set(const std::string &file_name) {
+  if (!std::ifstream(file_name).good()) {
+    throw std::runtime_error("charge set file " + file_name + " is not readable");
+  }
+
+  std::vector<double> columns[5];
+  read_pqr(file_name, columns);
+
+  // the atoms must be those of the pqr file, in the same order
+  bool match = columns[3].size() == num_;
+  for (std::size_t i = 0; i < num_ && match; ++i) {
+    match = std::abs(columns[0][i] - x_[i]) <= 1e-3 &&
+            std::abs(columns[1][i] - y_[i]) <= 1e-3 &&
+            std::abs(columns[2][i] - z_[i]) <= 1e-3;
+  }
+
+  if (!match) {
+    throw std::runtime_error("charge set file " + file_name + " does not match the pqr atoms");
+  }
+
+  charge_sets_.push_back(std::move(columns[3]));
+}
+
+void Molecule::select_charge_set(std::size_t set_idx) {
+  if (charge_sets_.empty())
+    return;
+
+  charge_ = charge_sets_[set_idx];
+
+#ifdef OPENACC_ENABLED
+  const double *charge_ptr = charge_.data();
+  std::size_t charge_num = charge_.size();
+#pragma acc update device(charge_ptr[0 : charge_num])
+#endif
+}
+
 void Molecule::build_xyzr_file() const {
   timers_.build_xyzr_file.start();
 
-  std::ofstream xyzr_file("molecule.xyzr");
+  // formatted into one buffer and written at once, as the stream did line by line
+  std::string xyzr;
+  xyzr.reserve(num_ * 48);
 
+  char line[128];
   for (std::size_t i = 0; i < num_; ++i) {
-    xyzr_file << x_[i] << " " << y_[i] << " " << z_[i] << " " << radius_[i]
-              << std::endl;
+    int length = std::snprintf(line, sizeof(line), "%g %g %g %g\n",
+                               x_[i], y_[i], z_[i], radius_[i]);
+    xyzr.append(line, length);
   }
 
+  std::ofstream xyzr_file("molecule.xyzr", std::ofstream::binary);
+  xyzr_file.write(xyzr.data(), xyzr.size());
   xyzr_file.close();
 
   timers_.build_xyzr_file.stop();
@@ -57,6 +174,9 @@ void Molecule::build_xyzr_file() const {
 void Molecule::reorder() {
   apply_order(order_.begin(), order_.end(), charge_.begin());
   apply_order(order_.begin(), order_.end(), radius_.begin());
+
+  for (auto &charge : charge_sets_)
+    apply_order(order_.begin(), order_.end(), charge.begin());
 }
 
 void Molecule::unorder() {
@@ -66,6 +186,9 @@ void Molecule::unorder() {
 
   apply_unorder(order_.begin(), order_.end(), charge_.begin());
   apply_unorder(order_.begin(), order_.end(), radius_.begin());
+
+  for (auto &charge : charge_sets_)
+    apply_unorder(order_.begin(), order_.end(), charge.begin());
 }
 
 void Molecule::copyin_to_device() const {
@@ -105,23 +228,23 @@ void Molecule::delete_from_device() const {
 }
 
 void Timers_Molecule::print() const {
-  std::cout.setf(std::ios::fixed, std::ios::floatfield);
-  std::cout.precision(5);
-  std::cout << "|...Molecule function times (s)...." << std::endl;
-  std::cout << "|   |...ctor.......................: ";
-  std::cout << std::setw(12) << std::right << ctor.elapsed_time() << std::endl;
-  std::cout << "|   |...build_xyzr_file............: ";
-  std::cout << std::setw(12) << std::right << build_xyzr_file.elapsed_time()
+  console::out().setf(std::ios::fixed, std::ios::floatfield);
+  console::out().precision(5);
+  console::out() << "|...Molecule function times (s)...." << std::endl;
+  console::out() << "|   |...ctor.......................: ";
+  console::out() << std::setw(12) << std::right << ctor.elapsed_time() << std::endl;
+  console::out() << "|   |...build_xyzr_file............: ";
+  console::out() << std::setw(12) << std::right << build_xyzr_file.elapsed_time()
             << std::endl;
 #ifdef OPENACC_ENABLED
-  std::cout << "|   |...copyin_to_device...........: ";
-  std::cout << std::setw(12) << std::right << copyin_to_device.elapsed_time()
+  console::out() << "|   |...copyin_to_device...........: ";
+  console::out() << std::setw(12) << std::right << copyin_to_device.elapsed_time()
             << std::endl;
-  std::cout << "|   |...delete_from_device.........: ";
-  std::cout << std::setw(12) << std::right << delete_from_device.elapsed_time()
+  console::out() << "|   |...delete_from_device.........: ";
+  console::out() << std::setw(12) << std::right << delete_from_device.elapsed_time()
             << std::endl;
 #endif
-  std::cout << "|" << std::endl;
+  console::out() << "|" << std::endl;
 }
 
 std::string Timers_Molecule::get_durations() const {
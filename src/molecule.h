@@ -23,6 +23,11 @@ private:
     double coulombic_energy_;
     std::vector<double> charge_;
     std::vector<double> radius_;
+    
+    /* every charge set, the pqr file's first, when further sets are given */
+    std::vector<std::vector<double>> charge_sets_;
+    
+    void read_charge_set(const std::string& file_name);
 
 
 public:
@@ -38,6 +43,9 @@ public:
     const double* charge_ptr() const { return charge_.data(); };
     const double* radius_ptr() const { return radius_.data(); };
     
+    std::size_t num_charge_sets() const { return charge_sets_.empty() ? 1 : charge_sets_.size(); };
+    void select_charge_set(std::size_t set_idx);
+    
     void reorder() override;
     void unorder() override;
     
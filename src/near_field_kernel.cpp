@@ -0,0 +1,673 @@
+#include <algorithm>
+#include <cmath>
+
+#include "constants.h"
+#include "near_field_kernel.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) \
+    && !defined(OPENACC_ENABLED)
+    #define NEAR_FIELD_X86_DISPATCH
+    #include <immintrin.h>
+    #define NEAR_FIELD_TARGET_AVX2   __attribute__((target("avx2,fma")))
+    #define NEAR_FIELD_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+
+namespace near_field {
+
+/* targets held in registers per tile; each source vector load is reused this many times */
+constexpr int TARGET_TILE = 4;
+
+/* vectors accumulated per pass of the block kernels; larger blocks take several passes */
+constexpr std::size_t BLOCK_VECTORS = 16;
+
+/* exp(x) for x <= 0: Cody-Waite reduction by ln2 and a degree 13 Taylor
+ * polynomial on |r| <= ln2/2, accurate to a few ulp. */
+constexpr double EXP_LOWER_BOUND = -708.;
+constexpr double LOG2E  = 1.4426950408889634074;
+constexpr double LN2_HI = 6.93147180369123816490e-01;
+constexpr double LN2_LO = 1.90821492927058770002e-10;
+constexpr double EXP_COEFF[14] = {
+    1.,                       1.,                       1. / 2.,
+    1. / 6.,                  1. / 24.,                 1. / 120.,
+    1. / 720.,                1. / 5040.,               1. / 40320.,
+    1. / 362880.,             1. / 3628800.,            1. / 39916800.,
+    1. / 479001600.,          1. / 6227020800.};
+
+
+void interact_scalar(const Geometry& geom, const double* __restrict potential_old,
+                     std::size_t target_begin, std::size_t target_end,
+                     std::size_t source_begin, std::size_t source_end,
+                     double* __restrict pot_1, double* __restrict pot_2)
+{
+    double eps    = geom.eps;
+    double kappa  = geom.kappa;
+    double kappa2 = geom.kappa2;
+    std::size_t num_elements = geom.num_elements;
+
+    for (std::size_t j = target_begin; j < target_end; ++j) {
+
+        double target_x = geom.x[j];
+        double target_y = geom.y[j];
+        double target_z = geom.z[j];
+
+        double target_nx = geom.nx[j];
+        double target_ny = geom.ny[j];
+        double target_nz = geom.nz[j];
+
+        double pot_temp_1 = 0.;
+        double pot_temp_2 = 0.;
+
+        for (std::size_t k = source_begin; k < source_end; ++k) {
+
+            double dist_x = geom.x[k] - target_x;
+            double dist_y = geom.y[k] - target_y;
+            double dist_z = geom.z[k] - target_z;
+            double r = std::sqrt(dist_x * dist_x + dist_y * dist_y + dist_z * dist_z);
+
+            if (r > 0) {
+                double source_nx = geom.nx[k];
+                double source_ny = geom.ny[k];
+                double source_nz = geom.nz[k];
+
+                double one_over_r = 1. / r;
+                double G0 = constants::ONE_OVER_4PI * one_over_r;
+                double kappa_r = kappa * r;
+                double exp_kappa_r = std::exp(-kappa_r);
+                double Gk = exp_kappa_r * G0;
+
+                double source_cos = (source_nx * dist_x + source_ny * dist_y + source_nz * dist_z) * one_over_r;
+                double target_cos = (target_nx * dist_x + target_ny * dist_y + target_nz * dist_z) * one_over_r;
+
+                double tp1 = G0 * one_over_r;
+                double tp2 = (1. + kappa_r) * exp_kappa_r;
+
+                double dot_tqsq = source_nx * target_nx + source_ny * target_ny + source_nz * target_nz;
+                double G3 = (dot_tqsq - 3. * target_cos * source_cos) * one_over_r * tp1;
+                double G4 = tp2 * G3 - kappa2 * target_cos * source_cos * Gk;
+
+                double L1 = source_cos * tp1 * (1. - tp2 * eps);
+                double L2 = G0 - Gk;
+                double L3 = G4 - G3;
+                double L4 = target_cos * tp1 * (1. - tp2 / eps);
+
+                double potential_old_0 = potential_old[k];
+                double potential_old_1 = potential_old[k + num_elements];
+
+                pot_temp_1 += (L1 * potential_old_0 + L2 * potential_old_1) * geom.area[k];
+                pot_temp_2 += (L3 * potential_old_0 + L4 * potential_old_1) * geom.area[k];
+            }
+        }
+
+        pot_1[j - target_begin] += pot_temp_1;
+        pot_2[j - target_begin] += pot_temp_2;
+    }
+}
+
+
+void interact_block_scalar(const Geometry& geom, const double* __restrict potential_old,
+                           std::size_t num_vectors,
+                           std::size_t target_begin, std::size_t target_end,
+                           std::size_t source_begin, std::size_t source_end,
+                           double* __restrict pot_1, double* __restrict pot_2)
+{
+    double eps    = geom.eps;
+    double kappa  = geom.kappa;
+    double kappa2 = geom.kappa2;
+    std::size_t num_elements = geom.num_elements;
+    std::size_t num_targets  = target_end - target_begin;
+
+    for (std::size_t v_begin = 0; v_begin < num_vectors; v_begin += BLOCK_VECTORS) {
+        std::size_t v_count = std::min(BLOCK_VECTORS, num_vectors - v_begin);
+        const double* potential_old_v = potential_old + v_begin * 2 * num_elements;
+
+    for (std::size_t j = target_begin; j < target_end; ++j) {
+
+        double target_x = geom.x[j];
+        double target_y = geom.y[j];
+        double target_z = geom.z[j];
+
+        double target_nx = geom.nx[j];
+        double target_ny = geom.ny[j];
+        double target_nz = geom.nz[j];
+
+        double pot_temp_1[BLOCK_VECTORS] = {};
+        double pot_temp_2[BLOCK_VECTORS] = {};
+
+        for (std::size_t k = source_begin; k < source_end; ++k) {
+
+            double dist_x = geom.x[k] - target_x;
+            double dist_y = geom.y[k] - target_y;
+            double dist_z = geom.z[k] - target_z;
+            double r = std::sqrt(dist_x * dist_x + dist_y * dist_y + dist_z * dist_z);
+
+            if (r > 0) {
+                double source_nx = geom.nx[k];
+                double source_ny = geom.ny[k];
+                double source_nz = geom.nz[k];
+
+                double one_over_r = 1. / r;
+                double G0 = constants::ONE_OVER_4PI * one_over_r;
+                double kappa_r = kappa * r;
+                double exp_kappa_r = std::exp(-kappa_r);
+                double Gk = exp_kappa_r * G0;
+
+                double source_cos = (source_nx * dist_x + source_ny * dist_y + source_nz * dist_z) * one_over_r;
+                double target_cos = (target_nx * dist_x + target_ny * dist_y + target_nz * dist_z) * one_over_r;
+
+                double tp1 = G0 * one_over_r;
+                double tp2 = (1. + kappa_r) * exp_kappa_r;
+
+                double dot_tqsq = source_nx * target_nx + source_ny * target_ny + source_nz * target_nz;
+                double G3 = (dot_tqsq - 3. * target_cos * source_cos) * one_over_r * tp1;
+                double G4 = tp2 * G3 - kappa2 * target_cos * source_cos * Gk;
+
+                double area = geom.area[k];
+                double L1 = source_cos * tp1 * (1. - tp2 * eps) * area;
+                double L2 = (G0 - Gk) * area;
+                double L3 = (G4 - G3) * area;
+                double L4 = target_cos * tp1 * (1. - tp2 / eps) * area;
+
+                for (std::size_t v = 0; v < v_count; ++v) {
+                    double potential_old_0 = potential_old_v[v * 2 * num_elements + k];
+                    double potential_old_1 = potential_old_v[v * 2 * num_elements + k + num_elements];
+
+                    pot_temp_1[v] += L1 * potential_old_0 + L2 * potential_old_1;
+                    pot_temp_2[v] += L3 * potential_old_0 + L4 * potential_old_1;
+                }
+            }
+        }
+
+        for (std::size_t v = 0; v < v_count; ++v) {
+            pot_1[(v_begin + v) * num_targets + j - target_begin] += pot_temp_1[v];
+            pot_2[(v_begin + v) * num_targets + j - target_begin] += pot_temp_2[v];
+        }
+    }
+    }
+}
+
+
+#ifdef NEAR_FIELD_X86_DISPATCH
+
+/*************************************************************************/
+/********************************* AVX2 **********************************/
+/*************************************************************************/
+
+NEAR_FIELD_TARGET_AVX2
+static inline __m256d exp_avx2(__m256d x)
+{
+    x = _mm256_max_pd(x, _mm256_set1_pd(EXP_LOWER_BOUND));
+
+    __m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(LOG2E)),
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(LN2_HI), x);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(LN2_LO), r);
+
+    __m256d p = _mm256_set1_pd(EXP_COEFF[13]);
+    for (int i = 12; i >= 0; --i)
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_COEFF[i]));
+
+    /* 2^n: the low mantissa bits of n + 1.5*2^52 hold n as an integer */
+    const __m256d shifter = _mm256_set1_pd(6755399441055744.);
+    __m256i n_int = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(n, shifter)),
+                                     _mm256_castpd_si256(shifter));
+    __m256i scale = _mm256_slli_epi64(_mm256_add_epi64(n_int, _mm256_set1_epi64x(1023)), 52);
+
+    return _mm256_mul_pd(p, _mm256_castsi256_pd(scale));
+}
+
+
+NEAR_FIELD_TARGET_AVX2
+static inline double hsum_avx2(__m256d v)
+{
+    __m128d lo = _mm256_castpd256_pd128(v);
+    __m128d hi = _mm256_extractf128_pd(v, 1);
+    lo = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+
+template <int NT>
+NEAR_FIELD_TARGET_AVX2
+static void tile_avx2(const Geometry& geom, const double* __restrict potential_old,
+                      std::size_t target_begin, std::size_t source_begin, std::size_t source_end,
+                      double* __restrict pot_1, double* __restrict pot_2)
+{
+    __m256d t_x[NT], t_y[NT], t_z[NT], t_nx[NT], t_ny[NT], t_nz[NT];
+    __m256d acc_1[NT], acc_2[NT];
+
+    for (int t = 0; t < NT; ++t) {
+        t_x[t]  = _mm256_set1_pd(geom.x [target_begin + t]);
+        t_y[t]  = _mm256_set1_pd(geom.y [target_begin + t]);
+        t_z[t]  = _mm256_set1_pd(geom.z [target_begin + t]);
+        t_nx[t] = _mm256_set1_pd(geom.nx[target_begin + t]);
+        t_ny[t] = _mm256_set1_pd(geom.ny[target_begin + t]);
+        t_nz[t] = _mm256_set1_pd(geom.nz[target_begin + t]);
+        acc_1[t] = _mm256_setzero_pd();
+        acc_2[t] = _mm256_setzero_pd();
+    }
+
+    const __m256d one          = _mm256_set1_pd(1.);
+    const __m256d three        = _mm256_set1_pd(3.);
+    const __m256d zero         = _mm256_setzero_pd();
+    const __m256d one_over_4pi = _mm256_set1_pd(constants::ONE_OVER_4PI);
+    const __m256d eps          = _mm256_set1_pd(geom.eps);
+    const __m256d one_over_eps = _mm256_set1_pd(1. / geom.eps);
+    const __m256d kappa        = _mm256_set1_pd(geom.kappa);
+    const __m256d kappa2       = _mm256_set1_pd(geom.kappa2);
+
+    const double* potential_old_1 = potential_old + geom.num_elements;
+
+    for (std::size_t k = source_begin; k < source_end; k += 4) {
+
+        /* lanes past source_end load zeros and are masked out of the sums */
+        std::size_t remaining = source_end - k;
+        __m256i lanes = _mm256_cmpgt_epi64(_mm256_set1_epi64x(remaining > 4 ? 4 : (long long)remaining),
+                                           _mm256_set_epi64x(3, 2, 1, 0));
+
+        __m256d s_x    = _mm256_maskload_pd(geom.x    + k, lanes);
+        __m256d s_y    = _mm256_maskload_pd(geom.y    + k, lanes);
+        __m256d s_z    = _mm256_maskload_pd(geom.z    + k, lanes);
+        __m256d s_nx   = _mm256_maskload_pd(geom.nx   + k, lanes);
+        __m256d s_ny   = _mm256_maskload_pd(geom.ny   + k, lanes);
+        __m256d s_nz   = _mm256_maskload_pd(geom.nz   + k, lanes);
+        __m256d s_area = _mm256_maskload_pd(geom.area + k, lanes);
+        __m256d s_p0   = _mm256_mul_pd(_mm256_maskload_pd(potential_old   + k, lanes), s_area);
+        __m256d s_p1   = _mm256_mul_pd(_mm256_maskload_pd(potential_old_1 + k, lanes), s_area);
+
+        for (int t = 0; t < NT; ++t) {
+            __m256d dist_x = _mm256_sub_pd(s_x, t_x[t]);
+            __m256d dist_y = _mm256_sub_pd(s_y, t_y[t]);
+            __m256d dist_z = _mm256_sub_pd(s_z, t_z[t]);
+
+            __m256d r2 = _mm256_mul_pd(dist_x, dist_x);
+            r2 = _mm256_fmadd_pd(dist_y, dist_y, r2);
+            r2 = _mm256_fmadd_pd(dist_z, dist_z, r2);
+
+            /* r == 0 (self interaction) and padded lanes contribute nothing */
+            __m256d valid = _mm256_and_pd(_mm256_cmp_pd(r2, zero, _CMP_GT_OQ), _mm256_castsi256_pd(lanes));
+            r2 = _mm256_blendv_pd(one, r2, valid);
+
+            __m256d r          = _mm256_sqrt_pd(r2);
+            __m256d one_over_r = _mm256_div_pd(one, r);
+            __m256d G0         = _mm256_mul_pd(one_over_4pi, one_over_r);
+            __m256d kappa_r    = _mm256_mul_pd(kappa, r);
+            __m256d exp_kappa_r = exp_avx2(_mm256_sub_pd(zero, kappa_r));
+            __m256d Gk         = _mm256_mul_pd(exp_kappa_r, G0);
+
+            __m256d source_cos = _mm256_mul_pd(s_nx, dist_x);
+            source_cos = _mm256_fmadd_pd(s_ny, dist_y, source_cos);
+            source_cos = _mm256_mul_pd(_mm256_fmadd_pd(s_nz, dist_z, source_cos), one_over_r);
+
+            __m256d target_cos = _mm256_mul_pd(t_nx[t], dist_x);
+            target_cos = _mm256_fmadd_pd(t_ny[t], dist_y, target_cos);
+            target_cos = _mm256_mul_pd(_mm256_fmadd_pd(t_nz[t], dist_z, target_cos), one_over_r);
+
+            __m256d tp1 = _mm256_mul_pd(G0, one_over_r);
+            __m256d tp2 = _mm256_mul_pd(_mm256_add_pd(one, kappa_r), exp_kappa_r);
+
+            __m256d dot_tqsq = _mm256_mul_pd(s_nx, t_nx[t]);
+            dot_tqsq = _mm256_fmadd_pd(s_ny, t_ny[t], dot_tqsq);
+            dot_tqsq = _mm256_fmadd_pd(s_nz, t_nz[t], dot_tqsq);
+
+            __m256d cos_cos = _mm256_mul_pd(target_cos, source_cos);
+            __m256d G3 = _mm256_mul_pd(_mm256_fnmadd_pd(three, cos_cos, dot_tqsq),
+                                       _mm256_mul_pd(one_over_r, tp1));
+            __m256d G4 = _mm256_fnmadd_pd(_mm256_mul_pd(kappa2, cos_cos), Gk, _mm256_mul_pd(tp2, G3));
+
+            __m256d L1 = _mm256_mul_pd(_mm256_mul_pd(source_cos, tp1), _mm256_fnmadd_pd(tp2, eps, one));
+            __m256d L2 = _mm256_sub_pd(G0, Gk);
+            __m256d L3 = _mm256_sub_pd(G4, G3);
+            __m256d L4 = _mm256_mul_pd(_mm256_mul_pd(target_cos, tp1), _mm256_fnmadd_pd(tp2, one_over_eps, one));
+
+            __m256d contrib_1 = _mm256_fmadd_pd(L1, s_p0, _mm256_mul_pd(L2, s_p1));
+            __m256d contrib_2 = _mm256_fmadd_pd(L3, s_p0, _mm256_mul_pd(L4, s_p1));
+
+            acc_1[t] = _mm256_add_pd(acc_1[t], _mm256_and_pd(contrib_1, valid));
+            acc_2[t] = _mm256_add_pd(acc_2[t], _mm256_and_pd(contrib_2, valid));
+        }
+    }
+
+    for (int t = 0; t < NT; ++t) {
+        pot_1[t] += hsum_avx2(acc_1[t]);
+        pot_2[t] += hsum_avx2(acc_2[t]);
+    }
+}
+
+
+NEAR_FIELD_TARGET_AVX2
+static void interact_avx2(const Geometry& geom, const double* __restrict potential_old,
+                          std::size_t target_begin, std::size_t target_end,
+                          std::size_t source_begin, std::size_t source_end,
+                          double* __restrict pot_1, double* __restrict pot_2)
+{
+    std::size_t j = target_begin;
+
+    for (; j + TARGET_TILE <= target_end; j += TARGET_TILE)
+        tile_avx2<TARGET_TILE>(geom, potential_old, j, source_begin, source_end,
+                               pot_1 + (j - target_begin), pot_2 + (j - target_begin));
+
+    for (; j < target_end; ++j)
+        tile_avx2<1>(geom, potential_old, j, source_begin, source_end,
+                     pot_1 + (j - target_begin), pot_2 + (j - target_begin));
+}
+
+
+NEAR_FIELD_TARGET_AVX2
+static void interact_block_avx2(const Geometry& geom, const double* __restrict potential_old,
+                                std::size_t num_vectors,
+                                std::size_t target_begin, std::size_t target_end,
+                                std::size_t source_begin, std::size_t source_end,
+                                double* __restrict pot_1, double* __restrict pot_2)
+{
+    const __m256d one          = _mm256_set1_pd(1.);
+    const __m256d three        = _mm256_set1_pd(3.);
+    const __m256d zero         = _mm256_setzero_pd();
+    const __m256d one_over_4pi = _mm256_set1_pd(constants::ONE_OVER_4PI);
+    const __m256d eps          = _mm256_set1_pd(geom.eps);
+    const __m256d one_over_eps = _mm256_set1_pd(1. / geom.eps);
+    const __m256d kappa        = _mm256_set1_pd(geom.kappa);
+    const __m256d kappa2       = _mm256_set1_pd(geom.kappa2);
+
+    std::size_t num_elements = geom.num_elements;
+    std::size_t num_targets  = target_end - target_begin;
+
+    for (std::size_t v_begin = 0; v_begin < num_vectors; v_begin += BLOCK_VECTORS) {
+        std::size_t v_count = std::min(BLOCK_VECTORS, num_vectors - v_begin);
+        const double* potential_old_v = potential_old + v_begin * 2 * num_elements;
+
+    for (std::size_t j = target_begin; j < target_end; ++j) {
+
+        const __m256d t_x  = _mm256_set1_pd(geom.x [j]);
+        const __m256d t_y  = _mm256_set1_pd(geom.y [j]);
+        const __m256d t_z  = _mm256_set1_pd(geom.z [j]);
+        const __m256d t_nx = _mm256_set1_pd(geom.nx[j]);
+        const __m256d t_ny = _mm256_set1_pd(geom.ny[j]);
+        const __m256d t_nz = _mm256_set1_pd(geom.nz[j]);
+
+        __m256d acc_1[BLOCK_VECTORS], acc_2[BLOCK_VECTORS];
+        for (std::size_t v = 0; v < v_count; ++v) {
+            acc_1[v] = _mm256_setzero_pd();
+            acc_2[v] = _mm256_setzero_pd();
+        }
+
+        for (std::size_t k = source_begin; k < source_end; k += 4) {
+
+            /* lanes past source_end load zeros and are masked out of the sums */
+            std::size_t remaining = source_end - k;
+            __m256i lanes = _mm256_cmpgt_epi64(_mm256_set1_epi64x(remaining > 4 ? 4 : (long long)remaining),
+                                               _mm256_set_epi64x(3, 2, 1, 0));
+
+            __m256d s_x    = _mm256_maskload_pd(geom.x    + k, lanes);
+            __m256d s_y    = _mm256_maskload_pd(geom.y    + k, lanes);
+            __m256d s_z    = _mm256_maskload_pd(geom.z    + k, lanes);
+            __m256d s_nx   = _mm256_maskload_pd(geom.nx   + k, lanes);
+            __m256d s_ny   = _mm256_maskload_pd(geom.ny   + k, lanes);
+            __m256d s_nz   = _mm256_maskload_pd(geom.nz   + k, lanes);
+            __m256d s_area = _mm256_maskload_pd(geom.area + k, lanes);
+
+            __m256d dist_x = _mm256_sub_pd(s_x, t_x);
+            __m256d dist_y = _mm256_sub_pd(s_y, t_y);
+            __m256d dist_z = _mm256_sub_pd(s_z, t_z);
+
+            __m256d r2 = _mm256_mul_pd(dist_x, dist_x);
+            r2 = _mm256_fmadd_pd(dist_y, dist_y, r2);
+            r2 = _mm256_fmadd_pd(dist_z, dist_z, r2);
+
+            /* r == 0 (self interaction) and padded lanes contribute nothing */
+            __m256d valid = _mm256_and_pd(_mm256_cmp_pd(r2, zero, _CMP_GT_OQ), _mm256_castsi256_pd(lanes));
+            r2 = _mm256_blendv_pd(one, r2, valid);
+
+            __m256d r           = _mm256_sqrt_pd(r2);
+            __m256d one_over_r  = _mm256_div_pd(one, r);
+            __m256d G0          = _mm256_mul_pd(one_over_4pi, one_over_r);
+            __m256d kappa_r     = _mm256_mul_pd(kappa, r);
+            __m256d exp_kappa_r = exp_avx2(_mm256_sub_pd(zero, kappa_r));
+            __m256d Gk          = _mm256_mul_pd(exp_kappa_r, G0);
+
+            __m256d source_cos = _mm256_mul_pd(s_nx, dist_x);
+            source_cos = _mm256_fmadd_pd(s_ny, dist_y, source_cos);
+            source_cos = _mm256_mul_pd(_mm256_fmadd_pd(s_nz, dist_z, source_cos), one_over_r);
+
+            __m256d target_cos = _mm256_mul_pd(t_nx, dist_x);
+            target_cos = _mm256_fmadd_pd(t_ny, dist_y, target_cos);
+            target_cos = _mm256_mul_pd(_mm256_fmadd_pd(t_nz, dist_z, target_cos), one_over_r);
+
+            __m256d tp1 = _mm256_mul_pd(G0, one_over_r);
+            __m256d tp2 = _mm256_mul_pd(_mm256_add_pd(one, kappa_r), exp_kappa_r);
+
+            __m256d dot_tqsq = _mm256_mul_pd(s_nx, t_nx);
+            dot_tqsq = _mm256_fmadd_pd(s_ny, t_ny, dot_tqsq);
+            dot_tqsq = _mm256_fmadd_pd(s_nz, t_nz, dot_tqsq);
+
+            __m256d cos_cos = _mm256_mul_pd(target_cos, source_cos);
+            __m256d G3 = _mm256_mul_pd(_mm256_fnmadd_pd(three, cos_cos, dot_tqsq),
+                                       _mm256_mul_pd(one_over_r, tp1));
+            __m256d G4 = _mm256_fnmadd_pd(_mm256_mul_pd(kappa2, cos_cos), Gk, _mm256_mul_pd(tp2, G3));
+
+            /* the area and the validity mask are folded in once for all vectors */
+            __m256d area = _mm256_and_pd(s_area, valid);
+            __m256d L1 = _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(source_cos, tp1),
+                                                     _mm256_fnmadd_pd(tp2, eps, one)), area);
+            __m256d L2 = _mm256_mul_pd(_mm256_sub_pd(G0, Gk), area);
+            __m256d L3 = _mm256_mul_pd(_mm256_sub_pd(G4, G3), area);
+            __m256d L4 = _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(target_cos, tp1),
+                                                     _mm256_fnmadd_pd(tp2, one_over_eps, one)), area);
+
+            for (std::size_t v = 0; v < v_count; ++v) {
+                const double* potential_old_0 = potential_old_v + v * 2 * num_elements;
+                __m256d s_p0 = _mm256_maskload_pd(potential_old_0 + k,                lanes);
+                __m256d s_p1 = _mm256_maskload_pd(potential_old_0 + k + num_elements, lanes);
+
+                acc_1[v] = _mm256_fmadd_pd(L1, s_p0, _mm256_fmadd_pd(L2, s_p1, acc_1[v]));
+                acc_2[v] = _mm256_fmadd_pd(L3, s_p0, _mm256_fmadd_pd(L4, s_p1, acc_2[v]));
+            }
+        }
+
+        for (std::size_t v = 0; v < v_count; ++v) {
+            pot_1[(v_begin + v) * num_targets + j - target_begin] += hsum_avx2(acc_1[v]);
+            pot_2[(v_begin + v) * num_targets + j - target_begin] += hsum_avx2(acc_2[v]);
+        }
+    }
+    }
+}
+
+
+/*************************************************************************/
+/******************************** AVX-512 ********************************/
+/*************************************************************************/
+
+/* The unmasked forms of max, roundscale, scalef, sqrt and the extracts of
+ * the reduction are built on _mm512_undefined_pd in GCC's headers, which -Wall
+ * reports as maybe uninitialized. The zero-masked forms with every lane set
+ * compile to the same instructions without it. */
+static const __mmask8 ALL_LANES = 0xFF;
+
+NEAR_FIELD_TARGET_AVX512
+static inline __m512d exp_avx512(__m512d x)
+{
+    x = _mm512_maskz_max_pd(ALL_LANES, x, _mm512_set1_pd(EXP_LOWER_BOUND));
+
+    __m512d n = _mm512_maskz_roundscale_pd(ALL_LANES, _mm512_mul_pd(x, _mm512_set1_pd(LOG2E)),
+                                           _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512d r = _mm512_fnmadd_pd(n, _mm512_set1_pd(LN2_HI), x);
+    r = _mm512_fnmadd_pd(n, _mm512_set1_pd(LN2_LO), r);
+
+    __m512d p = _mm512_set1_pd(EXP_COEFF[13]);
+    for (int i = 12; i >= 0; --i)
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_COEFF[i]));
+
+    return _mm512_maskz_scalef_pd(ALL_LANES, p, n);
+}
+
+
+template <int NT>
+NEAR_FIELD_TARGET_AVX512
+static void tile_avx512(const Geometry& geom, const double* __restrict potential_old,
+                        std::size_t target_begin, std::size_t source_begin, std::size_t source_end,
+                        double* __restrict pot_1, double* __restrict pot_2)
+{
+    __m512d t_x[NT], t_y[NT], t_z[NT], t_nx[NT], t_ny[NT], t_nz[NT];
+    __m512d acc_1[NT], acc_2[NT];
+
+    for (int t = 0; t < NT; ++t) {
+        t_x[t]  = _mm512_set1_pd(geom.x [target_begin + t]);
+        t_y[t]  = _mm512_set1_pd(geom.y [target_begin + t]);
+        t_z[t]  = _mm512_set1_pd(geom.z [target_begin + t]);
+        t_nx[t] = _mm512_set1_pd(geom.nx[target_begin + t]);
+        t_ny[t] = _mm512_set1_pd(geom.ny[target_begin + t]);
+        t_nz[t] = _mm512_set1_pd(geom.nz[target_begin + t]);
+        acc_1[t] = _mm512_setzero_pd();
+        acc_2[t] = _mm512_setzero_pd();
+    }
+
+    const __m512d one          = _mm512_set1_pd(1.);
+    const __m512d three        = _mm512_set1_pd(3.);
+    const __m512d zero         = _mm512_setzero_pd();
+    const __m512d one_over_4pi = _mm512_set1_pd(constants::ONE_OVER_4PI);
+    const __m512d eps          = _mm512_set1_pd(geom.eps);
+    const __m512d one_over_eps = _mm512_set1_pd(1. / geom.eps);
+    const __m512d kappa        = _mm512_set1_pd(geom.kappa);
+    const __m512d kappa2       = _mm512_set1_pd(geom.kappa2);
+
+    const double* potential_old_1 = potential_old + geom.num_elements;
+
+    for (std::size_t k = source_begin; k < source_end; k += 8) {
+
+        std::size_t remaining = source_end - k;
+        __mmask8 lanes = remaining >= 8 ? (__mmask8)0xFF : (__mmask8)((1u << remaining) - 1u);
+
+        __m512d s_x    = _mm512_maskz_loadu_pd(lanes, geom.x    + k);
+        __m512d s_y    = _mm512_maskz_loadu_pd(lanes, geom.y    + k);
+        __m512d s_z    = _mm512_maskz_loadu_pd(lanes, geom.z    + k);
+        __m512d s_nx   = _mm512_maskz_loadu_pd(lanes, geom.nx   + k);
+        __m512d s_ny   = _mm512_maskz_loadu_pd(lanes, geom.ny   + k);
+        __m512d s_nz   = _mm512_maskz_loadu_pd(lanes, geom.nz   + k);
+        __m512d s_area = _mm512_maskz_loadu_pd(lanes, geom.area + k);
+        __m512d s_p0   = _mm512_mul_pd(_mm512_maskz_loadu_pd(lanes, potential_old   + k), s_area);
+        __m512d s_p1   = _mm512_mul_pd(_mm512_maskz_loadu_pd(lanes, potential_old_1 + k), s_area);
+
+        for (int t = 0; t < NT; ++t) {
+            __m512d dist_x = _mm512_sub_pd(s_x, t_x[t]);
+            __m512d dist_y = _mm512_sub_pd(s_y, t_y[t]);
+            __m512d dist_z = _mm512_sub_pd(s_z, t_z[t]);
+
+            __m512d r2 = _mm512_mul_pd(dist_x, dist_x);
+            r2 = _mm512_fmadd_pd(dist_y, dist_y, r2);
+            r2 = _mm512_fmadd_pd(dist_z, dist_z, r2);
+
+            __mmask8 valid = _mm512_mask_cmp_pd_mask(lanes, r2, zero, _CMP_GT_OQ);
+            r2 = _mm512_mask_blend_pd(valid, one, r2);
+
+            __m512d r          = _mm512_maskz_sqrt_pd(ALL_LANES, r2);
+            __m512d one_over_r = _mm512_div_pd(one, r);
+            __m512d G0         = _mm512_mul_pd(one_over_4pi, one_over_r);
+            __m512d kappa_r    = _mm512_mul_pd(kappa, r);
+            __m512d exp_kappa_r = exp_avx512(_mm512_sub_pd(zero, kappa_r));
+            __m512d Gk         = _mm512_mul_pd(exp_kappa_r, G0);
+
+            __m512d source_cos = _mm512_mul_pd(s_nx, dist_x);
+            source_cos = _mm512_fmadd_pd(s_ny, dist_y, source_cos);
+            source_cos = _mm512_mul_pd(_mm512_fmadd_pd(s_nz, dist_z, source_cos), one_over_r);
+
+            __m512d target_cos = _mm512_mul_pd(t_nx[t], dist_x);
+            target_cos = _mm512_fmadd_pd(t_ny[t], dist_y, target_cos);
+            target_cos = _mm512_mul_pd(_mm512_fmadd_pd(t_nz[t], dist_z, target_cos), one_over_r);
+
+            __m512d tp1 = _mm512_mul_pd(G0, one_over_r);
+            __m512d tp2 = _mm512_mul_pd(_mm512_add_pd(one, kappa_r), exp_kappa_r);
+
+            __m512d dot_tqsq = _mm512_mul_pd(s_nx, t_nx[t]);
+            dot_tqsq = _mm512_fmadd_pd(s_ny, t_ny[t], dot_tqsq);
+            dot_tqsq = _mm512_fmadd_pd(s_nz, t_nz[t], dot_tqsq);
+
+            __m512d cos_cos = _mm512_mul_pd(target_cos, source_cos);
+            __m512d G3 = _mm512_mul_pd(_mm512_fnmadd_pd(three, cos_cos, dot_tqsq),
+                                       _mm512_mul_pd(one_over_r, tp1));
+            __m512d G4 = _mm512_fnmadd_pd(_mm512_mul_pd(kappa2, cos_cos), Gk, _mm512_mul_pd(tp2, G3));
+
+            __m512d L1 = _mm512_mul_pd(_mm512_mul_pd(source_cos, tp1), _mm512_fnmadd_pd(tp2, eps, one));
+            __m512d L2 = _mm512_sub_pd(G0, Gk);
+            __m512d L3 = _mm512_sub_pd(G4, G3);
+            __m512d L4 = _mm512_mul_pd(_mm512_mul_pd(target_cos, tp1), _mm512_fnmadd_pd(tp2, one_over_eps, one));
+
+            __m512d contrib_1 = _mm512_fmadd_pd(L1, s_p0, _mm512_mul_pd(L2, s_p1));
+            __m512d contrib_2 = _mm512_fmadd_pd(L3, s_p0, _mm512_mul_pd(L4, s_p1));
+
+            acc_1[t] = _mm512_mask_add_pd(acc_1[t], valid, acc_1[t], contrib_1);
+            acc_2[t] = _mm512_mask_add_pd(acc_2[t], valid, acc_2[t], contrib_2);
+        }
+    }
+
+    alignas(64) double lanes_1[8], lanes_2[8];
+    for (int t = 0; t < NT; ++t) {
+        _mm512_store_pd(lanes_1, acc_1[t]);
+        _mm512_store_pd(lanes_2, acc_2[t]);
+        for (int l = 0; l < 8; ++l) {
+            pot_1[t] += lanes_1[l];
+            pot_2[t] += lanes_2[l];
+        }
+    }
+}
+
+
+NEAR_FIELD_TARGET_AVX512
+static void interact_avx512(const Geometry& geom, const double* __restrict potential_old,
+                            std::size_t target_begin, std::size_t target_end,
+                            std::size_t source_begin, std::size_t source_end,
+                            double* __restrict pot_1, double* __restrict pot_2)
+{
+    std::size_t j = target_begin;
+
+    for (; j + TARGET_TILE <= target_end; j += TARGET_TILE)
+        tile_avx512<TARGET_TILE>(geom, potential_old, j, source_begin, source_end,
+                                 pot_1 + (j - target_begin), pot_2 + (j - target_begin));
+
+    for (; j < target_end; ++j)
+        tile_avx512<1>(geom, potential_old, j, source_begin, source_end,
+                       pot_1 + (j - target_begin), pot_2 + (j - target_begin));
+}
+
+#endif /* NEAR_FIELD_X86_DISPATCH */
+
+
+Isa detect_isa()
+{
+#ifdef NEAR_FIELD_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return Isa::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return Isa::AVX2;
+#endif
+    return Isa::SCALAR;
+}
+
+
+Kernel select_kernel(Isa isa)
+{
+#ifdef NEAR_FIELD_X86_DISPATCH
+    if (isa == Isa::AVX512) return interact_avx512;
+    if (isa == Isa::AVX2)   return interact_avx2;
+#endif
+    return interact_scalar;
+}
+
+
+BlockKernel select_block_kernel(Isa isa)
+{
+#ifdef NEAR_FIELD_X86_DISPATCH
+    if (isa == Isa::AVX512 || isa == Isa::AVX2) return interact_block_avx2;
+#endif
+    return interact_block_scalar;
+}
+
+
+const char* isa_name(Isa isa)
+{
+    switch (isa) {
+        case Isa::AVX512: return "avx512";
+        case Isa::AVX2:   return "avx2";
+        default:          return "scalar";
+    }
+}
+
+}
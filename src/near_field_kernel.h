@@ -0,0 +1,61 @@
+#ifndef H_TABIPB_NEAR_FIELD_KERNEL_H
+#define H_TABIPB_NEAR_FIELD_KERNEL_H
+
+#include <cstddef>
+
+namespace near_field {
+
+    /* element geometry and physical constants seen by the PP kernel */
+    struct Geometry {
+        const double* __restrict x;
+        const double* __restrict y;
+        const double* __restrict z;
+        const double* __restrict nx;
+        const double* __restrict ny;
+        const double* __restrict nz;
+        const double* __restrict area;
+        std::size_t num_elements;
+
+        double eps;
+        double kappa;
+        double kappa2;
+    };
+
+    /* Accumulates the direct interactions of the sources [source_begin, source_end)
+     * on the targets [target_begin, target_end) into pot_1 and pot_2, which are
+     * indexed relative to target_begin and must be zeroed by the caller. */
+    using Kernel = void (*)(const Geometry& geom, const double* __restrict potential_old,
+                            std::size_t target_begin, std::size_t target_end,
+                            std::size_t source_begin, std::size_t source_end,
+                            double* __restrict pot_1, double* __restrict pot_2);
+
+    /* As Kernel, for num_vectors potentials at once: vector v of potential_old starts
+     * at v * 2 * num_elements, and of pot_1 and pot_2 at v * (target_end - target_begin).
+     * The geometry of each pair is evaluated once and applied to every vector. */
+    using BlockKernel = void (*)(const Geometry& geom, const double* __restrict potential_old,
+                                 std::size_t num_vectors,
+                                 std::size_t target_begin, std::size_t target_end,
+                                 std::size_t source_begin, std::size_t source_end,
+                                 double* __restrict pot_1, double* __restrict pot_2);
+
+    enum class Isa { SCALAR, AVX2, AVX512 };
+
+    /* widest variant supported by both the build and the running CPU */
+    Isa detect_isa();
+    Kernel select_kernel(Isa isa);
+    BlockKernel select_block_kernel(Isa isa);
+    const char* isa_name(Isa isa);
+
+    void interact_scalar(const Geometry& geom, const double* __restrict potential_old,
+                         std::size_t target_begin, std::size_t target_end,
+                         std::size_t source_begin, std::size_t source_end,
+                         double* __restrict pot_1, double* __restrict pot_2);
+
+    void interact_block_scalar(const Geometry& geom, const double* __restrict potential_old,
+                               std::size_t num_vectors,
+                               std::size_t target_begin, std::size_t target_end,
+                               std::size_t source_begin, std::size_t source_end,
+                               double* __restrict pot_1, double* __restrict pot_2);
+}
+
+#endif /* H_TABIPB_NEAR_FIELD_KERNEL_H */
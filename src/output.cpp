@@ -1,13 +1,19 @@
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
 
 #ifdef PLY_ENABLED
 #include <tinyply.h>
 #endif
 
+#include "console.h"
 #include "tabipb_timers.h"
 #include "coulombic_energy_compute.h"
 #include "solvation_energy_compute.h"
@@ -20,6 +26,7 @@ Output::Output(class Molecule& mol, class Elements& elem, const struct Params& p
 {
     timers_.ctor.start();
     potential_.assign(2 * elements_.num(), 0.);
+    mixed_precision_deviation_ = 0.;
     timers_.ctor.stop();
 }
 
@@ -184,6 +191,15 @@ void Output::compute_solvation_energy(const class InterpolationPoints& elem_inte
                                                   
     solvation_energy_ = solvation_energy.compute();
     
+    if (!mixed_precision_correction_.empty()) {
+        class SolvationEnergyCompute correction_energy(mixed_precision_correction_,
+                                                  elements_, elem_interp_pts, elem_tree,
+                                                  molecule_, mol_interp_pts, mol_tree,
+                                                  interaction_list, params_.phys_eps_, params_.phys_kappa_);
+        
+        mixed_precision_deviation_ = -correction_energy.compute();
+    }
+    
 #ifdef OPENACC_ENABLED
     #pragma acc exit data delete(potential_ptr[0:potential_num])
 #endif
@@ -194,14 +210,28 @@ void Output::compute_solvation_energy(const class InterpolationPoints& elem_inte
 
 
 
+void Output::store_charge_set_energies(std::size_t set_idx, std::size_t num_sets)
+{
+    charge_set_solvation_energy_.resize(num_sets, 0.);
+    charge_set_coulombic_energy_.resize(num_sets, 0.);
+    
+    charge_set_solvation_energy_[set_idx] = solvation_energy_;
+    charge_set_coulombic_energy_[set_idx] = coulombic_energy_;
+}
+
+
 void Output::finalize()
 {
     timers_.finalize.start();
 
     solvation_energy_ = constants::UNITS_PARA  * solvation_energy_;
+    mixed_precision_deviation_ = constants::UNITS_PARA * mixed_precision_deviation_;
     coulombic_energy_ = constants::UNITS_COEFF * coulombic_energy_;
     free_energy_      = solvation_energy_ + coulombic_energy_;
     
+    for (auto& energy : charge_set_solvation_energy_) energy *= constants::UNITS_PARA;
+    for (auto& energy : charge_set_coulombic_energy_) energy *= constants::UNITS_COEFF;
+    
     constexpr double pot_scaling = constants::UNITS_COEFF * constants::PI * 4.;
     std::transform(std::begin(potential_), std::end(potential_),
                    std::begin(potential_), [=](double x){ return x * pot_scaling; });
@@ -227,21 +257,45 @@ void Output::finalize()
 
 void Output::files(const struct Timers& timers) const
 {
-    std::cout << std::fixed << std::setprecision(6);
-    std::cout << "\n\n*** OUTPUT FOR TABI-PB RUN ***";
-    std::cout << "\n\n    Solvation energy = " << solvation_energy_
+    console::out() << std::fixed << std::setprecision(6);
+    console::out() << "\n\n*** OUTPUT FOR TABI-PB RUN ***";
+    console::out() << "\n\n    Solvation energy = " << solvation_energy_
                                                << " kJ/mol";
-    std::cout << "\n         Free energy = "   << free_energy_
+    console::out() << "\n         Free energy = "   << free_energy_
                                                << " kJ/mol";
-    std::cout << "\n\nThe max and min potential and normal derivatives on vertices:";
-    std::cout << "\n        Potential min: " << pot_min_ << ", "
+    if (!mixed_precision_correction_.empty())
+        console::out() << "\n\nEstimated mixed precision solvation energy deviation = "
+                  << std::scientific << std::setprecision(3) << mixed_precision_deviation_
+                  << std::fixed << std::setprecision(6) << " kJ/mol";
+    console::out() << "\n\nThe max and min potential and normal derivatives on vertices:";
+    console::out() << "\n        Potential min: " << pot_min_ << ", "
                                      "max: " << pot_max_;
-    std::cout << "\nNormal derivative min: " << pot_normal_min_ << ", "
+    console::out() << "\nNormal derivative min: " << pot_normal_min_ << ", "
                                      "max: " << pot_normal_max_ << "\n" << std::endl << std::endl;
     
+    if (!charge_set_solvation_energy_.empty()) {
+        console::out() << "Charge set energies (kJ/mol):\n"
+                  << "    set       solvation       coulombic            free\n";
+        for (std::size_t i = 0; i < charge_set_solvation_energy_.size(); ++i)
+            console::out() << std::setw(7)  << i
+                      << std::setw(16) << charge_set_solvation_energy_[i]
+                      << std::setw(16) << charge_set_coulombic_energy_[i]
+                      << std::setw(16) << charge_set_solvation_energy_[i] + charge_set_coulombic_energy_[i]
+                      << "\n";
+        console::out() << std::endl;
+    }
+    
     if (params_.output_vtk_) Output::output_VTK();
     if (params_.output_ply_) Output::output_PLY();
+    if (params_.output_vtu_) Output::output_VTU();
+    if (params_.output_raw_) Output::output_raw();
     if (params_.output_timers_) timers.print();
+    
+    if (params_.output_timers_json_) {
+        std::ofstream json_file(params_.output_prefix_ + "_timers.json");
+        json_file << timers.get_json();
+        json_file.close();
+    }
 
     if (params_.output_csv_headers_) {
         std::ofstream csv_headers("headers.csv");
@@ -368,22 +422,236 @@ void Output::output_VTK() const
 }
 
 
+namespace {
+
+    /* Binary file written in large blocks: contiguous arrays go straight to the
+     * file, values that are converted or interleaved are gathered in a buffer. */
+    class BlockWriter
+    {
+    private:
+        std::ofstream file_;
+        std::vector<char> buffer_;
+        std::size_t used_ = 0;
+        
+    public:
+        explicit BlockWriter(const std::string& name)
+            : file_(name, std::ios::out | std::ios::binary), buffer_(1 << 20)
+        {
+            if (!file_.good()) throw std::runtime_error("failed to open " + name);
+        }
+        
+        template <typename T>
+        void put(T value)
+        {
+            if (used_ + sizeof(T) > buffer_.size()) flush();
+            std::memcpy(buffer_.data() + used_, &value, sizeof(T));
+            used_ += sizeof(T);
+        }
+        
+        void write(const void* data, std::size_t size)
+        {
+            flush();
+            file_.write(static_cast<const char*>(data), size);
+        }
+        
+        void write(const std::string& text) { write(text.data(), text.size()); }
+        
+        void flush()
+        {
+            file_.write(buffer_.data(), used_);
+            used_ = 0;
+        }
+        
+        void close(const std::string& name)
+        {
+            flush();
+            file_.close();
+            if (file_.fail()) throw std::runtime_error("failed to write " + name);
+        }
+    };
+    
+    
+    /* num values of each component, interleaved, in double or single precision */
+    void write_values(BlockWriter& writer, std::initializer_list<const double*> components,
+                      std::size_t num, bool float32)
+    {
+        if (!float32 && components.size() == 1) {
+            writer.write(*components.begin(), num * sizeof(double));
+            return;
+        }
+        
+        for (std::size_t i = 0; i < num; ++i) {
+            for (const double* component : components) {
+                if (float32) writer.put(static_cast<float>(component[i]));
+                else         writer.put(component[i]);
+            }
+        }
+    }
+    
+    
+    bool little_endian()
+    {
+        const uint16_t one = 1;
+        unsigned char first_byte;
+        std::memcpy(&first_byte, &one, 1);
+        return first_byte == 1;
+    }
+}
+
+
+void Output::output_VTU() const
+{
+    timers_.output_binary.start();
+    
+    const std::size_t num = elements_.num();
+    const std::size_t num_faces = elements_.num_faces();
+    const bool float32 = params_.output_float32_;
+    const std::string real_type = float32 ? "Float32" : "Float64";
+    const std::size_t real_size = float32 ? sizeof(float) : sizeof(double);
+    
+    // every appended array is preceded by its size in bytes
+    struct Array { std::string attributes; uint64_t size; };
+    const Array arrays[] = {
+        {"type=\"" + real_type + "\" Name=\"Potential\"",                            num * real_size},
+        {"type=\"" + real_type + "\" Name=\"NormalPotential\"",                      num * real_size},
+        {"type=\"" + real_type + "\" Name=\"Normals\" NumberOfComponents=\"3\"",     3 * num * real_size},
+        {"type=\"" + real_type + "\" Name=\"Points\" NumberOfComponents=\"3\"",      3 * num * real_size},
+        {"type=\"UInt32\" Name=\"connectivity\"",                                    3 * num_faces * sizeof(uint32_t)},
+        {"type=\"UInt64\" Name=\"offsets\"",                                         num_faces * sizeof(uint64_t)},
+        {"type=\"UInt8\" Name=\"types\"",                                            num_faces * sizeof(uint8_t)},
+    };
+    
+    std::string data_arrays[7];
+    uint64_t offset = 0;
+    for (int i = 0; i < 7; ++i) {
+        data_arrays[i] = "<DataArray " + arrays[i].attributes
+                       + " format=\"appended\" offset=\"" + std::to_string(offset) + "\"/>\n";
+        offset += sizeof(uint64_t) + arrays[i].size;
+    }
+    
+    std::string header;
+    header.append("<?xml version=\"1.0\"?>\n")
+          .append("<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"")
+          .append(little_endian() ? "LittleEndian" : "BigEndian")
+          .append("\" header_type=\"UInt64\">\n")
+          .append("<UnstructuredGrid>\n")
+          .append("<Piece NumberOfPoints=\"").append(std::to_string(num))
+          .append("\" NumberOfCells=\"").append(std::to_string(num_faces)).append("\">\n")
+          .append("<PointData Scalars=\"Potential\" Normals=\"Normals\">\n")
+          .append(data_arrays[0]).append(data_arrays[1]).append(data_arrays[2])
+          .append("</PointData>\n")
+          .append("<Points>\n").append(data_arrays[3]).append("</Points>\n")
+          .append("<Cells>\n").append(data_arrays[4]).append(data_arrays[5]).append(data_arrays[6])
+          .append("</Cells>\n")
+          .append("</Piece>\n")
+          .append("</UnstructuredGrid>\n")
+          .append("<AppendedData encoding=\"raw\">\n_");
+    
+    const std::string file_name = params_.output_prefix_ + ".vtu";
+    BlockWriter writer(file_name);
+    writer.write(header);
+    
+    // These are in KCAL, as in the VTK file
+    writer.put(arrays[0].size);
+    write_values(writer, {potential_.data()}, num, float32);
+    writer.put(arrays[1].size);
+    write_values(writer, {potential_.data() + potential_offset_}, num, float32);
+    writer.put(arrays[2].size);
+    write_values(writer, {elements_.nx_ptr(), elements_.ny_ptr(), elements_.nz_ptr()}, num, float32);
+    writer.put(arrays[3].size);
+    write_values(writer, {elements_.x_ptr(), elements_.y_ptr(), elements_.z_ptr()}, num, float32);
+    
+    writer.put(arrays[4].size);
+    for (std::size_t i = 0; i < num_faces; ++i) {
+        writer.put<uint32_t>(elements_.face_x_ptr()[i] - 1);
+        writer.put<uint32_t>(elements_.face_y_ptr()[i] - 1);
+        writer.put<uint32_t>(elements_.face_z_ptr()[i] - 1);
+    }
+    writer.put(arrays[5].size);
+    for (std::size_t i = 0; i < num_faces; ++i)
+        writer.put<uint64_t>(3 * (i + 1));
+    writer.put(arrays[6].size);
+    for (std::size_t i = 0; i < num_faces; ++i)
+        writer.put<uint8_t>(5);  // VTK_TRIANGLE
+    
+    writer.write(std::string("\n</AppendedData>\n</VTKFile>\n"));
+    writer.close(file_name);
+    
+    timers_.output_binary.stop();
+}
+
+
+void Output::output_raw() const
+{
+    timers_.output_binary.start();
+    
+    const std::size_t num = elements_.num();
+    const std::size_t num_faces = elements_.num_faces();
+    const bool float32 = params_.output_float32_;
+    const std::size_t real_size = float32 ? sizeof(float) : sizeof(double);
+    
+    const std::string raw_name = params_.output_prefix_ + ".raw";
+    BlockWriter writer(raw_name);
+    
+    const char* names[] = {"x", "y", "z", "nx", "ny", "nz", "potential", "normal_potential"};
+    const double* values[] = {elements_.x_ptr(),  elements_.y_ptr(),  elements_.z_ptr(),
+                              elements_.nx_ptr(), elements_.ny_ptr(), elements_.nz_ptr(),
+                              potential_.data(),  potential_.data() + potential_offset_};
+    
+    std::string arrays;
+    uint64_t offset = 0;
+    for (int i = 0; i < 8; ++i) {
+        write_values(writer, {values[i]}, num, float32);
+        arrays.append("    {\"name\": \"").append(names[i])
+              .append("\", \"type\": \"").append(float32 ? "float32" : "float64")
+              .append("\", \"shape\": [").append(std::to_string(num))
+              .append("], \"offset\": ").append(std::to_string(offset)).append("},\n");
+        offset += num * real_size;
+    }
+    
+    for (std::size_t i = 0; i < num_faces; ++i) {
+        writer.put<uint32_t>(elements_.face_x_ptr()[i] - 1);
+        writer.put<uint32_t>(elements_.face_y_ptr()[i] - 1);
+        writer.put<uint32_t>(elements_.face_z_ptr()[i] - 1);
+    }
+    arrays.append("    {\"name\": \"faces\", \"type\": \"uint32\", \"shape\": [")
+          .append(std::to_string(num_faces)).append(", 3], \"offset\": ")
+          .append(std::to_string(offset)).append("}\n");
+    
+    writer.close(raw_name);
+    
+    // faces index the vertices from 0; potentials are in kcal/mol/e, as in the VTK file
+    std::ofstream json_file(params_.output_prefix_ + ".json");
+    json_file << "{\n"
+              << "  \"data\": \"" << raw_name.substr(raw_name.find_last_of("/\\") + 1) << "\",\n"
+              << "  \"byte_order\": \"" << (little_endian() ? "little" : "big") << "\",\n"
+              << "  \"num_vertices\": " << num << ",\n"
+              << "  \"num_faces\": " << num_faces << ",\n"
+              << "  \"arrays\": [\n" << arrays << "  ]\n"
+              << "}\n";
+    json_file.close();
+    
+    timers_.output_binary.stop();
+}
+
 void Timers_Output::print() const
 {
-    std::cout.setf(std::ios::fixed, std::ios::floatfield);
-    std::cout.precision(5);
-    std::cout << "|...Output function times (s)......" << std::endl;
-    std::cout << "|   |...ctor.......................: ";
-    std::cout << std::setw(12) << std::right << ctor.elapsed_time() << std::endl;
-    std::cout << "|   |...compute_coulombic_energy...: ";
-    std::cout << std::setw(12) << std::right << compute_coulombic_energy.elapsed_time() << std::endl;
-    std::cout << "|   |...compute_solvation_energy...: ";
-    std::cout << std::setw(12) << std::right << compute_solvation_energy.elapsed_time() << std::endl;
-    std::cout << "|   |...finalize...................: ";
-    std::cout << std::setw(12) << std::right << finalize.elapsed_time() << std::endl;
-    std::cout << "|       |...output_VTK.............: ";
-    std::cout << std::setw(12) << std::right << output_VTK.elapsed_time() << std::endl;
-    std::cout << "|" << std::endl;
+    console::out().setf(std::ios::fixed, std::ios::floatfield);
+    console::out().precision(5);
+    console::out() << "|...Output function times (s)......" << std::endl;
+    console::out() << "|   |...ctor.......................: ";
+    console::out() << std::setw(12) << std::right << ctor.elapsed_time() << std::endl;
+    console::out() << "|   |...compute_coulombic_energy...: ";
+    console::out() << std::setw(12) << std::right << compute_coulombic_energy.elapsed_time() << std::endl;
+    console::out() << "|   |...compute_solvation_energy...: ";
+    console::out() << std::setw(12) << std::right << compute_solvation_energy.elapsed_time() << std::endl;
+    console::out() << "|   |...finalize...................: ";
+    console::out() << std::setw(12) << std::right << finalize.elapsed_time() << std::endl;
+    console::out() << "|       |...output_VTK.............: ";
+    console::out() << std::setw(12) << std::right << output_VTK.elapsed_time() << std::endl;
+    console::out() << "|       |...output_binary..........: ";
+    console::out() << std::setw(12) << std::right << output_binary.elapsed_time() << std::endl;
+    console::out() << "|" << std::endl;
 }
 
 
@@ -395,6 +663,7 @@ std::string Timers_Output::get_durations() const
     durations.append(std::to_string(compute_solvation_energy .elapsed_time())).append(", ");
     durations.append(std::to_string(finalize                 .elapsed_time())).append(", ");
     durations.append(std::to_string(output_VTK               .elapsed_time())).append(", ");
+    durations.append(std::to_string(output_binary            .elapsed_time())).append(", ");
     return durations;
 }
 
@@ -407,6 +676,7 @@ std::string Timers_Output::get_headers() const
     headers.append("Output compute_solvation_energy, ");
     headers.append("Output finalize, ");
     headers.append("Output output_VTK, ");
+    headers.append("Output output_binary, ");
     
     return headers;
 }
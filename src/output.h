@@ -30,6 +30,10 @@ private:
     const std::size_t potential_offset_;
     std::vector<double> potential_;
     
+    /* estimated change in the solution from a double precision far field */
+    std::vector<double> mixed_precision_correction_;
+    double mixed_precision_deviation_;
+    
     double solvation_energy_;
     double free_energy_;
     double coulombic_energy_;
@@ -39,6 +43,10 @@ private:
     double pot_normal_min_;
     double pot_normal_max_;
     
+    /* energies of each charge set of a multiple right-hand side run */
+    std::vector<double> charge_set_solvation_energy_;
+    std::vector<double> charge_set_coulombic_energy_;
+    
 
 public:
 
@@ -48,8 +56,15 @@ public:
     std::vector<double>& potential() { return potential_; };
     std::size_t potential_offset() { return potential_offset_; };
     
+    double solvation_energy() const { return solvation_energy_; };
+    double coulombic_energy() const { return coulombic_energy_; };
+    double free_energy()      const { return free_energy_; };
+    
     void set_num_iter(long int num_iter) { num_iter_ = num_iter; }
     void set_residual(double residual) { residual_ = residual; }
+    void set_mixed_precision_correction(const std::vector<double>& correction) {
+        mixed_precision_correction_ = correction;
+    }
     
     void compute_solvation_energy();
     void compute_solvation_energy(const class InterpolationPoints& elem_interp_pts, const class Tree& elem_tree,
@@ -62,10 +77,18 @@ public:
     
     void compute_free_energy();
     
+    /* records the energies just computed as those of charge set set_idx */
+    void store_charge_set_energies(std::size_t set_idx, std::size_t num_sets);
+    
     void finalize();
     void files(const struct Timers&) const;
     void output_VTK() const;
     void output_PLY() const;
+    
+    /* binary surface data: VTK XML unstructured grid with appended raw arrays,
+     * and headerless arrays described by a JSON file */
+    void output_VTU() const;
+    void output_raw() const;
 };
 
 
@@ -75,6 +98,7 @@ struct Timers_Output
     Timer compute_solvation_energy;
     Timer compute_coulombic_energy;
     Timer output_VTK;
+    Timer output_binary;
     Timer finalize;
     
     void print() const;
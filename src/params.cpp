@@ -5,30 +5,38 @@
 #include <iostream>
 #include <iterator>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "console.h"
 #include "constants.h"
 #include "params.h"
 
-Params::Params(char *infile) {
-  std::ifstream paramfile(infile, std::ifstream::in);
-  if (!paramfile.good()) {
-    std::cout << "param file is not readable. exiting. " << std::endl;
-    std::exit(1);
-  }
-
+Params::Params() {
   output_vtk_ = false;
   output_ply_ = false;
+  output_vtu_ = false;
+  output_raw_ = false;
+  output_float32_ = false;
   output_csv_ = false;
   output_csv_headers_ = false;
   output_timers_ = false;
+  output_timers_json_ = false;
   precondition_ = false;
+  nonpolar_ = false;
   output_prefix_ = "output";
   input_mesh_prefix_ = "";
 
   mesh_ = Params::Mesh::SES;
   mesh_format_ = Params::MeshFormat::MSMS;
+}
+
+Params::Params(const char *infile) : Params() {
+  std::ifstream paramfile(infile, std::ifstream::in);
+  if (!paramfile.good()) {
+    throw std::runtime_error("param file is not readable");
+  }
 
   std::string line;
 
@@ -39,6 +47,9 @@ Params::Params(char *infile) {
         std::istream_iterator<std::string>{iss},
         std::istream_iterator<std::string>{}};
 
+    if (tokenized_line.size() < 2)
+      continue;
+
     std::string param_token = tokenized_line[0];
     std::string param_value = tokenized_line[1];
 
@@ -49,10 +60,18 @@ Params::Params(char *infile) {
                    [=](unsigned char c) { return std::tolower(c); });
 
     if (param_token == "mol" || param_token == "pqr") {
-      pqr_file_.open(tokenized_line[1], std::ifstream::in);
-      if (!pqr_file_.good()) {
-        std::cout << "pqr file is not readable. exiting. " << std::endl;
-        std::exit(1);
+      pqr_file_name_ = tokenized_line[1];
+      if (!std::ifstream(pqr_file_name_).good()) {
+        throw std::runtime_error("pqr file is not readable");
+      }
+
+    } else if (param_token == "charge_set") {
+      charge_set_files_.push_back(tokenized_line[1]);
+
+    } else if (param_token == "charge_set_block_size") {
+      charge_set_block_size_ = std::stoi(param_value);
+      if (charge_set_block_size_ <= 0) {
+        throw std::runtime_error("invalid charge_set_block_size value");
       }
 
     } else if (param_token == "pdie") {
@@ -70,73 +89,132 @@ Params::Params(char *infile) {
     } else if (param_token == "tree_degree") {
       tree_degree_ = std::stoi(param_value);
       if (tree_degree_ <= 0) {
-        std::cout << "invalid tree_degree value. exiting. " << std::endl;
-        std::exit(1);
+        throw std::runtime_error("invalid tree_degree value");
       }
 
     } else if (param_token == "tree_theta") {
       tree_theta_ = std::stod(param_value);
       if (tree_theta_ < 0. || tree_theta_ > 1.) {
-        std::cout << "invalid tree_theta value. exiting. " << std::endl;
-        std::exit(1);
+        throw std::runtime_error("invalid tree_theta value");
       }
 
     } else if (param_token == "tree_max_per_leaf") {
       tree_max_per_leaf_ = std::stoi(param_value);
       if (tree_max_per_leaf_ <= 0) {
-        std::cout << "invalid tree_max_per_leaf value. exiting. " << std::endl;
-        std::exit(1);
+        throw std::runtime_error("invalid tree_max_per_leaf value");
+      }
+
+    } else if (param_token == "autotune") {
+      autotune_error_ = std::stod(param_value);
+      if (autotune_error_ < 0. || autotune_error_ >= 1.) {
+        throw std::runtime_error("invalid autotune value");
+      }
+
+    } else if (param_token == "autotune_cache") {
+      autotune_cache_file_ = tokenized_line[1];
+
+    } else if (param_token == "interp_cache_budget") {
+      interp_cache_budget_ = std::stod(param_value);
+      if (interp_cache_budget_ < 0.) {
+        throw std::runtime_error("invalid interp_cache_budget value");
       }
 
     } else if (param_token == "gmres_restart") {
       gmres_restart_ = std::stoi(param_value);
       if (gmres_restart_ <= 0) {
-        std::cout << "invalid GMRES restart value. exiting. " << std::endl;
-        std::exit(1);
+        throw std::runtime_error("invalid GMRES restart value");
       }
 
     } else if (param_token == "gmres_residual") {
       gmres_residual_ = std::stod(param_value);
       if (gmres_residual_ < 0. || gmres_residual_ > 1.) {
-        std::cout << "invalid gmres_residual value. exiting. " << std::endl;
-        std::exit(1);
+        throw std::runtime_error("invalid gmres_residual value");
       }
 
     } else if (param_token == "gmres_num_iter") {
       gmres_num_iter_ = std::stoi(param_value);
       if (gmres_num_iter_ <= 0) {
-        std::cout << "invalid gmres_num_iter value. exiting. " << std::endl;
-        std::exit(1);
+        throw std::runtime_error("invalid gmres_num_iter value");
+      }
+
+    } else if (param_token == "solver") {
+      auto it = solver_table_.find(param_value);
+      if (it == solver_table_.end()) {
+        throw std::runtime_error("invalid solver value");
+      }
+      solver_ = it->second;
+
+    } else if (param_token == "fgmres_inner_degree") {
+      fgmres_inner_degree_ = std::stoi(param_value);
+      if (fgmres_inner_degree_ < 0) {
+        throw std::runtime_error("invalid fgmres_inner_degree value");
+      }
+
+    } else if (param_token == "fgmres_inner_theta") {
+      fgmres_inner_theta_ = std::stod(param_value);
+      if (fgmres_inner_theta_ < 0. || fgmres_inner_theta_ > 1.) {
+        throw std::runtime_error("invalid fgmres_inner_theta value");
+      }
+
+    } else if (param_token == "fgmres_inner_num_iter") {
+      fgmres_inner_num_iter_ = std::stoi(param_value);
+      if (fgmres_inner_num_iter_ <= 0) {
+        throw std::runtime_error("invalid fgmres_inner_num_iter value");
+      }
+
+    } else if (param_token == "fgmres_inner_residual") {
+      fgmres_inner_residual_ = std::stod(param_value);
+      if (fgmres_inner_residual_ < 0. || fgmres_inner_residual_ > 1.) {
+        throw std::runtime_error("invalid fgmres_inner_residual value");
       }
 
     } else if (param_token == "mesh") {
       auto it = mesh_table_.find(param_value);
       if (it == mesh_table_.end()) {
-        std::cout << "invalid mesh value. exiting. " << std::endl;
-        std::exit(1);
+        throw std::runtime_error("invalid mesh value");
       }
       mesh_ = it->second;
 
     } else if (param_token == "mesh_format") {
       auto it = mesh_format_table_.find(param_value);
       if (it == mesh_format_table_.end()) {
-        std::cout << "invalid mesh value. exiting. " << std::endl;
-        std::exit(1);
+        throw std::runtime_error("invalid mesh value");
       }
       mesh_format_ = it->second;
 
+    } else if (param_token == "matvec_schedule") {
+      auto it = matvec_schedule_table_.find(param_value);
+      if (it == matvec_schedule_table_.end()) {
+        throw std::runtime_error("invalid matvec_schedule value");
+      }
+      matvec_schedule_ = it->second;
+
+    } else if (param_token == "precision") {
+      auto it = precision_table_.find(param_value);
+      if (it == precision_table_.end()) {
+        throw std::runtime_error("invalid precision value");
+      }
+      precision_ = it->second;
+
     } else if (param_token == "sdens") {
       mesh_density_ = std::stod(param_value);
       if (mesh_density_ < 0) {
-        std::cout << "invalid density value. exiting. " << std::endl;
-        std::exit(1);
+        throw std::runtime_error("invalid density value");
       }
 
+    } else if (param_token == "gaussian_decay") {
+      mesh_gaussian_decay_ = std::stod(param_value);
+      if (mesh_gaussian_decay_ <= 0) {
+        throw std::runtime_error("invalid gaussian_decay value");
+      }
+
+    } else if (param_token == "mesh_cache") {
+      mesh_cache_dir_ = tokenized_line[1];
+
     } else if (param_token == "srad") {
       mesh_probe_radius_ = std::stod(param_value);
       if (mesh_probe_radius_ < 0) {
-        std::cout << "invalid probe radius value. exiting. " << std::endl;
-        std::exit(1);
+        throw std::runtime_error("invalid probe radius value");
       }
 
     } else if (param_token == "precondition") {
@@ -152,12 +230,20 @@ Params::Params(char *infile) {
         output_vtk_ = true;
       if (param_value == "ply")
         output_ply_ = true;
+      if (param_value == "vtu")
+        output_vtu_ = true;
+      if (param_value == "raw")
+        output_raw_ = true;
+      if (param_value == "float32")
+        output_float32_ = true;
       if (param_value == "csv")
         output_csv_ = true;
       if (param_value == "csv_headers")
         output_csv_headers_ = true;
       if (param_value == "timers")
         output_timers_ = true;
+      if (param_value == "timers_json")
+        output_timers_json_ = true;
 
     } else if (param_token == "output_prefix") {
       if (!param_value.empty())
@@ -168,10 +254,14 @@ Params::Params(char *infile) {
         input_mesh_prefix_ = param_value;
 
     } else {
-      std::cout << "Skipping undefined token: " << param_token << std::endl;
+      console::out() << "Skipping undefined token: " << param_token << std::endl;
     }
   }
 
+  Params::set_physical_constants();
+}
+
+void Params::set_physical_constants() {
   phys_eps_ = phys_eps_solvent_ / phys_eps_solute_;
   phys_kappa2_ = constants::BULK_COEFF * phys_bulk_strength_ /
                  phys_eps_solvent_ / phys_temp_;
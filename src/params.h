@@ -4,23 +4,41 @@
 #include <fstream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #ifdef TABIPB_APBS
 #include "tabipb_wrap/TABIPBStruct.h"
 #endif
 
 struct Params {
-  enum Mesh { SES, SKIN };
+  enum Mesh { SES, SKIN, GAUSSIAN };
   enum MeshFormat { MSMS, PLY };
+  enum MatvecSchedule { ATOMIC, OWNER };
+  enum Precision { DOUBLE, MIXED };
+  enum Solver { GMRES, FGMRES };
 
   std::unordered_map<std::string, enum Mesh> const mesh_table_ = {
-      {"ses", Mesh::SES}, {"skin", Mesh::SKIN}};
+      {"ses", Mesh::SES}, {"skin", Mesh::SKIN}, {"gaussian", Mesh::GAUSSIAN}};
 
   std::unordered_map<std::string, enum MeshFormat> const mesh_format_table_ = {
       {"msms", MeshFormat::MSMS}, {"ply", MeshFormat::PLY}};
 
+  std::unordered_map<std::string, enum MatvecSchedule> const matvec_schedule_table_ = {
+      {"atomic", MatvecSchedule::ATOMIC}, {"owner", MatvecSchedule::OWNER}};
+
+  std::unordered_map<std::string, enum Precision> const precision_table_ = {
+      {"double", Precision::DOUBLE}, {"mixed", Precision::MIXED}};
+
+  std::unordered_map<std::string, enum Solver> const solver_table_ = {
+      {"gmres", Solver::GMRES}, {"fgmres", Solver::FGMRES}};
+
   /* pqr file location */
-  std::ifstream pqr_file_;
+  std::string pqr_file_name_;
+
+  /* pqr files of further charge sets on the same atoms, solved together
+   * with the charges of the pqr file in blocks of charge_set_block_size */
+  std::vector<std::string> charge_set_files_;
+  long int charge_set_block_size_ = 8;
 
   /* mesh settings */
   enum Mesh mesh_;
@@ -28,6 +46,14 @@ struct Params {
   double mesh_density_;
   double mesh_probe_radius_;
 
+  /* Gaussian surfaces are meshed in process by marching cubes rather than
+   * by NanoShaper; larger decays hug the atoms more tightly */
+  double mesh_gaussian_decay_ = 2.3;
+
+  /* directory of binary meshes keyed by the atoms and mesh settings, reused
+   * instead of meshing again; empty disables the cache */
+  std::string mesh_cache_dir_;
+
   /* physical parameters */
   double phys_temp_;
   double phys_eps_solute_;
@@ -44,6 +70,23 @@ struct Params {
   int tree_max_per_leaf_;
   double tree_theta_;
 
+  /* autotuning: if the relative matvec error is above 0, the tree parameters
+   * are replaced by the fastest setting that meets it on the mesh, optionally
+   * read from and saved to the autotune cache file */
+  double autotune_error_ = 0.;
+  std::string autotune_cache_file_;
+
+  /* matvec scheduling: atomic updates per target node, or each thread
+   * owns the target leaves it computes (no atomics, deterministic) */
+  enum MatvecSchedule matvec_schedule_ = MatvecSchedule::ATOMIC;
+
+  /* far-field (PC, CP, CC) arithmetic: double, or single precision (mixed),
+   * which also reports the estimated energy deviation from double */
+  enum Precision precision_ = Precision::DOUBLE;
+
+  /* memory budget (MB) for interpolation operators cached across matvecs, 0 disables */
+  double interp_cache_budget_ = 1024.;
+
   /* preconditioning */
   bool precondition_;
 
@@ -52,22 +95,42 @@ struct Params {
   double gmres_residual_   = 1e-4;
   long int gmres_num_iter_ = 1000;
 
+  /* FGMRES: each outer iteration is preconditioned by a few GMRES iterations
+   * on a cheap operator (lower degree, optionally larger theta, single precision
+   * far field). A degree of 0 means tree_degree - 1, a negative theta tree_theta,
+   * so a theta of 0 (a direct sum) can be asked for. */
+  enum Solver solver_ = Solver::GMRES;
+  int fgmres_inner_degree_        = 0;
+  double fgmres_inner_theta_      = -1.;
+  long int fgmres_inner_num_iter_ = 5;
+  double fgmres_inner_residual_   = 1e-2;
+
   /* nonpolar energy */
   int nonpolar_;
 
   /* output of potential data */
   bool output_vtk_;
   bool output_ply_;
+  bool output_vtu_;
+  bool output_raw_;
+  bool output_float32_;  /* vtu and raw data in single precision */
   bool output_csv_;
   bool output_csv_headers_;
   bool output_timers_;
+  bool output_timers_json_;
 
   std::string output_prefix_;
   std::string input_mesh_prefix_;
 
-  Params(char *paramfile);
+  /* defaults only: the mesh and physical and tree parameters must be set,
+   * followed by set_physical_constants() */
+  Params();
+  Params(const char *paramfile);
   ~Params() = default;
 
+  /* phys_eps_, phys_kappa_ and phys_kappa2_ from the physical parameters */
+  void set_physical_constants();
+
 #ifdef TABIPB_APBS
   Params(TABIPBInput tabipbIn);
 #endif
@@ -6,17 +6,22 @@
 
 const std::array<double, 6> Particles::bounds(std::size_t begin, std::size_t end) const
 {
-    auto x_min_max = std::minmax_element(x_.begin() + begin, x_.begin() + end);
-    auto y_min_max = std::minmax_element(y_.begin() + begin, y_.begin() + end);
-    auto z_min_max = std::minmax_element(z_.begin() + begin, z_.begin() + end);
+    // single pass over the three coordinates
+    double x_min = x_[begin], x_max = x_[begin];
+    double y_min = y_[begin], y_max = y_[begin];
+    double z_min = z_[begin], z_max = z_[begin];
     
-    return std::array<double, 6> {*x_min_max.first, *x_min_max.second,
-                                  *y_min_max.first, *y_min_max.second,
-                                  *z_min_max.first, *z_min_max.second};
+    for (std::size_t i = begin + 1; i < end; ++i) {
+        x_min = std::min(x_min, x_[i]); x_max = std::max(x_max, x_[i]);
+        y_min = std::min(y_min, y_[i]); y_max = std::max(y_max, y_[i]);
+        z_min = std::min(z_min, z_[i]); z_max = std::max(z_max, z_[i]);
+    }
+    
+    return std::array<double, 6> {x_min, x_max, y_min, y_max, z_min, z_max};
 }
 
 
-int Particles::partition_8(std::size_t begin, std::size_t end,
+int Particles::partition_8(std::size_t begin, std::size_t end, const std::array<double, 6>& bounds,
                            std::array<std::size_t, 16>& partitioned_bounds)
 {
     int num_children = 1;
@@ -24,8 +29,6 @@ int Particles::partition_8(std::size_t begin, std::size_t end,
     partitioned_bounds[0] = begin;
     partitioned_bounds[1] = end;
     
-    auto bounds = Particles::bounds(begin, end);
-    
     double x_len = bounds[1] - bounds[0];
     double y_len = bounds[3] - bounds[2];
     double z_len = bounds[5] - bounds[4];
@@ -38,7 +38,7 @@ public:
     const double* y_ptr() const { return y_.data(); };
     const double* z_ptr() const { return z_.data(); };
 
-    int partition_8(std::size_t, std::size_t, std::array<std::size_t, 16>&);
+    int partition_8(std::size_t, std::size_t, const std::array<double, 6>&, std::array<std::size_t, 16>&);
     const std::array<double, 6> bounds(std::size_t begin, std::size_t end) const;
     
     virtual void reorder() = 0;
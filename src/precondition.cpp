@@ -1,10 +1,11 @@
 #include <cmath>
+#include <vector>
 
 #include "constants.h"
 #include "boundary_element.h"
 
 static int lu_decomp(double* A, int N, int* pivot);
-static void lu_solve(double* A, int N, int* pivot, double* rhs);
+static void lu_solve(double* A, int N, int* pivot, double* rhs, double* xtemp);
 
 
 void BoundaryElement::precondition_diagonal(double *z, double *r)
@@ -21,15 +22,14 @@ void BoundaryElement::precondition_diagonal(double *z, double *r)
 }
 
 
-void BoundaryElement::precondition_block(double *z, double *r)
+void BoundaryElement::factor_precondition_blocks()
 {
-    timers_.precondition.start();
+    timers_.factor_precondition_blocks.start();
 
     double eps    = params_.phys_eps_;
     double kappa  = params_.phys_kappa_;
     double kappa2 = params_.phys_kappa2_;
 
-    const std::size_t num_total_elements         = elements_.num();
     const double* __restrict elements_x_ptr    = elements_.x_ptr();
     const double* __restrict elements_y_ptr    = elements_.y_ptr();
     const double* __restrict elements_z_ptr    = elements_.z_ptr();
@@ -42,17 +42,38 @@ void BoundaryElement::precondition_block(double *z, double *r)
     double potential_coeff_1 = 0.5 * (1. +      params_.phys_eps_);
     double potential_coeff_2 = 0.5 * (1. + 1. / params_.phys_eps_);
 
-    for (auto leaf_idx : tree_.leaves()) {
+    const auto& leaves = tree_.leaves();
+    std::size_t num_leaves = leaves.size();
+
+    // each leaf block is 2n x 2n, and lu_decomp counts pivots in an extra trailing entry
+    precondition_blocks_begin_.resize(num_leaves + 1);
+    precondition_pivots_begin_.resize(num_leaves + 1);
+    precondition_blocks_begin_[0] = 0;
+    precondition_pivots_begin_[0] = 0;
+
+    for (std::size_t i = 0; i < num_leaves; ++i) {
+        auto element_idxs = tree_.node_particle_idxs(leaves[i]);
+        std::size_t num_cols = 2 * (element_idxs[1] - element_idxs[0]);
+        precondition_blocks_begin_[i + 1] = precondition_blocks_begin_[i] + num_cols * num_cols;
+        precondition_pivots_begin_[i + 1] = precondition_pivots_begin_[i] + num_cols + 1;
+    }
+
+    precondition_blocks_.assign(precondition_blocks_begin_[num_leaves], 0.);
+    precondition_pivots_.assign(precondition_pivots_begin_[num_leaves], 0);
 
-        auto element_idxs = tree_.node_particle_idxs(leaf_idx);
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t leaf = 0; leaf < num_leaves; ++leaf) {
+
+        auto element_idxs = tree_.node_particle_idxs(leaves[leaf]);
         std::size_t element_begin = element_idxs[0];
         std::size_t element_end   = element_idxs[1];
         std::size_t num_elements = element_end - element_begin;
         std::size_t num_cols = 2 * num_elements;
 
-        std::vector<double> A(num_cols * num_cols, 0.);
-        std::vector<double> rhs(num_cols, 0.);
-        std::vector<int> pivot(num_cols, 0);
+        double* __restrict A = precondition_blocks_.data() + precondition_blocks_begin_[leaf];
+        int* __restrict pivot = precondition_pivots_.data() + precondition_pivots_begin_[leaf];
 
         for (std::size_t j = element_begin; j < element_end; ++j) {
 
@@ -121,26 +142,56 @@ void BoundaryElement::precondition_block(double *z, double *r)
 
             A[(row               ) * num_cols + (row               )] = potential_coeff_1;
             A[(row + num_elements) * num_cols + (row + num_elements)] = potential_coeff_2;
-
-            rhs[row]                = r[j];
-            rhs[row + num_elements] = r[j + num_total_elements];
         }
 
-        int num_cols_int = (int)num_cols;
-        
         //CLAPACK style call:
-        //int nrhs = 1, info;
-        //dgesv_(&num_cols_int, &nrhs, column_major_A.data(), &num_cols_int,
-        //       pivot.data(), rhs.data(), &num_cols_int, &info);
+        //int info;
+        //dgetrf_(&num_cols_int, &num_cols_int, column_major_A.data(), &num_cols_int,
+        //        pivot.data(), &info);
 
-        lu_decomp(A.data(), num_cols_int, pivot.data());
-        lu_solve(A.data(), num_cols_int, pivot.data(), rhs.data());
+        lu_decomp(A, (int)num_cols, pivot);
+    }
+
+    timers_.factor_precondition_blocks.stop();
+}
+
+
+void BoundaryElement::precondition_block(double *z, double *r)
+{
+    timers_.precondition.start();
+
+    const std::size_t num_total_elements = elements_.num();
+    const auto& leaves = tree_.leaves();
+    std::size_t num_leaves = leaves.size();
+
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t leaf = 0; leaf < num_leaves; ++leaf) {
+
+        auto element_idxs = tree_.node_particle_idxs(leaves[leaf]);
+        std::size_t element_begin = element_idxs[0];
+        std::size_t element_end   = element_idxs[1];
+        std::size_t num_elements = element_end - element_begin;
+        std::size_t num_cols = 2 * num_elements;
+
+        double* A = precondition_blocks_.data() + precondition_blocks_begin_[leaf];
+        int* pivot = precondition_pivots_.data() + precondition_pivots_begin_[leaf];
+
+        double* rhs   = workspace_.doubles();
+        double* xtemp = rhs + num_cols;
+
+        for (std::size_t j = element_begin; j < element_end; ++j) {
+            rhs[j - element_begin]                = r[j];
+            rhs[j - element_begin + num_elements] = r[j + num_total_elements];
+        }
+
+        lu_solve(A, (int)num_cols, pivot, rhs, xtemp);
 
         for (std::size_t j = element_begin; j < element_end; ++j) {
             z[j]                      = rhs[j - element_begin];
             z[j + num_total_elements] = rhs[j - element_begin + num_elements];
         }
-
     }
 
     timers_.precondition.stop();
@@ -196,10 +247,8 @@ static int lu_decomp(double* A, int N, int* pivot)
 }
 
 
-static void lu_solve(double* A, int N, int* pivot, double* rhs)
+static void lu_solve(double* A, int N, int* pivot, double* rhs, double* xtemp)
 {
-    std::vector<double> xtemp(N, 0.);
-
     for (int i = 0; i < N; ++i) {
         xtemp[i] = rhs[pivot[i]];
 
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "constants.h"
+#include "session.h"
+#include "tabipb_timers.h"
+
+Session::Session(struct Params& params, struct Timers& timers)
+    : params_(params), timers_(timers),
+      molecule_(params, timers.molecule),
+      // build particles from a NanoShaper surface generated by xyzr file
+      // then build a tree on the particles, partitioning them
+      elements_(molecule_, params, timers.elements),
+      autotune_(molecule_, elements_, params, timers.autotune),
+      mol_tree_(molecule_, params.tree_max_per_leaf_, timers.tree),
+      mol_interp_pts_(mol_tree_, params.tree_degree_),
+      elem_tree_(elements_, params.tree_max_per_leaf_, timers.tree),
+      elem_interp_pts_(elem_tree_, params.tree_degree_),
+      mol_ilist_(mol_tree_, params.tree_degree_, params.tree_theta_, timers.interaction_list),
+      elem_ilist_(elem_tree_, params.tree_degree_, params.tree_theta_, timers.interaction_list),
+      mol_elem_ilist_(elem_tree_, mol_tree_, params.tree_degree_, params.tree_theta_,
+                      timers.interaction_list),
+      output_(molecule_, elements_, params, timers.output)
+{
+    Session::init();
+}
+
+
+#ifdef TABIPB_APBS
+Session::Session(Valist* apbs_molecule, struct Params& params, struct Timers& timers)
+    : params_(params), timers_(timers),
+      molecule_(apbs_molecule, params, timers.molecule),
+      elements_(molecule_, params, timers.elements),
+      autotune_(molecule_, elements_, params, timers.autotune),
+      mol_tree_(molecule_, params.tree_max_per_leaf_, timers.tree),
+      mol_interp_pts_(mol_tree_, params.tree_degree_),
+      elem_tree_(elements_, params.tree_max_per_leaf_, timers.tree),
+      elem_interp_pts_(elem_tree_, params.tree_degree_),
+      mol_ilist_(mol_tree_, params.tree_degree_, params.tree_theta_, timers.interaction_list),
+      elem_ilist_(elem_tree_, params.tree_degree_, params.tree_theta_, timers.interaction_list),
+      mol_elem_ilist_(elem_tree_, mol_tree_, params.tree_degree_, params.tree_theta_,
+                      timers.interaction_list),
+      output_(molecule_, elements_, params, timers.output)
+{
+    Session::init();
+}
+#endif
+
+
+Session::~Session()
+{
+    Session::delete_from_device();
+}
+
+
+void Session::init()
+{
+    molecule_.copyin_to_device();
+    mol_interp_pts_.copyin_to_device();
+    mol_interp_pts_.compute_all_interp_pts();
+
+    elements_.copyin_to_device();
+    elem_interp_pts_.copyin_to_device();
+    elem_interp_pts_.compute_all_interp_pts();
+    on_device_ = true;
+
+    elements_.compute_source_term(elem_interp_pts_, elem_tree_, molecule_,
+                                  mol_interp_pts_, mol_tree_, mol_elem_ilist_);
+
+    // initialize the boundary element method
+    boundary_element_.reset(new BoundaryElement(elements_, elem_interp_pts_, elem_tree_,
+                                                elem_ilist_, molecule_, params_, output_,
+                                                timers_.boundary_element));
+}
+
+
+void Session::delete_from_device()
+{
+    if (!on_device_) return;
+    
+    molecule_.delete_from_device();
+    mol_interp_pts_.delete_from_device();
+
+    elements_.delete_from_device();
+    elem_interp_pts_.delete_from_device();
+    
+    on_device_ = false;
+}
+
+
+void Session::solve()
+{
+    if (finalized_) throw std::logic_error("session solved after its output was written");
+
+    std::size_t num_charge_sets = molecule_.num_charge_sets();
+
+    if (num_charge_sets == 1) {
+        boundary_element_->run_GMRES();
+
+        output_.compute_coulombic_energy(mol_interp_pts_, mol_tree_, mol_ilist_);
+        output_.compute_solvation_energy(elem_interp_pts_, elem_tree_, mol_interp_pts_,
+                                         mol_tree_, mol_elem_ilist_);
+    } else {
+        // only the source term changes between charge sets, so every set is
+        // solved against the same operator in blocks
+        std::size_t length = output_.potential().size();
+        std::vector<double> source_terms(num_charge_sets * length);
+        std::vector<double> potentials;
+
+        for (std::size_t i = 0; i < num_charge_sets; ++i) {
+            molecule_.select_charge_set(i);
+            elements_.clear_source_term();
+            elements_.compute_source_term(elem_interp_pts_, elem_tree_, molecule_,
+                                          mol_interp_pts_, mol_tree_, mol_elem_ilist_);
+            std::copy(elements_.source_term_ptr(), elements_.source_term_ptr() + length,
+                      source_terms.begin() + i * length);
+        }
+
+        boundary_element_->run_block_GMRES(source_terms, potentials);
+
+        // the first charge set is computed last, so it is the one written out
+        for (std::size_t i = num_charge_sets; i-- > 0;) {
+            molecule_.select_charge_set(i);
+            std::copy(potentials.begin() + i * length, potentials.begin() + (i + 1) * length,
+                      output_.potential().begin());
+
+            output_.compute_coulombic_energy(mol_interp_pts_, mol_tree_, mol_ilist_);
+            output_.compute_solvation_energy(elem_interp_pts_, elem_tree_,
+                                             mol_interp_pts_, mol_tree_, mol_elem_ilist_);
+            output_.store_charge_set_energies(i, num_charge_sets);
+        }
+    }
+    
+    // Output scales and unorders in place only when the session ends, so the
+    // results handed out here are converted on a copy
+    energies_.solvation = constants::UNITS_PARA  * output_.solvation_energy();
+    energies_.coulombic = constants::UNITS_COEFF * output_.coulombic_energy();
+    energies_.free      = energies_.solvation + energies_.coulombic;
+    
+    constexpr double pot_scaling = constants::UNITS_COEFF * constants::PI * 4.;
+    potential_ = output_.potential();
+    std::transform(potential_.begin(), potential_.end(), potential_.begin(),
+                   [=](double x){ return x * pot_scaling; });
+    elements_.unorder_potential(potential_);
+}
+
+
+void Session::write_output()
+{
+    if (finalized_) return;
+    
+    output_.finalize();
+    Session::delete_from_device();
+    finalized_ = true;
+    
+    output_.files(timers_);
+}
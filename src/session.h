@@ -0,0 +1,92 @@
+#ifndef H_TABIPB_SESSION_H
+#define H_TABIPB_SESSION_H
+
+#include <memory>
+#include <vector>
+
+#include "autotune.h"
+#include "boundary_element.h"
+#include "elements.h"
+#include "interaction_list.h"
+#include "interp_pts.h"
+#include "molecule.h"
+#include "output.h"
+#include "params.h"
+#include "tree.h"
+
+#ifdef TABIPB_APBS
+    #include "generic/valist.h"
+#endif
+
+struct Timers;
+
+/* energies of the first charge set, in kJ/mol */
+struct Energies
+{
+    double solvation;
+    double coulombic;
+    double free;
+};
+
+/* A solver for one molecule. The constructor builds the molecule, surface,
+ * trees, interpolation points, interaction lists and source term once; solve()
+ * can then be called any number of times, each starting from the previous
+ * solution. Errors are thrown as std::exception rather than ending the process,
+ * so several sessions can live in one process. */
+class Session
+{
+private:
+    struct Params& params_;
+    struct Timers& timers_;
+    
+    class Molecule molecule_;
+    class Elements elements_;
+    
+    // chooses the tree parameters, so it comes before the trees
+    class Autotune autotune_;
+    
+    class Tree mol_tree_;
+    class InterpolationPoints mol_interp_pts_;
+    class Tree elem_tree_;
+    class InterpolationPoints elem_interp_pts_;
+    
+    class InteractionList mol_ilist_;
+    class InteractionList elem_ilist_;
+    class InteractionList mol_elem_ilist_;
+    
+    class Output output_;
+    std::unique_ptr<class BoundaryElement> boundary_element_;
+    
+    bool on_device_ = false;
+    bool finalized_ = false;
+    
+    struct Energies energies_ = {0., 0., 0.};
+    std::vector<double> potential_;
+    
+    void init();
+    void delete_from_device();
+    
+public:
+    Session(struct Params&, struct Timers&);
+    ~Session();
+    
+#ifdef TABIPB_APBS
+    Session(Valist*, struct Params&, struct Timers&);
+#endif
+    
+    void solve();
+    
+    /* results of the last solve() */
+    struct Energies energies() const { return energies_; };
+    
+    /* surface potential in kJ/mol/e, in the order of the input mesh: the
+     * potential of each element, then its normal derivative */
+    const std::vector<double>& potential() const { return potential_; };
+    
+    std::size_t num_elements() const { return elements_.num(); };
+    
+    /* writes the output files the parameters ask for; ends the session */
+    void write_output();
+};
+
+#endif /* H_TABIPB_SESSION_H */
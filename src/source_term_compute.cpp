@@ -41,6 +41,9 @@ SourceTermCompute::SourceTermCompute(std::vector<double>& source_term,
     
     mol_interp_charge_.assign(num_mol_charges_, 0.);
     
+    workspace_.reserve(std::max(mol_interp_pts_.transfer_workspace_size(),
+                                elem_interp_pts_.transfer_workspace_size()), 0);
+    
 //    timers_.ctor.stop();
 }
 
@@ -501,21 +504,26 @@ void SourceTermCompute::upward_pass()
     double*       __restrict mol_clusters_q_ptr = mol_interp_charge_.data();
     
         
-    std::vector<double> weights (num_mol_interp_pts_per_node);
-    double* weights_ptr = weights.data();
-    int weights_num = weights.size();
-    
-    for (int i = 0; i < weights_num; ++i) {
-        weights[i] = ((i % 2 == 0)? 1 : -1);
-        if (i == 0 || i == weights_num-1) weights[i] = ((i % 2 == 0)? 1 : -1) * 0.5;
-    }
+    const double* weights_ptr = mol_interp_pts_.weights_ptr();
+#ifdef OPENACC_ENABLED
+    int weights_num = num_mol_interp_pts_per_node;
+#endif
 
     
 #ifdef OPENACC_ENABLED
     #pragma acc enter data copyin(weights_ptr[0:weights_num])
 #endif
     
+#ifdef OPENACC_ENABLED
     for (std::size_t node_idx = 0; node_idx < source_tree_.num_nodes(); ++node_idx) {
+#else
+    const auto& leaves = source_tree_.leaves();
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t leaf = 0; leaf < leaves.size(); ++leaf) {
+        std::size_t node_idx = leaves[leaf];
+#endif
         
         auto particle_idxs = source_tree_.node_particle_idxs(node_idx);
         
@@ -525,15 +533,10 @@ void SourceTermCompute::upward_pass()
         std::size_t particle_start = particle_idxs[0];
         std::size_t num_particles  = particle_idxs[1] - particle_idxs[0];
         
-        std::vector<int> exact_idx_x(num_particles);
-        std::vector<int> exact_idx_y(num_particles);
-        std::vector<int> exact_idx_z(num_particles);
-        std::vector<double> denominator(num_particles);
-        
-        int* exact_idx_x_ptr = exact_idx_x.data();
-        int* exact_idx_y_ptr = exact_idx_y.data();
-        int* exact_idx_z_ptr = exact_idx_z.data();
-        double* denominator_ptr = denominator.data();
+        int* exact_idx_x_ptr = workspace_.ints();
+        int* exact_idx_y_ptr = exact_idx_x_ptr + num_particles;
+        int* exact_idx_z_ptr = exact_idx_y_ptr + num_particles;
+        double* denominator_ptr = workspace_.doubles();
         
 #ifdef OPENACC_ENABLED
 #pragma acc kernels present(mol_x_ptr, mol_y_ptr, mol_z_ptr, mol_q_ptr, \
@@ -666,6 +669,8 @@ void SourceTermCompute::upward_pass()
     } // end loop over nodes
 #ifdef OPENACC_ENABLED
     #pragma acc exit data delete(weights_ptr[0:weights_num])
+#else
+    mol_interp_pts_.upward_transfer(mol_clusters_q_ptr, workspace_);
 #endif
 
 //    timers_.upward_pass.stop();
@@ -676,6 +681,13 @@ void SourceTermCompute::downward_pass()
 {
 //    timers_.downward_pass.start();
 
+#ifndef OPENACC_ENABLED
+    elem_interp_pts_.downward_transfer(elem_interp_potential_.data(), workspace_);
+    elem_interp_pts_.downward_transfer(elem_interp_potential_dx_.data(), workspace_);
+    elem_interp_pts_.downward_transfer(elem_interp_potential_dy_.data(), workspace_);
+    elem_interp_pts_.downward_transfer(elem_interp_potential_dz_.data(), workspace_);
+#endif
+
     int num_elem_interp_pts_per_node        = num_elem_interp_pts_per_node_;
     int num_elem_interp_potentials_per_node = num_elem_interp_potentials_per_node_;
     
@@ -698,21 +710,26 @@ void SourceTermCompute::downward_pass()
     const double* __restrict elem_clusters_p_dy_ptr = elem_interp_potential_dy_.data();
     const double* __restrict elem_clusters_p_dz_ptr = elem_interp_potential_dz_.data();
     
-    std::vector<double> weights (num_elem_interp_pts_per_node);
-    double* weights_ptr = weights.data();
-    int weights_num = weights.size();
-    
-    for (int i = 0; i < weights_num; ++i) {
-        weights[i] = ((i % 2 == 0)? 1 : -1);
-        if (i == 0 || i == weights_num-1) weights[i] = ((i % 2 == 0)? 1 : -1) * 0.5;
-    }
+    const double* weights_ptr = elem_interp_pts_.weights_ptr();
+#ifdef OPENACC_ENABLED
+    int weights_num = num_elem_interp_pts_per_node;
+#endif
 
     
 #ifdef OPENACC_ENABLED
 #pragma acc enter data copyin(weights_ptr[0:weights_num])
 #endif
     
+#ifdef OPENACC_ENABLED
     for (std::size_t node_idx = 0; node_idx < target_tree_.num_nodes(); ++node_idx) {
+#else
+    const auto& leaves = target_tree_.leaves();
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t leaf = 0; leaf < leaves.size(); ++leaf) {
+        std::size_t node_idx = leaves[leaf];
+#endif
         
         auto particle_idxs = target_tree_.node_particle_idxs(node_idx);
         std::size_t node_interp_pts_start = node_idx * num_elem_interp_pts_per_node;
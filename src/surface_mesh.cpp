@@ -0,0 +1,500 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef OPENMP_ENABLED
+    #include <omp.h>
+#endif
+
+#include "surface_mesh.h"
+
+namespace surface_mesh {
+
+namespace {
+
+/* atoms contribute to the field where their exponent is above -CUTOFF_EXPONENT */
+constexpr double CUTOFF_EXPONENT = 12.;
+
+/* the grid extends this far past the last atom, in units of the atom radius at
+ * which a single atom contributes exp(-MARGIN_EXPONENT) */
+constexpr double MARGIN_EXPONENT = 6.;
+
+/* Crossings are kept this fraction of a grid edge off the grid points, so that
+ * no triangle collapses and no two vertices crowd together; elements much closer
+ * than the grid spacing leave GMRES stalling. */
+constexpr double MIN_CROSSING = 0.25;
+
+/* triangles with less area than this fraction of their longest edge squared
+ * count as degenerate */
+constexpr double DEGENERATE_AREA = 1e-12;
+
+constexpr uint32_t NO_VERTEX = 0xffffffffu;
+
+
+/* Marching cubes cases, generated from face rules rather than tabulated. Corner c
+ * of a cell is at offset (c & 1, c >> 1 & 1, c >> 2 & 1), and bit c of a case is
+ * set when that corner is inside the surface. */
+struct CaseTable
+{
+    std::array<std::array<int, 2>, 12> edge_corners;
+    std::array<std::vector<std::array<int, 3>>, 256> triangles;
+
+    CaseTable();
+};
+
+
+CaseTable::CaseTable()
+{
+    int edge_index[8][8];
+    int num_edges = 0;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int c = 0; c < 8; ++c) {
+            if (c >> axis & 1) continue;
+            int d = c | 1 << axis;
+            edge_corners[num_edges] = {{c, d}};
+            edge_index[c][d] = edge_index[d][c] = num_edges++;
+        }
+    }
+
+    // corners of each face, counterclockwise seen from outside the cell
+    std::array<std::array<int, 4>, 6> faces;
+    for (int axis = 0; axis < 3; ++axis) {
+        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        for (int side = 0; side < 2; ++side) {
+            int base = side << axis;
+            std::array<int, 4> face = {{base, base | 1 << u, base | 1 << u | 1 << v, base | 1 << v}};
+            if (side == 0) std::swap(face[1], face[3]);
+            faces[2 * axis + side] = face;
+        }
+    }
+
+    // bit f of an edge is set when the edge borders face f
+    std::array<int, 12> edge_faces;
+    edge_faces.fill(0);
+    for (int f = 0; f < 6; ++f)
+        for (int k = 0; k < 4; ++k)
+            edge_faces[edge_index[faces[f][k]][faces[f][(k + 1) % 4]]] |= 1 << f;
+
+    for (int index = 0; index < 256; ++index) {
+
+        // Walking counterclockwise around a face, the surface runs from each edge
+        // where the walk leaves the inside corners back to the nearest edge where it
+        // entered them. Diagonal inside corners are kept apart, the same way in both
+        // cells sharing the face, so the surface has no cracks.
+        std::array<int, 12> next;
+        next.fill(-1);
+
+        for (const auto& face : faces) {
+            std::array<bool, 4> in;
+            for (int k = 0; k < 4; ++k) in[k] = index >> face[k] & 1;
+
+            for (int k = 0; k < 4; ++k) {
+                if (!in[k] || in[(k + 1) % 4]) continue;
+
+                for (int j = 1; j < 4; ++j) {
+                    int e = (k + 4 - j) % 4;
+                    if (in[e] || !in[(e + 1) % 4]) continue;
+
+                    next[edge_index[face[k]][face[(k + 1) % 4]]] = edge_index[face[e]][face[(e + 1) % 4]];
+                    break;
+                }
+            }
+        }
+
+        // Every crossed edge starts one such segment on one of its two faces, so
+        // the segments chain into closed polygons, which are fanned into triangles.
+        // A polygon crossing a face twice has two vertices on that face, and a fan
+        // diagonal between them would lie in the face, where the neighbouring cell
+        // uses it too; the fan starts at a vertex sharing a face with no vertex
+        // but its neighbours, which every polygon of the table has.
+        std::array<bool, 12> visited;
+        visited.fill(false);
+
+        for (int start = 0; start < 12; ++start) {
+            if (next[start] < 0 || visited[start]) continue;
+
+            std::vector<int> polygon;
+            for (int e = start; !visited[e]; e = next[e]) {
+                visited[e] = true;
+                polygon.push_back(e);
+            }
+
+            std::size_t size = polygon.size();
+            for (std::size_t apex = 0; apex < size; ++apex) {
+                bool in_face = false;
+                for (std::size_t i = 2; i + 1 < size; ++i)
+                    if (edge_faces[polygon[apex]] & edge_faces[polygon[(apex + i) % size]]) in_face = true;
+                if (in_face) continue;
+
+                std::rotate(polygon.begin(), polygon.begin() + apex, polygon.end());
+                break;
+            }
+
+            for (std::size_t i = 1; i + 1 < size; ++i)
+                triangles[index].push_back({{polygon[0], polygon[i + 1], polygon[i]}});
+        }
+    }
+}
+
+}
+
+
+void gaussian_surface(const double* x, const double* y, const double* z, const double* radius,
+                      std::size_t num_atoms, double density, double decay, Mesh& mesh)
+{
+    static const CaseTable table;
+
+    const double h = 1. / density;
+    const double max_radius = *std::max_element(radius, radius + num_atoms);
+    const double margin = max_radius * std::sqrt(1. + MARGIN_EXPONENT / decay) + 2. * h;
+
+    const double ox = *std::min_element(x, x + num_atoms) - margin;
+    const double oy = *std::min_element(y, y + num_atoms) - margin;
+    const double oz = *std::min_element(z, z + num_atoms) - margin;
+
+    const std::size_t nx = std::ceil((*std::max_element(x, x + num_atoms) + margin - ox) / h) + 1;
+    const std::size_t ny = std::ceil((*std::max_element(y, y + num_atoms) + margin - oy) / h) + 1;
+    const std::size_t nz = std::ceil((*std::max_element(z, z + num_atoms) + margin - oz) / h) + 1;
+
+    const std::size_t nxy = nx * ny;
+    const std::array<std::size_t, 3> stride = {{1, nx, nxy}};
+
+    std::vector<double> field(nxy * nz, 0.);
+
+    // Each layer sums the atoms within reach of it. The outermost grid points are
+    // left at zero so that the surface is always closed.
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t k = 1; k < nz - 1; ++k) {
+        double pz = oz + k * h;
+        double* layer = field.data() + k * nxy;
+
+        for (std::size_t a = 0; a < num_atoms; ++a) {
+            double inv_r2 = 1. / (radius[a] * radius[a]);
+            double cutoff2 = radius[a] * radius[a] * (1. + CUTOFF_EXPONENT / decay);
+            double dz = pz - z[a];
+            if (dz * dz >= cutoff2) continue;
+
+            double reach = std::sqrt(cutoff2 - dz * dz);
+            std::size_t i_begin = std::max(1., std::ceil ((x[a] - reach - ox) / h));
+            std::size_t i_end   = std::min(nx - 2., std::floor((x[a] + reach - ox) / h));
+            std::size_t j_begin = std::max(1., std::ceil ((y[a] - reach - oy) / h));
+            std::size_t j_end   = std::min(ny - 2., std::floor((y[a] + reach - oy) / h));
+
+            for (std::size_t j = j_begin; j <= j_end; ++j) {
+                double dy = oy + j * h - y[a];
+                for (std::size_t i = i_begin; i <= i_end; ++i) {
+                    double dx = ox + i * h - x[a];
+                    double r2 = dx * dx + dy * dy + dz * dz;
+                    if (r2 < cutoff2) layer[i + j * nx] += std::exp(-decay * (r2 * inv_r2 - 1.));
+                }
+            }
+        }
+    }
+
+    // Each crossed grid edge gets one vertex, in slot axis of its lower grid point;
+    // vertices are numbered layer by layer.
+    std::vector<uint32_t> edge_vertex(3 * nxy * nz, NO_VERTEX);
+    std::vector<std::size_t> layer_offset(nz + 1, 0);
+
+    auto coordinate = [&](std::size_t p, int axis) {
+        return axis == 0 ? p % nx : axis == 1 ? p / nx % ny : p / nxy;
+    };
+    auto extent = [&](int axis) { return axis == 0 ? nx : axis == 1 ? ny : nz; };
+
+    auto crossed = [&](std::size_t p, int axis) {
+        return coordinate(p, axis) < extent(axis) - 1
+            && (field[p] > 1.) != (field[p + stride[axis]] > 1.);
+    };
+    auto crossing = [&](std::size_t p, int axis) {
+        double t = (1. - field[p]) / (field[p + stride[axis]] - field[p]);
+        return std::min(std::max(t, MIN_CROSSING), 1. - MIN_CROSSING);
+    };
+
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t k = 0; k < nz; ++k) {
+        std::size_t count = 0;
+        for (std::size_t p = k * nxy; p < (k + 1) * nxy; ++p)
+            for (int axis = 0; axis < 3; ++axis) count += crossed(p, axis);
+        layer_offset[k + 1] = count;
+    }
+
+    std::partial_sum(layer_offset.begin(), layer_offset.end(), layer_offset.begin());
+    std::size_t num_vertices = layer_offset[nz];
+
+    mesh.x.resize(num_vertices);
+    mesh.y.resize(num_vertices);
+    mesh.z.resize(num_vertices);
+    mesh.nx.resize(num_vertices);
+    mesh.ny.resize(num_vertices);
+    mesh.nz.resize(num_vertices);
+
+    auto gradient = [&](std::size_t p, int axis) {
+        std::size_t lo = coordinate(p, axis) > 0              ? p - stride[axis] : p;
+        std::size_t hi = coordinate(p, axis) < extent(axis) - 1 ? p + stride[axis] : p;
+        return (field[hi] - field[lo]) / ((hi - lo) / stride[axis] * h);
+    };
+
+    // the field decreases outward, along the normal
+    auto add_vertex = [&](std::size_t v, std::size_t p, int axis, double t) {
+        std::size_t q = p + stride[axis];
+
+        mesh.x[v] = ox + (coordinate(p, 0) + (axis == 0) * t) * h;
+        mesh.y[v] = oy + (coordinate(p, 1) + (axis == 1) * t) * h;
+        mesh.z[v] = oz + (coordinate(p, 2) + (axis == 2) * t) * h;
+
+        double gx = (1. - t) * gradient(p, 0) + t * gradient(q, 0);
+        double gy = (1. - t) * gradient(p, 1) + t * gradient(q, 1);
+        double gz = (1. - t) * gradient(p, 2) + t * gradient(q, 2);
+        double norm = std::sqrt(gx * gx + gy * gy + gz * gz);
+
+        mesh.nx[v] = -gx / norm;
+        mesh.ny[v] = -gy / norm;
+        mesh.nz[v] = -gz / norm;
+    };
+
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t k = 0; k < nz; ++k) {
+        std::size_t v = layer_offset[k];
+
+        for (std::size_t p = k * nxy; p < (k + 1) * nxy; ++p) {
+            for (int axis = 0; axis < 3; ++axis) {
+                if (!crossed(p, axis)) continue;
+                add_vertex(v, p, axis, crossing(p, axis));
+                edge_vertex[3 * p + axis] = v++;
+            }
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> layer_faces(nz - 1);
+
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t k = 0; k < nz - 1; ++k) {
+        for (std::size_t j = 0; j < ny - 1; ++j) {
+            for (std::size_t i = 0; i < nx - 1; ++i) {
+                std::size_t base = i + j * nx + k * nxy;
+
+                auto corner = [&](int c) {
+                    return base + (c & 1) + (c >> 1 & 1) * nx + (c >> 2 & 1) * nxy;
+                };
+
+                int index = 0;
+                for (int c = 0; c < 8; ++c)
+                    if (field[corner(c)] > 1.) index |= 1 << c;
+
+                for (const auto& triangle : table.triangles[index]) {
+                    for (int n = 0; n < 3; ++n) {
+                        int c = table.edge_corners[triangle[n]][0];
+                        int d = table.edge_corners[triangle[n]][1];
+                        int axis = d - c == 1 ? 0 : d - c == 2 ? 1 : 2;
+                        layer_faces[k].push_back(edge_vertex[3 * corner(c) + axis] + 1);
+                    }
+                }
+            }
+        }
+    }
+
+    mesh.face_x.clear();
+    mesh.face_y.clear();
+    mesh.face_z.clear();
+
+    for (const auto& layer : layer_faces) {
+        for (std::size_t f = 0; f < layer.size(); f += 3) {
+            mesh.face_x.push_back(layer[f]);
+            mesh.face_y.push_back(layer[f + 1]);
+            mesh.face_z.push_back(layer[f + 2]);
+        }
+    }
+
+    check_closed(mesh);
+}
+
+
+void check_closed(const Mesh& mesh)
+{
+    const std::size_t num_faces = mesh.face_x.size();
+
+    // each directed edge of a closed, consistently oriented surface appears once,
+    // and its reverse once
+    std::vector<uint64_t> edges;
+    edges.reserve(3 * num_faces);
+
+    double volume = 0.;
+
+    for (std::size_t f = 0; f < num_faces; ++f) {
+        const uint32_t v[3] = {mesh.face_x[f], mesh.face_y[f], mesh.face_z[f]};
+        for (int n = 0; n < 3; ++n)
+            if (v[n] < 1 || v[n] > mesh.x.size())
+                throw std::runtime_error("surface mesh face " + std::to_string(f + 1)
+                                         + " has no vertex " + std::to_string(v[n]));
+
+        double p[3][3];
+        for (int n = 0; n < 3; ++n) {
+            p[n][0] = mesh.x[v[n] - 1];
+            p[n][1] = mesh.y[v[n] - 1];
+            p[n][2] = mesh.z[v[n] - 1];
+        }
+
+        double a[3], b[3];
+        for (int d = 0; d < 3; ++d) {
+            a[d] = p[1][d] - p[0][d];
+            b[d] = p[2][d] - p[0][d];
+        }
+        double cross[3] = {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+        double cross2   = cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2];
+
+        double longest2 = 0.;
+        for (int n = 0; n < 3; ++n) {
+            double e2 = 0.;
+            for (int d = 0; d < 3; ++d) e2 += (p[(n + 1) % 3][d] - p[n][d]) * (p[(n + 1) % 3][d] - p[n][d]);
+            longest2 = std::max(longest2, e2);
+        }
+        if (!(cross2 > DEGENERATE_AREA * DEGENERATE_AREA * longest2 * longest2))
+            throw std::runtime_error("surface mesh face " + std::to_string(f + 1) + " has no area");
+
+        volume += p[0][0] * cross[0] + p[0][1] * cross[1] + p[0][2] * cross[2];
+
+        for (int n = 0; n < 3; ++n)
+            edges.push_back(uint64_t(v[n]) << 32 | v[(n + 1) % 3]);
+    }
+
+    std::sort(edges.begin(), edges.end());
+
+    for (std::size_t e = 0; e < edges.size(); ++e) {
+        uint64_t reverse = edges[e] << 32 | edges[e] >> 32;
+        if ((e + 1 < edges.size() && edges[e + 1] == edges[e])
+         || !std::binary_search(edges.begin(), edges.end(), reverse))
+            throw std::runtime_error("surface mesh edge " + std::to_string(edges[e] >> 32) + " "
+                                     + std::to_string(edges[e] & 0xffffffffu)
+                                     + " is not shared by exactly two consistently oriented faces");
+    }
+
+    // cavities enclose negative volume, the outer surfaces more positive volume
+    if (num_faces > 0 && !(volume > 0.))
+        throw std::runtime_error("surface mesh faces are oriented inward");
+}
+
+
+
+void sphere(double radius, std::size_t num_vertices, Mesh& mesh)
+{
+    const double phi = 0.5 * (1. + std::sqrt(5.));
+    const double corners[12][3] = {
+        {-1.,  phi,  0.}, { 1.,  phi,  0.}, {-1., -phi,  0.}, { 1., -phi,  0.},
+        { 0., -1.,  phi}, { 0.,  1.,  phi}, { 0., -1., -phi}, { 0.,  1., -phi},
+        { phi,  0., -1.}, { phi,  0.,  1.}, {-phi,  0., -1.}, {-phi,  0.,  1.}};
+    const int faces[20][3] = {
+        {0, 11,  5}, {0,  5,  1}, { 0,  1,  7}, { 0,  7, 10}, {0, 10, 11},
+        {1,  5,  9}, {5, 11,  4}, {11, 10,  2}, {10,  7,  6}, {7,  1,  8},
+        {3,  9,  4}, {3,  4,  2}, { 3,  2,  6}, { 3,  6,  8}, {3,  8,  9},
+        {4,  9,  5}, {2,  4, 11}, { 6,  2, 10}, { 8,  6,  7}, {9,  8,  1}};
+
+    // n segments per icosahedron edge give 10 n^2 + 2 vertices
+    const std::size_t n = std::max<long long>(1,
+            std::llround(std::sqrt(std::max(0., (num_vertices - 2.) / 10.))));
+
+    int edges[12][12];
+    int num_edges = 0;
+    for (auto& row : edges) std::fill(std::begin(row), std::end(row), -1);
+    for (const auto& face : faces) {
+        for (int e = 0; e < 3; ++e) {
+            int a = face[e], b = face[(e + 1) % 3];
+            if (edges[a][b] < 0) edges[a][b] = edges[b][a] = num_edges++;
+        }
+    }
+
+    // Vertices: the corners, then the inner points of each edge from its lower
+    // corner, then the inner points of each face
+    const std::size_t edge_begin = 12;
+    const std::size_t face_begin = edge_begin + 30 * (n - 1);
+    const std::size_t per_face   = (n - 1) * (n - 2) / 2;
+    const std::size_t num = face_begin + 20 * per_face;
+
+    mesh.x.resize(num);
+    mesh.y.resize(num);
+    mesh.z.resize(num);
+    mesh.nx.resize(num);
+    mesh.ny.resize(num);
+    mesh.nz.resize(num);
+
+    auto set_vertex = [&](std::size_t v, int a, int b, int c, double s, double t) {
+        double p[3];
+        for (int axis = 0; axis < 3; ++axis)
+            p[axis] = corners[a][axis] + s * (corners[b][axis] - corners[a][axis])
+                                       + t * (corners[c][axis] - corners[a][axis]);
+        double norm = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        mesh.nx[v] = p[0] / norm;
+        mesh.ny[v] = p[1] / norm;
+        mesh.nz[v] = p[2] / norm;
+        mesh.x[v] = radius * mesh.nx[v];
+        mesh.y[v] = radius * mesh.ny[v];
+        mesh.z[v] = radius * mesh.nz[v];
+    };
+
+    auto edge_vertex = [&](int a, int b, std::size_t t) {
+        std::size_t along = a < b ? t : n - t;
+        return edge_begin + edges[a][b] * (n - 1) + along - 1;
+    };
+
+    for (int a = 0; a < 12; ++a)
+        set_vertex(a, a, a, a, 0., 0.);
+
+    for (int a = 0; a < 12; ++a)
+        for (int b = a + 1; b < 12; ++b)
+            if (edges[a][b] >= 0)
+                for (std::size_t t = 1; t < n; ++t)
+                    set_vertex(edge_vertex(a, b, t), a, b, a, double(t) / n, 0.);
+
+    mesh.face_x.resize(20 * n * n);
+    mesh.face_y.resize(20 * n * n);
+    mesh.face_z.resize(20 * n * n);
+
+    for (int f = 0; f < 20; ++f) {
+        const int a = faces[f][0], b = faces[f][1], c = faces[f][2];
+
+        // point i steps from a towards b and j steps towards c
+        auto vertex = [&](std::size_t i, std::size_t j) -> std::size_t {
+            if (i == 0 && j == 0) return a;
+            if (i == n) return b;
+            if (j == n) return c;
+            if (j == 0) return edge_vertex(a, b, i);
+            if (i == 0) return edge_vertex(a, c, j);
+            if (i + j == n) return edge_vertex(b, c, j);
+            return face_begin + f * per_face + (i - 1) * (n - 1) - (i - 1) * i / 2 + j - 1;
+        };
+
+        for (std::size_t i = 1; i + 1 < n; ++i)
+            for (std::size_t j = 1; i + j < n; ++j)
+                set_vertex(vertex(i, j), a, b, c, double(i) / n, double(j) / n);
+
+        std::size_t t = f * n * n;
+        auto add_face = [&](std::size_t v0, std::size_t v1, std::size_t v2) {
+            mesh.face_x[t] = v0 + 1;
+            mesh.face_y[t] = v1 + 1;
+            mesh.face_z[t] = v2 + 1;
+            ++t;
+        };
+
+        for (std::size_t i = 0; i < n; ++i) {
+            for (std::size_t j = 0; i + j < n; ++j) {
+                add_face(vertex(i, j), vertex(i + 1, j), vertex(i, j + 1));
+                if (i + j + 1 < n)
+                    add_face(vertex(i + 1, j), vertex(i + 1, j + 1), vertex(i, j + 1));
+            }
+        }
+    }
+}
+
+}
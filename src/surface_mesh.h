@@ -0,0 +1,44 @@
+#ifndef H_TABIPB_SURFACE_MESH_H
+#define H_TABIPB_SURFACE_MESH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace surface_mesh {
+
+    /* triangulated surface with unit outward vertex normals; faces index the
+     * vertices from 1, as MSMS files do */
+    struct Mesh {
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<double> z;
+        std::vector<double> nx;
+        std::vector<double> ny;
+        std::vector<double> nz;
+
+        std::vector<uint32_t> face_x;
+        std::vector<uint32_t> face_y;
+        std::vector<uint32_t> face_z;
+    };
+
+    /* Marching cubes triangulation of the Gaussian surface
+     *     sum_i exp(-decay * (|r - r_i|^2 / radius_i^2 - 1)) = 1
+     * of the atoms, on a grid of spacing 1 / density. For a single atom it is the
+     * atom's sphere; larger decays give surfaces closer to the van der Waals surface.
+     * Throws if the result fails check_closed. */
+    void gaussian_surface(const double* x, const double* y, const double* z, const double* radius,
+                          std::size_t num_atoms, double density, double decay, Mesh& mesh);
+
+    /* Throws unless every edge is shared by exactly two faces that traverse it in
+     * opposite directions, no face is degenerate, and the faces enclose positive
+     * volume, i.e. the surface is closed, manifold and oriented outward. */
+    void check_closed(const Mesh& mesh);
+
+    /* Geodesic sphere about the origin: an icosahedron with each face split into
+     * a triangular grid and projected onto the sphere, with the 10 n^2 + 2
+     * vertices closest to num_vertices. */
+    void sphere(double radius, std::size_t num_vertices, Mesh& mesh);
+}
+
+#endif /* H_TABIPB_SURFACE_MESH_H */
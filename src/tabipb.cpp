@@ -0,0 +1,18 @@
+#include "params.h"
+#include "session.h"
+#include "tabipb.h"
+#include "tabipb_timers.h"
+
+struct Energies run_tabipb(struct Params &params, struct Timers &timers) {
+  timers.tabipb.start();
+
+  class Session session(params, timers);
+  session.solve();
+
+  timers.tabipb.stop();
+
+  /* energies, potential, and outfile routines are contained in output */
+  session.write_output();
+
+  return session.energies();
+}
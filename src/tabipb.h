@@ -0,0 +1,13 @@
+#ifndef H_TABIPB_RUN_H
+#define H_TABIPB_RUN_H
+
+#include "session.h"
+
+struct Params;
+struct Timers;
+
+/* builds the molecule and surface of an input deck, solves, and writes
+ * the output files the deck asks for */
+struct Energies run_tabipb(struct Params& params, struct Timers& timers);
+
+#endif /* H_TABIPB_RUN_H */
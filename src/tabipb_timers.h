@@ -3,11 +3,14 @@
 
 #include <iostream>
 #include <iomanip>
+#include <string>
 // #include <chrono>
 
+#include "console.h"
 #include "timer.h"
 #include "molecule.h"
 #include "elements.h"
+#include "autotune.h"
 #include "tree.h"
 #include "interaction_list.h"
 #include "boundary_element.h"
@@ -17,6 +20,7 @@ struct Timers
 {
     Timers_Molecule molecule;
     Timers_Elements elements;
+    Timers_Autotune autotune;
     Timers_Tree tree;
     Timers_InteractionList interaction_list;
     Timers_BoundaryElement boundary_element;
@@ -30,17 +34,18 @@ struct Timers
 
     void print() const
     {
-        std::cout.setf(std::ios::fixed, std::ios::floatfield);
-        std::cout.precision(5);
+        console::out().setf(std::ios::fixed, std::ios::floatfield);
+        console::out().precision(5);
         
-        std::cout << "|...Total TABIPB time (s)..........: ";
-        std::cout << std::setw(12) << std::right << tabipb.elapsed_time() << std::endl;
-        std::cout << "|" << std::endl;
+        console::out() << "|...Total TABIPB time (s)..........: ";
+        console::out() << std::setw(12) << std::right << tabipb.elapsed_time() << std::endl;
+        console::out() << "|" << std::endl;
         
         molecule         .print();
         elements         .print();
-        //tree             .print();
-        //interaction_list .print();
+        autotune         .print();
+        tree             .print();
+        interaction_list .print();
         boundary_element .print();
         output           .print();
     }
@@ -53,8 +58,9 @@ struct Timers
         
         durations.append(molecule         .get_durations());
         durations.append(elements         .get_durations());
-        //durations.append(tree             .get_durations());
-        //durations.append(interaction_list .get_durations());
+        durations.append(autotune         .get_durations());
+        durations.append(tree             .get_durations());
+        durations.append(interaction_list .get_durations());
         durations.append(boundary_element .get_durations());
         durations.append(output           .get_durations());
 
@@ -69,13 +75,40 @@ struct Timers
         
         headers.append(molecule         .get_headers());
         headers.append(elements         .get_headers());
-        //headers.append(tree             .get_headers());
-        //headers.append(interaction_list .get_headers());
+        headers.append(autotune         .get_headers());
+        headers.append(tree             .get_headers());
+        headers.append(interaction_list .get_headers());
         headers.append(boundary_element .get_headers());
         headers.append(output           .get_headers());
 
         return headers;
     }
+
+
+    /* the CSV columns as an object, then the interactions of every matvec */
+    std::string get_json() const
+    {
+        std::string headers   = get_headers();
+        std::string durations = get_durations();
+        
+        std::string json = "{\n  \"timers\": {";
+        std::size_t header_begin = 0, duration_begin = 0;
+        for (bool first = true; ; first = false) {
+            std::size_t header_end   = headers  .find(", ", header_begin);
+            std::size_t duration_end = durations.find(", ", duration_begin);
+            if (header_end == std::string::npos || duration_end == std::string::npos) break;
+            
+            json.append(first ? "\n" : ",\n").append("    \"")
+                .append(headers,   header_begin,   header_end   - header_begin).append("\": ")
+                .append(durations, duration_begin, duration_end - duration_begin);
+            
+            header_begin   = header_end   + 2;
+            duration_begin = duration_end + 2;
+        }
+        json.append("\n  },\n").append(boundary_element.get_json()).append("\n}\n");
+        
+        return json;
+    }
 };
 
 #endif
@@ -28,6 +28,9 @@ struct TABIPBOutput {
     double solvation_energy_;
     double coulombic_energy_;
     double free_energy_;
+    
+    /* nonzero if the run failed, in which case the energies are zero */
+    int error_;
 
 };
 
@@ -1,40 +1,33 @@
+#include <exception>
+#include <iostream>
+
 #include "../tabipb_timers.h"
 #include "../params.h"
-#include "../molecule.h"
-#include "../elements.h"
-#include "../tree.h"
-#include "../interaction_list.h"
-#include "../clusters.h"
-#include "../boundary_element.h"
+#include "../session.h"
 
 #include "TABIPBWrap.h"
 
 struct TABIPBOutput runTABIPBWrapAPBS(struct TABIPBInput tabipbIn, Valist* APBSMolecule)
 {
-    struct Params params(tabipbIn);
-    struct Timers timers;
-
-    class Molecule molecule(APBSMolecule, params, timers.molecule);
-    
-    molecule.compute_coulombic_energy();
-    molecule.build_xyzr_file();
-    
-    class Elements elements(molecule, params, timers.elements);
-    class Tree tree(elements, params, timers.tree);
-    
-    elements.compute_source_term();
-    
-    class Clusters clusters(elements, tree, params, timers.clusters);
-    
-    clusters.compute_all_interp_pts();
-    
-    class InteractionList interaction_list(tree, params, timers.interaction_list);
-    class BoundaryElement boundary_element(elements, clusters, tree, interaction_list, molecule,
-                            params, timers.boundary_element);
+    // exceptions must not cross into the C caller
+    try {
+        struct Params params(tabipbIn);
+        struct Timers timers;
     
-    boundary_element.run_GMRES();
-    boundary_element.finalize();
-    auto energies = Output(boundary_element, timers);
+        timers.tabipb.start();
+        
+        class Session session(APBSMolecule, params, timers);
+        session.solve();
+        
+        timers.tabipb.stop();
+        
+        session.write_output();
+        auto energies = session.energies();
 
-    return TABIPBOutput{energies[0], energies[1], energies[2]};
+        return TABIPBOutput{energies.solvation, energies.coulombic, energies.free, 0};
+        
+    } catch (const std::exception& e) {
+        std::cout << "TABI-PB failed: " << e.what() << std::endl;
+        return TABIPBOutput{0., 0., 0., 1};
+    }
 }
@@ -1,14 +1,18 @@
 #include <vector>
 #include <cmath>
 #include <cstddef>
+#include <numeric>
 
 #include "../params.h"
+#include "../tabipb_timers.h"
 #include "../molecule.h"
 
 Molecule::Molecule(Valist* APBSMolecule, 
                    struct Params& params, struct Timers_Molecule& timers)
-    : params_(params), timers_(timers)
+    : Particles(params), timers_(timers)
 {
+    timers_.ctor.start();
+    
     num_ = Valist_getNumberAtoms(APBSMolecule);
     
     for (std::size_t i = 0; i < num_; ++i) {
@@ -19,4 +23,9 @@ Molecule::Molecule(Valist* APBSMolecule,
         charge_.push_back(Vatom_getCharge(atom));
         radius_.push_back(Vatom_getRadius(atom));
     }
+    
+    order_.resize(num_);
+    std::iota(order_.begin(), order_.end(), 0);
+    
+    timers_.ctor.stop();
 }
@@ -1,10 +1,6 @@
-#include <cmath>
-#include <cstdlib>
-
-#include "../constants.h"
 #include "../params.h"
 
-Params::Params(TABIPBInput tabipbIn)
+Params::Params(TABIPBInput tabipbIn) : Params()
 {
     if (tabipbIn.mesh_flag_ == 1) mesh_ = SES;
     if (tabipbIn.mesh_flag_ == 2) mesh_ = SKIN;
@@ -21,18 +17,13 @@ Params::Params(TABIPBInput tabipbIn)
     tree_max_per_leaf_ = tabipbIn.tree_max_per_leaf_;
     tree_theta_ = tabipbIn.tree_theta_;
 
-    nonpolar_ = false;
-    precondition_ = false;
+    precondition_ = (tabipbIn.precondition_ == 1);
+    nonpolar_     = (tabipbIn.nonpolar_ == 1);
     
     if (tabipbIn.output_data_ == 1) {
         output_vtk_ = true;
         output_ply_ = true;
     }
-    output_csv_ = false;
-    output_csv_headers_ = false;
-    output_timers_ = false;
     
-    phys_eps_    = phys_eps_solvent_ / phys_eps_solute_;
-    phys_kappa2_ = constants::BULK_COEFF * phys_bulk_strength_ / phys_eps_solvent_ / phys_temp_;
-    phys_kappa_  = std::sqrt(phys_kappa2_);
+    Params::set_physical_constants();
 }
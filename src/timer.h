@@ -20,6 +20,11 @@ public:
         elapsed_time_ += std::chrono::duration<double, std::milli>(end_time_ - start_time_);
     }
 
+    /* adds time measured elsewhere, e.g. summed over threads */
+    void add(double seconds) {
+        elapsed_time_ += std::chrono::duration<double, std::milli>(1000. * seconds);
+    }
+
     double elapsed_time() const {
         return std::chrono::duration<double>(elapsed_time_).count();
     }
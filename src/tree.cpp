@@ -4,7 +4,11 @@
 #include <iostream>
 #include <iomanip>
 #include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
 
+#include "console.h"
 #include "tree.h"
 
 Tree::Tree(class Particles& particles, int max_per_leaf, struct Timers_Tree& timers)
@@ -17,35 +21,111 @@ Tree::Tree(class Particles& particles, int max_per_leaf, struct Timers_Tree& tim
     min_leaf_size_ = std::numeric_limits<std::size_t>::max();
     max_leaf_size_ = std::numeric_limits<std::size_t>::min();
     max_depth_     = 0;
+    num_child_slots_ = 0;
+
+    // Partitioning runs as a task tree over disjoint particle ranges. The
+    // result is then flattened in depth-first order, so node numbering is the
+    // same as for a serial build.
+    BuildNode root {0, particles_.num(), {}, {}};
+
+#ifdef OPENMP_ENABLED
+    #pragma omp parallel
+    #pragma omp single
+#endif
+    Tree::construct(root);
+
+    std::size_t num_nodes = Tree::count_nodes(root);
+    
+    if (num_nodes > std::numeric_limits<node_index_t>::max()
+     || particles_.num() > std::numeric_limits<node_index_t>::max()) {
+        throw std::runtime_error("too many particles for tree node indices");
+    }
+    
+    nodes_   .resize(num_nodes);
+    children_.resize(num_nodes - 1);
+    
+    node_x_min_.resize(num_nodes);
+    node_y_min_.resize(num_nodes);
+    node_z_min_.resize(num_nodes);
+    
+    node_x_max_.resize(num_nodes);
+    node_y_max_.resize(num_nodes);
+    node_z_max_.resize(num_nodes);
 
     // tree construction begins with a root on level 0, with no parent
-    Tree::construct(0, 0, 0, particles_.num());
+    Tree::flatten(root, 0, 0);
     particles_.reorder();
     
     leaves_.resize(num_nodes_);
     std::iota(leaves_.begin(), leaves_.end(), 0);
     auto container_end = std::remove_if(leaves_.begin(), leaves_.end(), [this](std::size_t n)
-        {return this->node_num_children_[n] > 0; });
+        {return this->nodes_[n].num_children > 0; });
     leaves_.erase(container_end, leaves_.end());
+    
+    levels_.resize(max_depth_);
+    for (std::size_t node_idx = 0; node_idx < num_nodes_; ++node_idx)
+        levels_[nodes_[node_idx].level].push_back(node_idx);
 
     timers_.ctor.stop();
 }
 
 
-void Tree::construct(std::size_t parent, std::size_t current_level,
-                     std::size_t begin,  std::size_t end)
+void Tree::construct(BuildNode& node)
+{
+#ifdef OPENMP_ENABLED
+    // subtrees smaller than this are built by the task that reaches them
+    constexpr std::size_t min_task_particles = 4096;
+#endif
+
+    node.bounds = particles_.bounds(node.begin, node.end);
+    
+    if (node.end - node.begin > max_per_leaf_) {
+            
+        std::array<std::size_t, 16> partitioned_bounds;
+        int num_children = particles_.partition_8(node.begin, node.end, node.bounds, partitioned_bounds);
+        
+        for (int i = 0; i < num_children; ++i) {
+            std::size_t child_begin = partitioned_bounds[2*i + 0];
+            std::size_t child_end   = partitioned_bounds[2*i + 1];
+            if (child_begin < child_end) node.children.push_back(BuildNode {child_begin, child_end, {}, {}});
+        }
+        
+        for (auto& child : node.children) {
+#ifdef OPENMP_ENABLED
+            #pragma omp task default(shared) if(child.end - child.begin > min_task_particles)
+#endif
+            Tree::construct(child);
+        }
+#ifdef OPENMP_ENABLED
+        #pragma omp taskwait
+#endif
+    }
+}
+
+
+std::size_t Tree::count_nodes(const BuildNode& node)
+{
+    std::size_t num_nodes = 1;
+    for (const auto& child : node.children) num_nodes += Tree::count_nodes(child);
+    
+    return num_nodes;
+}
+
+
+void Tree::flatten(const BuildNode& node, std::size_t parent, std::size_t current_level)
 {
     std::size_t node_idx = num_nodes_;
     num_nodes_++;
 
     if (current_level + 1 > max_depth_) max_depth_ = current_level + 1;
     
-    auto bounds = particles_.bounds(begin, end);
+    const auto& bounds = node.bounds;
+    std::size_t num_particles = node.end - node.begin;
 
-    node_particles_begin_.push_back(begin);
-    node_particles_end_.push_back(end);
-    std::size_t num_particles = end-begin;
-    node_num_particles_.push_back(num_particles);
+    Node& record = nodes_[node_idx];
+    
+    record.particles_begin = node.begin;
+    record.particles_end   = node.end;
     
     double x_min = bounds[0];
     double x_max = bounds[1];
@@ -58,55 +138,41 @@ void Tree::construct(std::size_t parent, std::size_t current_level,
     double y_len = y_max - y_min;
     double z_len = z_max - z_min;
     
-    double radius = std::sqrt(x_len*x_len + y_len*y_len + z_len*z_len) / 2.;
+    node_x_min_[node_idx] = x_min;
+    node_x_max_[node_idx] = x_max;
     
-    node_x_min_.push_back(x_min);
-    node_x_max_.push_back(x_max);
+    node_y_min_[node_idx] = y_min;
+    node_y_max_[node_idx] = y_max;
     
-    node_y_min_.push_back(y_min);
-    node_y_max_.push_back(y_max);
+    node_z_min_[node_idx] = z_min;
+    node_z_max_[node_idx] = z_max;
     
-    node_z_min_.push_back(z_min);
-    node_z_max_.push_back(z_max);
+    record.x_mid = (x_min + x_max) / 2.;
+    record.y_mid = (y_min + y_max) / 2.;
+    record.z_mid = (z_min + z_max) / 2.;
     
-    node_x_mid_.push_back((x_min + x_max) / 2.);
-    node_y_mid_.push_back((y_min + y_max) / 2.);
-    node_z_mid_.push_back((z_min + z_max) / 2.);
+    record.radius = std::sqrt(x_len*x_len + y_len*y_len + z_len*z_len) / 2.;
     
-    node_radius_.push_back(radius);
-        
-    node_num_children_.push_back(0);
-    node_children_idx_.insert(node_children_idx_.end(), {0, 0, 0, 0, 0, 0, 0, 0});
-    node_parent_idx_.push_back(parent);
-    node_level_.push_back(current_level);
-        
-    if (num_particles > max_per_leaf_) {
-            
-        std::array<std::size_t, 16> partitioned_bounds;
-        int num_children = particles_.partition_8(begin, end, partitioned_bounds);
-        
-        int child_ctr = -1;
-        for (int i = 0; i < num_children; ++i) {
+    // slots for this node's children are claimed before its subtrees
+    record.first_child  = num_child_slots_;
+    record.num_children = node.children.size();
+    record.parent       = parent;
+    record.level        = current_level;
+    
+    num_child_slots_ += node.children.size();
         
-            std::size_t child_begin = partitioned_bounds[2*i + 0];
-            std::size_t child_end   = partitioned_bounds[2*i + 1];
-            std::size_t child_level = current_level + 1;
-                
-            if (child_begin < child_end) {
-            
-                child_ctr++;
-                node_num_children_[node_idx]++;
-                node_children_idx_[8*node_idx + child_ctr] = num_nodes_;
-                Tree::construct(node_idx, child_level, child_begin, child_end);
-            }
-        }
-    } else {
+    if (node.children.empty()) {
     
         num_leaves_++;
         
         if (num_particles < min_leaf_size_) min_leaf_size_ = num_particles;
         if (num_particles > max_leaf_size_) max_leaf_size_ = num_particles;
     }
+    
+    for (std::size_t i = 0; i < node.children.size(); ++i) {
+        children_[nodes_[node_idx].first_child + i] = num_nodes_;
+        Tree::flatten(node.children[i], node_idx, current_level + 1);
+    }
 }
 
 
@@ -120,19 +186,19 @@ const std::array<double, 12> Tree::node_particle_bounds(std::size_t node_idx) co
 
 const std::array<std::size_t, 2> Tree::node_particle_idxs(std::size_t node_idx) const
 {
-    return std::array<std::size_t, 2> {node_particles_begin_[node_idx],
-                                       node_particles_end_[node_idx]};
+    return std::array<std::size_t, 2> {nodes_[node_idx].particles_begin,
+                                       nodes_[node_idx].particles_end};
 }
 
 
 void Timers_Tree::print() const
 {
-    std::cout.setf(std::ios::fixed, std::ios::floatfield);
-    std::cout.precision(5);
-    std::cout << "|...Tree function times (s)...." << std::endl;
-    std::cout << "|   |...ctor.......................: ";
-    std::cout << std::setw(12) << std::right << ctor.elapsed_time() << std::endl;
-    std::cout << "|" << std::endl;
+    console::out().setf(std::ios::fixed, std::ios::floatfield);
+    console::out().precision(5);
+    console::out() << "|...Tree function times (s)...." << std::endl;
+    console::out() << "|   |...ctor.......................: ";
+    console::out() << std::setw(12) << std::right << ctor.elapsed_time() << std::endl;
+    console::out() << "|" << std::endl;
 }
 
 
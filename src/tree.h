@@ -3,6 +3,8 @@
 
 #include <array>
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 
 #include "timer.h"
 #include "particles.h"
@@ -24,12 +26,36 @@ private:
     std::size_t min_leaf_size_;
     std::size_t max_leaf_size_;
     std::size_t max_depth_;
+    std::size_t num_child_slots_;
     
-    std::vector<std::size_t> node_num_particles_;
-    std::vector<std::size_t> node_particles_begin_;
-    std::vector<std::size_t> node_particles_end_;
+public:
+    using node_index_t = std::uint32_t;
+    
+    /* Everything the dual traversal reads about a node, in one cache line.
+     * Children of a node are children_[first_child, first_child + num_children). */
+    struct alignas(64) Node {
+        double x_mid;
+        double y_mid;
+        double z_mid;
+        double radius;
+        
+        node_index_t particles_begin;
+        node_index_t particles_end;
+        node_index_t first_child;
+        node_index_t parent;
+        node_index_t level;
+        node_index_t num_children;
+        
+        std::size_t num_particles() const { return particles_end - particles_begin; }
+    };
+    static_assert(sizeof(Node) == 64, "Tree::Node should fill exactly one cache line");
+    
+private:
+    std::vector<Node> nodes_;
+    std::vector<node_index_t> children_;
     
     std::vector<std::size_t> leaves_;
+    std::vector<std::vector<std::size_t>> levels_;
     
     std::vector<double> node_x_min_;
     std::vector<double> node_y_min_;
@@ -39,17 +65,17 @@ private:
     std::vector<double> node_y_max_;
     std::vector<double> node_z_max_;
     
-    std::vector<double> node_x_mid_;
-    std::vector<double> node_y_mid_;
-    std::vector<double> node_z_mid_;
-    
-    std::vector<double> node_radius_;
-    std::vector<std::size_t> node_num_children_;
-    std::vector<std::size_t> node_children_idx_;
-    std::vector<std::size_t> node_parent_idx_;
-    std::vector<std::size_t> node_level_;
+    /* temporary node of the parallel build, flattened into the arrays above */
+    struct BuildNode {
+        std::size_t begin;
+        std::size_t end;
+        std::array<double, 6> bounds;
+        std::vector<BuildNode> children;
+    };
     
-    void construct(std::size_t, std::size_t, std::size_t, std::size_t);
+    void construct(BuildNode& node);
+    void flatten(const BuildNode& node, std::size_t parent, std::size_t level);
+    static std::size_t count_nodes(const BuildNode& node);
     
 public:
     Tree(class Particles&, const int max_per_leaf, struct Timers_Tree&);
@@ -59,6 +85,16 @@ public:
     const std::array<double, 12> node_particle_bounds(std::size_t node_idx) const;
     const std::array<std::size_t, 2> node_particle_idxs(std::size_t node_idx) const;
     const std::vector<std::size_t>& leaves() const { return leaves_; }
+    std::size_t max_leaf_size() const { return max_leaf_size_; }
+    const Node& node(std::size_t node_idx) const { return nodes_[node_idx]; }
+    std::size_t node_parent_idx(std::size_t node_idx) const { return nodes_[node_idx].parent; }
+    std::size_t node_num_children(std::size_t node_idx) const { return nodes_[node_idx].num_children; }
+    std::size_t node_child_idx(std::size_t node_idx, std::size_t child) const {
+        return children_[nodes_[node_idx].first_child + child];
+    }
+    
+    std::size_t num_levels() const { return max_depth_; };
+    const std::vector<std::size_t>& level_nodes(std::size_t level) const { return levels_[level]; }
     
     friend class InteractionList;
 };
@@ -5,6 +5,7 @@
 //#include "interp_pts.h"
 #include "tree.h"
 #include "interaction_list.h"
+#include "workspace.h"
 
 
 class TreeCompute
@@ -14,6 +15,8 @@ protected:
     const class Tree& target_tree_;
     const class InteractionList& interaction_list_;
     
+    class Workspace workspace_;
+    
     virtual void particle_particle_interact(std::array<std::size_t, 2> target_node_particle_idxs,
                                             std::array<std::size_t, 2> source_node_particle_idxs) = 0;
     
@@ -30,16 +33,28 @@ protected:
     
     virtual void copyin_clusters_to_device() const = 0;
     virtual void delete_clusters_from_device() const = 0;
+    
+    /* upward pass scratch: exact indices and denominators of one source node */
+    void reserve_workspace() {
+#ifdef OPENACC_ENABLED
+        std::size_t max_node_particles = source_tree_.node_particle_idxs(0)[1];
+#else
+        std::size_t max_node_particles = source_tree_.max_leaf_size();
+#endif
+        workspace_.reserve(max_node_particles, 3 * max_node_particles);
+    }
 
     
 public:
     TreeCompute(const class Tree& source_tree, const class Tree& target_tree,
                 const class InteractionList& interaction_list)
-        : source_tree_(source_tree), target_tree_(target_tree), interaction_list_(interaction_list) {};
+        : source_tree_(source_tree), target_tree_(target_tree), interaction_list_(interaction_list)
+        { reserve_workspace(); };
         
     TreeCompute(const class Tree& tree,
                 const class InteractionList& interaction_list)
-        : source_tree_(tree), target_tree_(tree), interaction_list_(interaction_list) {};
+        : source_tree_(tree), target_tree_(tree), interaction_list_(interaction_list)
+        { reserve_workspace(); };
         
     virtual ~TreeCompute() = default;
     
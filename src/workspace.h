@@ -0,0 +1,83 @@
+#ifndef H_TABIPB_WORKSPACE_H
+#define H_TABIPB_WORKSPACE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+#ifdef OPENMP_ENABLED
+    #include <omp.h>
+#endif
+
+/* Scratch memory sized once per solver. Each thread gets its own slab, padded
+ * to a cache line so neighbouring slabs do not share one; kernels carve their
+ * temporaries out of the calling thread's slab instead of allocating. */
+class Workspace
+{
+private:
+    static constexpr std::size_t PAD = 64;
+
+    std::size_t num_threads_ = 1;
+    int base_level_ = 0;
+    std::size_t doubles_per_thread_ = 0;
+    std::size_t ints_per_thread_ = 0;
+
+    std::vector<double> doubles_;
+    std::vector<int> ints_;
+
+    static std::size_t padded(std::size_t num, std::size_t size) {
+        std::size_t per_line = PAD / size;
+        return (num + per_line - 1) / per_line * per_line;
+    }
+
+    /* slab of the calling thread; outside the solver's own parallel regions
+     * (e.g. a solver running inside a parallel batch job) that is slab 0 */
+    std::size_t thread_num() const {
+#ifdef OPENMP_ENABLED
+        return omp_get_level() > base_level_ ? omp_get_thread_num() : 0;
+#else
+        return 0;
+#endif
+    }
+
+public:
+    Workspace() = default;
+    ~Workspace() = default;
+
+    /* grows the per-thread slabs to hold at least the requested counts, for at
+     * least the current number of threads */
+    void reserve(std::size_t doubles_per_thread, std::size_t ints_per_thread) {
+#ifdef OPENMP_ENABLED
+        num_threads_ = std::max<std::size_t>(num_threads_, omp_get_max_threads());
+        base_level_  = omp_get_level();
+#endif
+        doubles_per_thread = padded(doubles_per_thread, sizeof(double));
+        ints_per_thread    = padded(ints_per_thread,    sizeof(int));
+
+        if (doubles_per_thread > doubles_per_thread_ || doubles_.size() < num_threads_ * doubles_per_thread_) {
+            doubles_per_thread_ = std::max(doubles_per_thread, doubles_per_thread_);
+            doubles_.assign(num_threads_ * doubles_per_thread_, 0.);
+        }
+
+        if (ints_per_thread > ints_per_thread_ || ints_.size() < num_threads_ * ints_per_thread_) {
+            ints_per_thread_ = std::max(ints_per_thread, ints_per_thread_);
+            ints_.assign(num_threads_ * ints_per_thread_, 0);
+        }
+    }
+
+    /* adds slabs if the thread count went up since they were reserved, e.g. a
+     * Session solving again after omp_set_num_threads */
+    void reserve_threads() { reserve(0, 0); }
+
+    double* doubles() {
+        assert(thread_num() < num_threads_);
+        return doubles_.data() + thread_num() * doubles_per_thread_;
+    }
+    int* ints() {
+        assert(thread_num() < num_threads_);
+        return ints_.data() + thread_num() * ints_per_thread_;
+    }
+};
+
+#endif /* H_TABIPB_WORKSPACE_H */
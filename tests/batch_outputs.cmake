@@ -0,0 +1,36 @@
+# Runs two decks without output_prefix side by side with tabipb --batch and
+# checks that each wrote its own csv, then that a manifest listing one deck
+# twice is rejected. Expects TABIPB, PQR and WORK_DIR.
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+foreach (job a b)
+    file(WRITE ${WORK_DIR}/${job}.in
+         "mol ${PQR}\nmesh gaussian\nsdens 1\nsrad 1.4\npdie 1\nsdie 80\n"
+         "bulk 0.15\ntemp 300\ntree_degree 2\ntree_max_per_leaf 50\n"
+         "tree_theta 0.8\noutdata csv\n")
+endforeach ()
+
+file(WRITE ${WORK_DIR}/manifest.txt "threads_per_job 1\njob a.in\njob b.in\n")
+execute_process(COMMAND ${TABIPB} --batch manifest.txt
+                WORKING_DIRECTORY ${WORK_DIR} RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "tabipb --batch failed")
+endif ()
+
+foreach (job a b)
+    if (NOT EXISTS ${WORK_DIR}/${job}.csv)
+        message(FATAL_ERROR "job ${job} did not write ${job}.csv")
+    endif ()
+endforeach ()
+if (EXISTS ${WORK_DIR}/output.csv)
+    message(FATAL_ERROR "a job wrote to the default output prefix")
+endif ()
+
+file(WRITE ${WORK_DIR}/twice.txt "job a.in\njob a.in\n")
+execute_process(COMMAND ${TABIPB} --batch twice.txt
+                WORKING_DIRECTORY ${WORK_DIR} RESULT_VARIABLE result OUTPUT_VARIABLE output)
+if (result EQUAL 0 OR NOT output MATCHES "same output_prefix")
+    message(FATAL_ERROR "a manifest with two jobs on one output prefix was accepted")
+endif ()